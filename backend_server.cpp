@@ -7,8 +7,151 @@
 #include <string>
 #include <algorithm>
 #include <cstdlib>
+#include <string_view>
+#include <charconv>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cctype>
+#include <memory>
+#include <queue>
+#include <shared_mutex>
+#include <deque>
+#include <functional>
+#include <stdexcept>
+#include <cmath>
+#include <iterator>
+#include <filesystem>
+#include <unordered_map>
+#include <set>
+#include <cstring>
+#include <cerrno>
+#include <random>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/stat.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define RESULT_IO_URING 1
+#endif
+#endif
+#include "result_core.h"
 using namespace std;
 
+// ==================== TIMESTAMPS ====================
+// Commit times are Unix milliseconds, written to the record files as UTC
+// ISO 8601 ("Time: 2025-06-01T10:15:30.250Z").
+
+int64_t nowMillis() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date (H. Hinnant's algorithm)
+int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+string formatTimestamp(int64_t ms) {
+    int64_t days = ms >= 0 ? ms / 86400000 : (ms - 86399999) / 86400000;
+    int64_t rem = ms - days * 86400000;
+    // civil_from_days
+    int64_t z = days + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    unsigned d = doy - (153 * mp + 2) / 5 + 1;
+    unsigned m = mp < 10 ? mp + 3 : mp - 9;
+    int64_t y = (int64_t)yoe + era * 400 + (m <= 2);
+    
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%04lld-%02u-%02uT%02d:%02d:%02d.%03dZ", (long long)y, m, d,
+             (int)(rem / 3600000), (int)(rem / 60000 % 60), (int)(rem / 1000 % 60), (int)(rem % 1000));
+    return buf;
+}
+
+// Accepts Unix seconds ("1748772930") or UTC ISO 8601: "2025-06-01",
+// "2025-06-01T10:15", "2025-06-01T10:15:30", optional ".250" and "Z". A bare
+// date means the end of that day. Returns false on anything else.
+bool parseTimestamp(string_view text, int64_t& ms) {
+    while (!text.empty() && isspace((unsigned char)text.front())) text.remove_prefix(1);
+    while (!text.empty() && isspace((unsigned char)text.back())) text.remove_suffix(1);
+    if (text.empty()) return false;
+    if (all_of(text.begin(), text.end(), [](char c) { return isdigit((unsigned char)c); })) {
+        int64_t seconds = 0;
+        auto result = from_chars(text.data(), text.data() + text.size(), seconds);
+        if (result.ec != errc() || seconds > (int64_t)1 << 40) return false;
+        ms = seconds * 1000;
+        return true;
+    }
+    
+    size_t pos = 0;
+    auto number = [&](size_t digits, int& value) {
+        if (pos + digits > text.size()) return false;
+        value = 0;
+        for (size_t i = 0; i < digits; i++) {
+            char c = text[pos + i];
+            if (!isdigit((unsigned char)c)) return false;
+            value = value * 10 + (c - '0');
+        }
+        pos += digits;
+        return true;
+    };
+    auto expect = [&](char c) {
+        if (pos >= text.size() || text[pos] != c) return false;
+        pos++;
+        return true;
+    };
+    
+    int year, month, day, hour = 23, minute = 59, second = 59, millis = 999;
+    if (!number(4, year) || !expect('-') || !number(2, month) || !expect('-') || !number(2, day)) return false;
+    if (month < 1 || month > 12 || day < 1 || day > 31) return false;
+    if (pos < text.size()) {
+        if (!expect('T') && !expect(' ')) return false;
+        if (!number(2, hour) || !expect(':') || !number(2, minute)) return false;
+        second = 0;
+        millis = 0;
+        if (pos < text.size() && text[pos] == ':' && (!expect(':') || !number(2, second))) return false;
+        if (pos < text.size() && text[pos] == '.') {
+            pos++;
+            size_t start = pos;
+            int scale = 100;
+            millis = 0;
+            while (pos < text.size() && isdigit((unsigned char)text[pos])) {
+                millis += (text[pos] - '0') * scale;
+                scale /= 10;
+                pos++;
+            }
+            if (pos == start) return false;
+        }
+        if (pos < text.size() && !expect('Z')) return false;
+        if (pos != text.size() || hour > 23 || minute > 59 || second > 60) return false;
+    }
+    ms = ((daysFromCivil(year, month, day) * 24 + hour) * 60 + minute) * 60000LL + second * 1000LL + millis;
+    return true;
+}
+
 // ==================== BASE CLASS: Person (Inheritance) ====================
 class Person {
 protected:
@@ -23,8 +166,8 @@ public:
         cout << "ID: " << id << "\nName: " << name << endl;
     }
     
-    string getName() const { return name; }
-    string getID() const { return id; }
+    const string& getName() const { return name; }
+    const string& getID() const { return id; }
     void setName(string n) { name = n; }
     void setID(string i) { id = i; }
     
@@ -43,10 +186,11 @@ public:
     Course() : code(""), name(""), marks(0), maxMarks(0) {}
     Course(string c, string n, int m, int mx) : code(c), name(n), marks(m), maxMarks(mx) {}
     
-    string getCode() const { return code; }
-    string getName() const { return name; }
+    const string& getCode() const { return code; }
+    const string& getName() const { return name; }
     int getMarks() const { return marks; }
     int getMaxMarks() const { return maxMarks; }
+    void setMarks(int m) { marks = m; }
     
     string toJSON() const {
         stringstream ss;
@@ -62,14 +206,13 @@ private:
     vector<Course> courses;
     float percentage;
     char grade;
+    int totalMarks;     // running sums, so a marks correction is O(1)
+    int totalMaxMarks;
+    unsigned version;   // bumped by the store on every change to this student
+    uint64_t seq;       // change-feed position of the last change, 0 = before the feed
     
     void calculatePercentage() {
-        int total = 0, maxTotal = 0;
-        for (const auto& c : courses) {
-            total += c.getMarks();
-            maxTotal += c.getMaxMarks();
-        }
-        percentage = (maxTotal > 0) ? (float)total / maxTotal * 100 : 0;
+        percentage = (totalMaxMarks > 0) ? (float)totalMarks / totalMaxMarks * 100 : 0;
     }
     
     void calculateGrade() {
@@ -82,11 +225,30 @@ private:
     }
     
 public:
-    Student() : Person(), percentage(0), grade('F') {}
-    Student(string n, string i) : Person(n, i), percentage(0), grade('F') {}
+    Student() : Person(), percentage(0), grade('F'), totalMarks(0), totalMaxMarks(0), version(0), seq(0) {}
+    Student(string n, string i)
+        : Person(n, i), percentage(0), grade('F'), totalMarks(0), totalMaxMarks(0), version(0), seq(0) {}
     
     void addCourse(const Course& c) {
         courses.push_back(c);
+        totalMarks += c.getMarks();
+        totalMaxMarks += c.getMaxMarks();
+        calculatePercentage();
+        calculateGrade();
+    }
+    
+    // Course index for a code, -1 if the student does not take it
+    int findCourse(const string& code) const {
+        for (size_t i = 0; i < courses.size(); i++) {
+            if (courses[i].getCode() == code) return (int)i;
+        }
+        return -1;
+    }
+    
+    // Corrects one course's marks, adjusting percentage and grade incrementally
+    void setCourseMarks(int index, int marks) {
+        totalMarks += marks - courses[index].getMarks();
+        courses[index].setMarks(marks);
         calculatePercentage();
         calculateGrade();
     }
@@ -94,22 +256,36 @@ public:
     float getPercentage() const { return percentage; }
     char getGrade() const { return grade; }
     const vector<Course>& getCourses() const { return courses; }
+    unsigned getVersion() const { return version; }
+    void setVersion(unsigned v) { version = v; }
+    uint64_t getSeq() const { return seq; }
+    void setSeq(uint64_t s) { seq = s; }
+    
+    // Text block in the reportcards.txt layout; committedMs 0 = time unknown
+    string toFileRecord(int64_t committedMs = 0) const {
+        stringstream ss;
+        ss << "---------------------------------------------\n";
+        ss << "Student PRN: " << id << "\n";
+        ss << "Student Name: " << name << "\n";
+        ss << "Courses:\n";
+        for (const auto& c : courses) {
+            ss << "  " << c.getCode() << " - " << c.getName() 
+               << " : " << c.getMarks() << "/" << c.getMaxMarks() << "\n";
+        }
+        ss << "Percentage: " << fixed << setprecision(2) << percentage << "%\n";
+        ss << "Grade: " << grade << "\n";
+        if (version > 0) ss << "Version: " << version << "\n";
+        if (seq > 0) ss << "Seq: " << seq << "\n";
+        if (committedMs > 0) ss << "Time: " << formatTimestamp(committedMs) << "\n";
+        ss << "---------------------------------------------\n\n";
+        return ss.str();
+    }
     
     void saveToFile(const string& filename) const {
         ofstream fout(filename, ios::app);
         if (!fout) return;
         
-        fout << "---------------------------------------------\n";
-        fout << "Student PRN: " << id << "\n";
-        fout << "Student Name: " << name << "\n";
-        fout << "Courses:\n";
-        for (const auto& c : courses) {
-            fout << "  " << c.getCode() << " - " << c.getName() 
-                 << " : " << c.getMarks() << "/" << c.getMaxMarks() << "\n";
-        }
-        fout << "Percentage: " << fixed << setprecision(2) << percentage << "%\n";
-        fout << "Grade: " << grade << "\n";
-        fout << "---------------------------------------------\n\n";
+        fout << toFileRecord();
         fout.close();
     }
     
@@ -117,7 +293,7 @@ public:
         stringstream ss;
         ss << "{\"prn\":\"" << id << "\",\"name\":\"" << name 
            << "\",\"percentage\":" << fixed << setprecision(2) << percentage
-           << ",\"grade\":\"" << grade << "\",\"courses\":[";
+           << ",\"grade\":\"" << grade << "\",\"version\":" << version << ",\"courses\":[";
         
         for (size_t i = 0; i < courses.size(); i++) {
             if (i > 0) ss << ",";
@@ -128,332 +304,7786 @@ public:
     }
 };
 
-// ==================== CLASS: ResultManager ====================
-class ResultManager {
+// ==================== COMMAND PARSER ====================
+// Commands arrive as one pipe-delimited line, e.g.
+//   ADD|PRN|Name|CourseCount|Code1|Name1|Marks1|Max1|...
+// The parser works on string_views into that line: no token vector, no
+// substr copies and no exceptions, every failure is reported as a ParseError.
+enum class ParseError {
+    None,
+    MissingField,
+    EmptyField,
+    NotANumber,
+    OutOfRange,
+    TrailingCharacters
+};
+
+const char* parseErrorCode(ParseError e) {
+    switch (e) {
+        case ParseError::None: return "OK";
+        case ParseError::MissingField: return "MISSING_FIELD";
+        case ParseError::EmptyField: return "EMPTY_FIELD";
+        case ParseError::NotANumber: return "NOT_A_NUMBER";
+        case ParseError::OutOfRange: return "OUT_OF_RANGE";
+        case ParseError::TrailingCharacters: return "TRAILING_CHARACTERS";
+    }
+    return "UNKNOWN";
+}
+
+string_view trimView(string_view v) {
+    while (!v.empty() && (v.front() == ' ' || v.front() == '\t')) v.remove_prefix(1);
+    while (!v.empty() && (v.back() == ' ' || v.back() == '\t' || v.back() == '\r' || v.back() == '\n'))
+        v.remove_suffix(1);
+    return v;
+}
+
+ParseError parseInt(string_view field, int& out) {
+    field = trimView(field);
+    if (field.empty()) return ParseError::EmptyField;
+    
+    const char* first = field.data();
+    const char* last = field.data() + field.size();
+    if (*first == '+') first++;  // stoi accepted a leading '+', keep doing so
+    
+    int value = 0;
+    auto result = from_chars(first, last, value);
+    if (result.ec == errc::result_out_of_range) return ParseError::OutOfRange;
+    if (result.ec != errc()) return ParseError::NotANumber;
+    if (result.ptr != last) return ParseError::TrailingCharacters;
+    
+    out = value;
+    return ParseError::None;
+}
+
+// Single-pass cursor over the '|' separated fields of a command line
+class FieldCursor {
 private:
-    map<string, Student> studentMap;
-    map<string, float> classPercentageMap;
-    string dataFile;
-    string csvFile;
+    string_view rest;
+    bool done;
+    int index;
     
 public:
-    ResultManager(string df, string cf) : dataFile(df), csvFile(cf) {
-        loadClassmateData();
-        loadExistingStudents();
+    explicit FieldCursor(string_view line) : rest(line), done(false), index(0) {}
+    
+    // Returns false once every field has been consumed
+    bool next(string_view& field) {
+        if (done) return false;
+        size_t bar = rest.find('|');
+        if (bar == string_view::npos) {
+            field = rest;
+            rest = string_view();
+            done = true;
+        } else {
+            field = rest.substr(0, bar);
+            rest.remove_prefix(bar + 1);
+        }
+        index++;
+        return true;
     }
     
-    void loadClassmateData() {
-        ifstream fin(csvFile);
-        if (!fin) return;
+    ParseError nextText(string_view& field) {
+        if (!next(field)) return ParseError::MissingField;
+        return ParseError::None;
+    }
+    
+    ParseError nextInt(int& value) {
+        string_view field;
+        if (!next(field)) return ParseError::MissingField;
+        return parseInt(field, value);
+    }
+    
+    bool atEnd() const { return done; }
+    
+    // 1-based position of the last field handed out (the verb is field 1)
+    int fieldIndex() const { return index; }
+};
+
+string errorJSON(const string& message) {
+    return "{\"error\":\"" + message + "\"}";
+}
+
+string errorJSON(const string& message, ParseError e, int field) {
+    stringstream ss;
+    ss << "{\"error\":\"" << message << "\",\"code\":\"" << parseErrorCode(e)
+       << "\",\"field\":" << field << "}";
+    return ss.str();
+}
+
+// ==================== RECORD FILE PARSER ====================
+// reportcards.txt holds three kinds of blocks, each between dash lines:
+//   full report cards written by Student::toFileRecord(),
+//   "Update PRN:" deltas that correct one course's marks, and
+//   "Deleted PRN:" tombstones.
+// Optional "Version:", "Seq:" and "Time:" lines carry the student's version,
+// change-feed position and commit time. Replaying the blocks in file order
+// rebuilds the store.
+const char* const RECORD_RULE = "---------------------------------------------\n";
+
+enum class RecordKind { Full, MarksUpdate, Delete };
+
+struct FileRecord {
+    RecordKind kind = RecordKind::Full;
+    Student student;        // Full
+    string prn;             // MarksUpdate, Delete
+    string courseCode;      // MarksUpdate
+    int marks = 0;          // MarksUpdate
+    unsigned version = 0;   // 0 = written before records were versioned
+    uint64_t seq = 0;       // change-feed position, 0 = written before the feed
+    int64_t time = 0;       // commit time in Unix ms, 0 = written before commit times
+};
+
+string marksUpdateRecord(const string& prn, const string& code, int marks, unsigned version, uint64_t seq,
+                         int64_t committedMs = 0) {
+    stringstream ss;
+    ss << RECORD_RULE;
+    ss << "Update PRN: " << prn << "\n";
+    ss << "Course: " << code << "\n";
+    ss << "Marks: " << marks << "\n";
+    ss << "Version: " << version << "\n";
+    ss << "Seq: " << seq << "\n";
+    if (committedMs > 0) ss << "Time: " << formatTimestamp(committedMs) << "\n";
+    ss << RECORD_RULE << "\n";
+    return ss.str();
+}
+
+// version 0 (a tombstone rewritten by compaction) is left out
+string deleteRecord(const string& prn, unsigned version, uint64_t seq, int64_t committedMs = 0) {
+    stringstream ss;
+    ss << RECORD_RULE;
+    ss << "Deleted PRN: " << prn << "\n";
+    if (version > 0) ss << "Version: " << version << "\n";
+    ss << "Seq: " << seq << "\n";
+    if (committedMs > 0) ss << "Time: " << formatTimestamp(committedMs) << "\n";
+    ss << RECORD_RULE << "\n";
+    return ss.str();
+}
+
+// Text after the first ':' of a "Label: value" line, trimmed ("" when there is none)
+string valueAfterColon(const string& line) {
+    size_t colon = line.find(':');
+    if (colon == string::npos) return "";
+    return string(trimView(string_view(line).substr(colon + 1)));
+}
+
+bool startsWith(const string& line, const char* prefix, string& value) {
+    size_t n = strlen(prefix);
+    if (line.compare(0, n, prefix) != 0) return false;
+    value = string(trimView(string_view(line).substr(n)));
+    return true;
+}
+
+// Calls fn(record, rawBlock) for every complete block, in file order.
+// rawBlock is the block exactly as it appears in the file.
+template <typename Fn>
+void forEachRecord(istream& fin, Fn fn) {
+    string rawLine, line, raw, value;
+    string prn = "", studentName = "";
+    vector<Course> courses;
+    FileRecord rec;
+    bool haveMarks = false;
+    
+    auto reset = [&]() {
+        prn = studentName = "";
+        courses.clear();
+        rec = FileRecord();
+        haveMarks = false;
+    };
+    
+    auto emit = [&]() {
+        if (rec.kind == RecordKind::Full) {
+            if (prn.empty() || studentName.empty() || courses.empty()) return false;
+            rec.student = Student(studentName, prn);
+            for (const auto& c : courses) {
+                rec.student.addCourse(c);
+            }
+            rec.student.setVersion(rec.version);
+            rec.student.setSeq(rec.seq);
+        }
+        else if (rec.prn.empty() || (rec.kind == RecordKind::MarksUpdate && (rec.courseCode.empty() || !haveMarks))) {
+            return false;
+        }
+        fn(rec, raw);
+        return true;
+    };
+    
+    while (getline(fin, rawLine)) {
+        line = rawLine;
         
-        string line;
-        getline(fin, line);  // Skip header
+        // Trim whitespace
+        line.erase(0, line.find_first_not_of(" \t\r\n"));
+        line.erase(line.find_last_not_of(" \t\r\n") + 1);
         
-        while (getline(fin, line)) {
-            if (line.empty()) continue;
+        if (line.empty()) continue;
+        raw += rawLine;
+        raw += '\n';
+        
+        if (line.find("Student PRN:") != string::npos) {
+            prn = valueAfterColon(line);
+        } 
+        else if (line.find("Student ID:") != string::npos) {
+            prn = valueAfterColon(line);
+        } 
+        else if (line.find("Student Name:") != string::npos) {
+            studentName = valueAfterColon(line);
+        } 
+        else if (line.find("Courses:") != string::npos) {
+            courses.clear();
+        } 
+        else if (startsWith(line, "Update PRN:", rec.prn)) {
+            rec.kind = RecordKind::MarksUpdate;
+        }
+        else if (startsWith(line, "Deleted PRN:", rec.prn)) {
+            rec.kind = RecordKind::Delete;
+        }
+        else if (startsWith(line, "Course:", value)) {
+            rec.courseCode = value;
+        }
+        else if (startsWith(line, "Marks:", value)) {
+            haveMarks = parseInt(value, rec.marks) == ParseError::None;
+        }
+        else if (startsWith(line, "Version:", value)) {
+            int v = 0;
+            if (parseInt(value, v) == ParseError::None && v > 0) rec.version = (unsigned)v;
+        }
+        else if (startsWith(line, "Seq:", value)) {
+            uint64_t n = 0;
+            auto result = from_chars(value.data(), value.data() + value.size(), n);
+            if (result.ec == errc() && result.ptr == value.data() + value.size()) rec.seq = n;
+        }
+        else if (startsWith(line, "Time:", value)) {
+            int64_t ms = 0;
+            if (parseTimestamp(value, ms) && ms > 0) rec.time = ms;
+        }
+        else if (line.find(" - ") != string::npos && line.find(" : ") != string::npos) {
+            // Parse course line: "  CSE101 - Programming : 85/100"
+            size_t dashPos = line.find(" - ");
+            size_t colonPos = line.find(" : ");
+            size_t slashPos = line.find("/", colonPos);
             
-            // Remove BOM if present
-            if (line.size() >= 3 && line[0] == '\xEF' && line[1] == '\xBB' && line[2] == '\xBF') {
-                line = line.substr(3);
+            if (slashPos != string::npos && dashPos < colonPos) {
+                string_view view(line);
+                string code(trimView(view.substr(0, dashPos)));
+                string courseName(trimView(view.substr(dashPos + 3, colonPos - dashPos - 3)));
+                int marks, maxMarks;
+                
+                // Skip malformed course lines
+                if (parseInt(view.substr(colonPos + 3, slashPos - colonPos - 3), marks) == ParseError::None &&
+                    parseInt(view.substr(slashPos + 1), maxMarks) == ParseError::None) {
+                    courses.push_back(Course(code, courseName, marks, maxMarks));
+                }
             }
-            
-            stringstream ss(line);
-            string prn, name, percStr;
-            
-            getline(ss, prn, ',');
-            getline(ss, name, ',');
-            getline(ss, percStr, ',');
-            
-            try {
-                float perc = stof(percStr);
-                classPercentageMap[prn] = perc;
-            } catch (...) {
-                continue;
+        } 
+        else if (line.find("---------------------------------------------") != string::npos) {
+            // End of a block, or the opening line of the next one
+            if (emit()) {
+                raw.clear();
+            } else {
+                raw = rawLine + '\n';
             }
+            reset();
         }
-        fin.close();
     }
     
-    void loadExistingStudents() {
-        ifstream fin(dataFile);
-        if (!fin) return;
+    // Handle last block if file doesn't end with dashes
+    emit();
+}
 
-        string line;
-        string prn = "", studentName = "";
-        vector<Course> courses;
+// ==================== FILE I/O ====================
+// Record files are read in large aligned blocks and appended a whole batch
+// at a time through a descriptor that stays open. On Linux with --io=auto
+// (the default) both go through io_uring when the kernel allows it: the
+// reader keeps several block reads in flight into registered buffers ahead
+// of the parser, and the writer submits a batch's write and its fsync as one
+// linked pair in a single system call. Old kernels, seccomp filters and
+// --io=posix get pread/write/fsync instead, and Windows keeps stdio.
+// io_benchmark.cpp compares these paths with plain iostream.
+enum class IoMode { Auto, Posix };
+
+const size_t IO_BLOCK = 1 << 20;   // bytes per read
+const unsigned IO_DEPTH = 4;       // block reads in flight ahead of the parser
+
+#ifdef RESULT_IO_URING
+// Just enough of io_uring for the reader and writer below, over the raw
+// system calls so there is no liburing to install
+class IoRing {
+private:
+    int fd = -1;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    void* sqeArea = MAP_FAILED;
+    size_t sqRingBytes = 0, cqRingBytes = 0, sqeBytes = 0;
+    unsigned *sqHead = nullptr, *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+    unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned sqEntries = 0;
+    unsigned features = 0;
+    unsigned localTail = 0;   // prepared entries end here; published on submit
+    
+    void release() {
+        if (sqeArea != MAP_FAILED) munmap(sqeArea, sqeBytes);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingBytes);
+        if (sqRing != MAP_FAILED) munmap(sqRing, sqRingBytes);
+        if (fd >= 0) ::close(fd);
+        sqeArea = cqRing = sqRing = MAP_FAILED;
+        fd = -1;
+    }
+    
+    template <typename T>
+    static T* at(void* base, uint32_t offset) {
+        return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+    }
+    
+public:
+    explicit IoRing(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0) return;
+        features = params.features;
         
-        while (getline(fin, line)) {
-            // Trim whitespace
-            line.erase(0, line.find_first_not_of(" \t\r\n"));
-            line.erase(line.find_last_not_of(" \t\r\n") + 1);
-            
-            if (line.empty()) continue;
-            
-            if (line.find("Student PRN:") != string::npos) {
-                prn = line.substr(line.find(":") + 2);
-                // Trim spaces
-                prn.erase(0, prn.find_first_not_of(" \t"));
-            } 
-            else if (line.find("Student ID:") != string::npos) {
-                prn = line.substr(line.find(":") + 2);
-                prn.erase(0, prn.find_first_not_of(" \t"));
-            } 
-            else if (line.find("Student Name:") != string::npos) {
-                studentName = line.substr(line.find(":") + 2);
-                studentName.erase(0, studentName.find_first_not_of(" \t"));
-            } 
-            else if (line.find("Courses:") != string::npos) {
-                courses.clear();
-            } 
-            else if (line.find(" - ") != string::npos && line.find(" : ") != string::npos) {
-                // Parse course line: "  CSE101 - Programming : 85/100"
-                try {
-                    size_t dashPos = line.find(" - ");
-                    size_t colonPos = line.find(" : ");
-                    size_t slashPos = line.find("/");
-                    
-                    if (dashPos != string::npos && colonPos != string::npos && slashPos != string::npos) {
-                        // Extract parts
-                        string code = line.substr(0, dashPos);
-                        string courseName = line.substr(dashPos + 3, colonPos - dashPos - 3);
-                        string marksStr = line.substr(colonPos + 3, slashPos - colonPos - 3);
-                        string maxMarksStr = line.substr(slashPos + 1);
-                        
-                        // Trim spaces
-                        code.erase(0, code.find_first_not_of(" \t"));
-                        code.erase(code.find_last_not_of(" \t") + 1);
-                        courseName.erase(0, courseName.find_first_not_of(" \t"));
-                        courseName.erase(courseName.find_last_not_of(" \t") + 1);
-                        marksStr.erase(0, marksStr.find_first_not_of(" \t"));
-                        marksStr.erase(marksStr.find_last_not_of(" \t") + 1);
-                        maxMarksStr.erase(0, maxMarksStr.find_first_not_of(" \t"));
-                        maxMarksStr.erase(maxMarksStr.find_last_not_of(" \t") + 1);
-                        
-                        // Convert to integers
-                        int marks = stoi(marksStr);
-                        int maxMarks = stoi(maxMarksStr);
-                        
-                        courses.push_back(Course(code, courseName, marks, maxMarks));
-                    }
-                } catch (...) {
-                    // Skip malformed course lines
-                    continue;
-                }
-            } 
-            else if (line.find("---------------------------------------------") != string::npos) {
-                // End of student record
-                if (!prn.empty() && !studentName.empty() && !courses.empty()) {
-                    Student s(studentName, prn);
-                    for (const auto& c : courses) {
-                        s.addCourse(c);
-                    }
-                    
-                    // Store PRN in uppercase for consistency
-                    string prnUpper = prn;
-                    transform(prnUpper.begin(), prnUpper.end(), prnUpper.begin(), ::toupper);
-                    studentMap[prnUpper] = s;
-                }
-                
-                // Reset for next student
-                prn = studentName = "";
-                courses.clear();
-            }
+        sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqRingBytes = cqRingBytes = max(sqRingBytes, cqRingBytes);
+        sqRing = mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing != MAP_FAILED) {
+            cqRing = single ? sqRing
+                            : mmap(nullptr, cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
         }
-        
-        // Handle last student if file doesn't end with dashes
-        if (!prn.empty() && !studentName.empty() && !courses.empty()) {
-            Student s(studentName, prn);
-            for (const auto& c : courses) {
-                s.addCourse(c);
-            }
-            string prnUpper = prn;
-            transform(prnUpper.begin(), prnUpper.end(), prnUpper.begin(), ::toupper);
-            studentMap[prnUpper] = s;
+        sqeBytes = params.sq_entries * sizeof(io_uring_sqe);
+        if (cqRing != MAP_FAILED) {
+            sqeArea = mmap(nullptr, sqeBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        }
+        if (sqeArea == MAP_FAILED) {
+            release();
+            return;
         }
         
-        fin.close();
+        sqHead = at<unsigned>(sqRing, params.sq_off.head);
+        sqTail = at<unsigned>(sqRing, params.sq_off.tail);
+        sqMask = at<unsigned>(sqRing, params.sq_off.ring_mask);
+        sqArray = at<unsigned>(sqRing, params.sq_off.array);
+        cqHead = at<unsigned>(cqRing, params.cq_off.head);
+        cqTail = at<unsigned>(cqRing, params.cq_off.tail);
+        cqMask = at<unsigned>(cqRing, params.cq_off.ring_mask);
+        cqes = at<io_uring_cqe>(cqRing, params.cq_off.cqes);
+        sqes = static_cast<io_uring_sqe*>(sqeArea);
+        sqEntries = params.sq_entries;
+        localTail = *sqTail;
     }
     
-    void addStudent(const Student& s) {
-        string prnUpper = s.getID();
-        transform(prnUpper.begin(), prnUpper.end(), prnUpper.begin(), ::toupper);
-        studentMap[prnUpper] = s;
-        s.saveToFile(dataFile);
-    }
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+    ~IoRing() { release(); }
     
-    Student* searchStudent(const string& prn) {
-        string searchPRN = prn;
-        transform(searchPRN.begin(), searchPRN.end(), searchPRN.begin(), ::toupper);
-        
-        auto it = studentMap.find(searchPRN);
-        if (it != studentMap.end()) {
-            return &(it->second);
-        }
-        return nullptr;
+    bool ready() const { return fd >= 0; }
+    bool hasFeature(unsigned feature) const { return (features & feature) != 0; }
+    
+    // Pins buffers once so reads into them skip the per-call page mapping
+    bool registerBuffers(const iovec* buffers, unsigned count) {
+        return syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, buffers, count) == 0;
     }
     
-    bool searchClassmate(const string& prn, float& percentage) {
-        string searchPRN = prn;
-        transform(searchPRN.begin(), searchPRN.end(), searchPRN.begin(), ::toupper);
-        
-        auto it = classPercentageMap.find(searchPRN);
-        if (it != classPercentageMap.end()) {
-            percentage = it->second;
-            return true;
-        }
-        return false;
+    // A zeroed submission entry, nullptr when the queue is full
+    io_uring_sqe* prepare(uint64_t userData) {
+        if (localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) return nullptr;
+        unsigned index = localTail & *sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = userData;
+        sqArray[index] = index;
+        localTail++;
+        return sqe;
     }
     
-    string getAllStudentsJSON() {
-        stringstream ss;
-        ss << "[";
-        bool first = true;
-        for (auto& pair : studentMap) {
-            if (!first) ss << ",";
-            first = false;
-            ss << pair.second.toJSON();
+    // Hands every prepared entry to the kernel, waiting for waitFor completions
+    bool submit(unsigned waitFor = 0) {
+        unsigned pending = localTail - *sqTail;
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        while (true) {
+            long r = syscall(__NR_io_uring_enter, fd, pending, waitFor, waitFor ? IORING_ENTER_GETEVENTS : 0,
+                             nullptr, 0);
+            if (r >= 0) return true;
+            if (errno != EINTR) return false;
         }
-        ss << "]";
-        return ss.str();
     }
     
-    string getClassmateJSON(const string& prn) {
-        float perc;
-        if (searchClassmate(prn, perc)) {
-            char grade;
-            if (perc >= 90) grade = 'A';
-            else if (perc >= 75) grade = 'B';
-            else if (perc >= 60) grade = 'C';
-            else if (perc >= 50) grade = 'D';
-            else if (perc >= 40) grade = 'E';
-            else grade = 'F';
-            
-            stringstream ss;
-            ss << "{\"success\":true,\"prn\":\"" << prn 
-               << "\",\"percentage\":" << fixed << setprecision(2) << perc
-               << ",\"grade\":\"" << grade << "\"}";
-            return ss.str();
+    // Next completion, blocking until there is one
+    bool complete(uint64_t& userData, int& result) {
+        while (true) {
+            unsigned head = *cqHead;
+            if (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& cqe = cqes[head & *cqMask];
+                userData = cqe.user_data;
+                result = cqe.res;
+                __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+            if (!submit(1)) return false;
         }
-        return "{\"success\":false,\"error\":\"PRN not found\"}";
     }
 };
+#endif
 
-// ==================== WEB BRIDGE ====================
-void handleWebRequest(ResultManager& manager) {
-    string command;
-    getline(cin, command);
+// A whole file read front to back in IO_BLOCK pieces, as a streambuf so the
+// line parsers can getline() over it. The pieces come from io_uring (up to
+// IO_DEPTH in flight) or from pread, one at a time.
+class BlockFileReader : public streambuf {
+private:
+    struct Block {
+        char* data = nullptr;
+        uint64_t offset = 0;
+        size_t length = 0;   // bytes asked for
+        size_t filled = 0;   // bytes read so far
+        size_t sequence = 0; // position of this piece in the file, counted in blocks
+        bool ready = false;
+    };
     
-    try {
-        if (command.substr(0, 3) == "ADD") {
-            stringstream ss(command);
-            string token;
-            vector<string> parts;
-            
-            // Split command into parts
-            while (getline(ss, token, '|')) {
-                parts.push_back(token);
-            }
-            
-            // Validate minimum required parts
-            if (parts.size() < 4) {
-                cout << "{\"error\":\"Invalid command format\"}" << endl;
-                return;
-            }
-            
-            string prn = parts[1];
-            string studentName = parts[2];
-            
-            // Validate course count
-            int courseCount;
-            try {
-                courseCount = stoi(parts[3]);
-                if (courseCount <= 0) {
-                    cout << "{\"error\":\"Invalid course count\"}" << endl;
-                    return;
-                }
-            } catch (...) {
-                cout << "{\"error\":\"Invalid course count format\"}" << endl;
-                return;
-            }
-            
-            // Validate we have enough parts for all courses
-            if (parts.size() < 4 + (courseCount * 4)) {
-                cout << "{\"error\":\"Missing course data\"}" << endl;
-                return;
-            }
-            
-            Student student(studentName, prn);
-            
-            // Process each course
-            for (int i = 0; i < courseCount; i++) {
-                int baseIndex = 4 + (i * 4);
-                string code = parts[baseIndex];
-                string name = parts[baseIndex + 1];
-                
-                // Safely parse marks
-                int marks, maxMarks;
-                try {
-                    marks = stoi(parts[baseIndex + 2]);
-                    maxMarks = stoi(parts[baseIndex + 3]);
-                    
-                    if (marks < 0 || maxMarks <= 0 || marks > maxMarks) {
-                        cout << "{\"error\":\"Invalid marks range\"}" << endl;
-                        return;
-                    }
-                } catch (...) {
-                    cout << "{\"error\":\"Invalid marks format\"}" << endl;
-                    return;
-                }
-                
-                Course c(code, name, marks, maxMarks);
-                student.addCourse(c);
+    vector<Block> blocks;
+    size_t nextBlock = 0;        // sequence number of the block the parser reads next
+    uint64_t nextOffset = 0;     // first byte not yet asked for
+    uint64_t size = 0;
+    bool failed = false;
+#ifdef _WIN32
+    FILE* file = nullptr;
+#else
+    int fd = -1;
+#endif
+#ifdef RESULT_IO_URING
+    unique_ptr<IoRing> ring;
+    bool registered = false;
+    size_t issuedBlocks = 0;
+    unsigned inFlight = 0;
+    
+    void issue(size_t slot) {
+        Block& b = blocks[slot];
+        io_uring_sqe* sqe = ring->prepare(slot);
+        inFlight++;
+        sqe->fd = fd;
+        sqe->off = b.offset + b.filled;
+        sqe->addr = (uint64_t)(uintptr_t)(b.data + b.filled);
+        sqe->len = (uint32_t)(b.length - b.filled);
+        if (registered) {
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->buf_index = (uint16_t)slot;
+        } else {
+            sqe->opcode = IORING_OP_READ;
+        }
+    }
+    
+    // Queue the next unread piece of the file into a free slot
+    void startBlock(size_t slot) {
+        Block& b = blocks[slot];
+        b.sequence = issuedBlocks++;
+        b.offset = nextOffset;
+        b.length = (size_t)min<uint64_t>(IO_BLOCK, size - nextOffset);
+        b.filled = 0;
+        b.ready = false;
+        nextOffset += b.length;
+        issue(slot);
+    }
+    
+    // Reap completions until the slot is full; short reads are continued
+    bool waitFor(size_t slot) {
+        while (!blocks[slot].ready) {
+            uint64_t done;
+            int result;
+            if (!ring->complete(done, result)) return false;
+            inFlight--;
+            Block& b = blocks[(size_t)done];
+            if (result == -EINTR || result == -EAGAIN) {
+                issue((size_t)done);
+            } else if (result <= 0) {
+                // An error, or the file shrank underneath us: stop at what was read
+                if (result < 0) return false;
+                b.length = b.filled;
+                b.ready = true;
+                size = min(size, b.offset + b.filled);
+            } else {
+                b.filled += (size_t)result;
+                if (b.filled < b.length) issue((size_t)done);
+                else b.ready = true;
             }
-            
-            manager.addStudent(student);
-            cout << student.toJSON() << endl;
+            if (!ring->submit()) return false;
         }
-        else if (command == "GET_ALL") {
-            cout << manager.getAllStudentsJSON() << endl;
+        return true;
+    }
+#endif
+    
+    // Next piece through pread (or fread)
+    bool readPlain(Block& b) {
+        b.offset = nextOffset;
+        b.filled = 0;
+        while (b.filled < IO_BLOCK) {
+#ifdef _WIN32
+            size_t n = fread(b.data + b.filled, 1, IO_BLOCK - b.filled, file);
+            if (n == 0) break;
+#else
+            ssize_t n = pread(fd, b.data + b.filled, IO_BLOCK - b.filled, (off_t)(b.offset + b.filled));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+#endif
+            b.filled += (size_t)n;
         }
-        else if (command.substr(0, 6) == "SEARCH") {
-            string prn = command.substr(7);
-            Student* s = manager.searchStudent(prn);
-            if (s) {
-                cout << s->toJSON() << endl;
-            } else {
-                cout << "{\"error\":\"Student not found\"}" << endl;
+        nextOffset += b.filled;
+        return b.filled > 0;
+    }
+    
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+        if (failed) return traits_type::eof();
+        Block* b = nullptr;
+#ifdef RESULT_IO_URING
+        if (ring) {
+            // The slot parsed last is free again: put it to work on the next
+            // unread piece. Pieces go round the slots in file order.
+            if (nextBlock > 0 && nextOffset < size) {
+                startBlock((nextBlock - 1) % blocks.size());
+                if (!ring->submit()) failed = true;
             }
+            size_t slot = nextBlock % blocks.size();
+            if (failed || nextBlock >= issuedBlocks || !waitFor(slot)) {
+                failed = true;
+                return traits_type::eof();
+            }
+            b = &blocks[slot];
+            if (b->filled == 0) return traits_type::eof();
+        }
+#endif
+        if (!b) {
+            b = &blocks[0];
+            if (!readPlain(*b)) return traits_type::eof();
         }
-        else if (command.substr(0, 9) == "CLASSMATE") {
-            string prn = command.substr(10);
-            cout << manager.getClassmateJSON(prn) << endl;
+        nextBlock++;
+        setg(b->data, b->data, b->data + b->filled);
+        return traits_type::to_int_type(*gptr());
+    }
+    
+public:
+    BlockFileReader(const string& path, IoMode mode) {
+#ifdef _WIN32
+        (void)mode;
+        file = fopen(path.c_str(), "rb");
+        if (!file) return;
+#else
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0) size = (uint64_t)st.st_size;
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);  // a larger kernel readahead window
+#endif
+#endif
+#ifdef RESULT_IO_URING
+        // One block gains nothing from the ring; bigger files keep IO_DEPTH reads in flight
+        if (mode == IoMode::Auto && size > IO_BLOCK) {
+            ring = make_unique<IoRing>(IO_DEPTH * 2);
+            if (!ring->ready()) ring.reset();
         }
-        else {
-            cout << "{\"error\":\"Invalid command\"}" << endl;
+#endif
+        size_t count = 1;
+#ifdef RESULT_IO_URING
+        if (ring) count = IO_DEPTH;
+#endif
+        blocks.resize(count);
+        for (auto& b : blocks) b.data = static_cast<char*>(::operator new(IO_BLOCK, align_val_t(4096)));
+#ifdef RESULT_IO_URING
+        if (ring) {
+            vector<iovec> buffers;
+            for (auto& b : blocks) buffers.push_back({b.data, IO_BLOCK});
+            registered = ring->registerBuffers(buffers.data(), (unsigned)buffers.size());
+            for (size_t i = 0; i < blocks.size() && nextOffset < size; i++) startBlock(i);
+            if (!ring->submit()) failed = true;
         }
+#endif
     }
-    catch (const exception& e) {
-        cout << "{\"error\":\"Data processing error\"}" << endl;
+    
+    BlockFileReader(const BlockFileReader&) = delete;
+    BlockFileReader& operator=(const BlockFileReader&) = delete;
+    
+    ~BlockFileReader() {
+#ifdef RESULT_IO_URING
+        // Reads still in flight write into the blocks: wait them out
+        uint64_t done;
+        int result;
+        while (ring && inFlight > 0 && ring->complete(done, result)) inFlight--;
+        ring.reset();
+#endif
+        for (auto& b : blocks) ::operator delete(b.data, align_val_t(4096));
+#ifdef _WIN32
+        if (file) fclose(file);
+#else
+        if (fd >= 0) ::close(fd);
+#endif
     }
-}
+    
+    bool isOpen() const {
+#ifdef _WIN32
+        return file != nullptr;
+#else
+        return fd >= 0;
+#endif
+    }
+    
+    const char* backendName() const {
+#ifdef RESULT_IO_URING
+        if (ring) return registered ? "io_uring (registered buffers)" : "io_uring";
+#endif
+        return "pread";
+    }
+};
 
-// ==================== MAIN ====================
-int main(int argc, char* argv[]) {
-    ResultManager manager("reportcards.txt", "sample_se1.csv");
+// The file a PersistenceWriter appends to. It stays open between batches
+// and is reopened when the path no longer names it (compaction renamed a
+// new file into place, or it was deleted) and after every writer control
+// item. With sync, the batch is on disk when append() returns.
+class AppendFile {
+private:
+    string path;
+    IoMode mode;
+#ifndef _WIN32
+    int fd = -1;
+    dev_t device = 0;
+    ino_t inode = 0;
+#endif
+#ifdef RESULT_IO_URING
+    unique_ptr<IoRing> ring;
+    bool ringTried = false;
     
-    // Check if running in web mode (with command line argument)
-    if (argc > 1 && string(argv[1]) == "--web") {
-        // Web bridge mode - process single command from stdin
-        handleWebRequest(manager);
-        return 0;
+    enum class RingResult {
+        Done,
+        Fallback,  // ring trouble, an unsupported opcode or a short write: finish on the plain path
+        Failed     // the write or the fsync itself failed; retrying could hide the error
+    };
+    
+    static bool unsupported(int result) {
+        return result == -EINVAL || result == -EOPNOTSUPP;
     }
     
-    // Regular console mode
-    cout << "\n╔════════════════════════════════════════════════╗\n";
-    cout << "║   STUDENT RESULT MANAGEMENT SYSTEM (OOP)      ║\n";
-    cout << "╚════════════════════════════════════════════════╝\n";
+    // Write and fsync linked into one submission (*written bytes went out)
+    RingResult appendRing(const char* data, size_t length, bool sync, size_t& written) {
+        written = 0;
+        io_uring_sqe* sqe = ring->prepare(1);
+        if (!sqe) return RingResult::Fallback;
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->off = (uint64_t)-1;   // the file position; O_APPEND makes that the end
+        sqe->addr = (uint64_t)(uintptr_t)data;
+        sqe->len = (uint32_t)length;
+        if (sync) {
+            sqe->flags |= IOSQE_IO_LINK;  // the fsync only runs if the whole write did
+            io_uring_sqe* fsync = ring->prepare(2);
+            if (!fsync) return RingResult::Fallback;
+            fsync->opcode = IORING_OP_FSYNC;
+            fsync->fd = fd;
+        }
+        unsigned expected = sync ? 2 : 1;
+        if (!ring->submit(expected)) return RingResult::Fallback;
+        
+        int writeResult = 0, fsyncResult = 0;
+        for (unsigned i = 0; i < expected; i++) {
+            uint64_t which;
+            int result;
+            if (!ring->complete(which, result)) return RingResult::Fallback;
+            (which == 1 ? writeResult : fsyncResult) = result;
+        }
+        if (writeResult < 0) return unsupported(writeResult) ? RingResult::Fallback : RingResult::Failed;
+        written = (size_t)writeResult;
+        if (written < length) return RingResult::Fallback;  // the fsync was cancelled with it
+        if (fsyncResult < 0) return unsupported(fsyncResult) ? RingResult::Fallback : RingResult::Failed;
+        return RingResult::Done;
+    }
+#endif
     
-    int choice;
+#ifndef _WIN32
+    bool open() {
+        if (fd >= 0) {
+            struct stat named;
+            if (::stat(path.c_str(), &named) == 0 && named.st_dev == device && named.st_ino == inode) return true;
+            close();
+        }
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            device = st.st_dev;
+            inode = st.st_ino;
+        }
+#ifdef RESULT_IO_URING
+        if (!ringTried && mode == IoMode::Auto) {
+            ringTried = true;
+            ring = make_unique<IoRing>(4);
+            // Appending at the file position needs IORING_FEAT_RW_CUR_POS (5.6+)
+            if (!ring->ready() || !ring->hasFeature(IORING_FEAT_RW_CUR_POS)) ring.reset();
+        }
+#endif
+        return true;
+    }
+#endif
+    
+public:
+    AppendFile(string file, IoMode m) : path(std::move(file)), mode(m) {}
+    
+    AppendFile(const AppendFile&) = delete;
+    AppendFile& operator=(const AppendFile&) = delete;
+    ~AppendFile() { close(); }
+    
+    bool append(const string& data, bool sync) {
+#ifdef _WIN32
+        (void)mode;
+        FILE* f = fopen(path.c_str(), "ab");
+        if (!f) return false;
+        bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+        if (sync) ok = fflush(f) == 0 && _commit(_fileno(f)) == 0 && ok;
+        return (fclose(f) == 0) && ok;
+#else
+        if (!open()) return false;
+        size_t done = 0;
+#ifdef RESULT_IO_URING
+        if (ring) {
+            RingResult result = appendRing(data.data(), data.size(), sync, done);
+            if (result == RingResult::Done) return true;
+            // A failed fsync is not retried: after a writeback error a second
+            // fsync usually succeeds without the data being on disk
+            if (result == RingResult::Failed) return false;
+            // A kernel without IORING_OP_WRITE/FSYNC, or a short write: finish
+            // on the plain path and stay there
+            ring.reset();
+        }
+#endif
+        while (done < data.size()) {
+            ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            done += (size_t)n;
+        }
+        return !sync || fsync(fd) == 0;
+#endif
+    }
+    
+    void close() {
+#ifndef _WIN32
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+    }
+    
+    // What the last append went through
+    const char* backendName() const {
+#ifdef RESULT_IO_URING
+        if (ring) return "io_uring";
+#endif
+        return "write";
+    }
+};
+
+// ==================== PERSISTENCE PIPELINE ====================
+// ADD no longer opens/appends/closes reportcards.txt itself. Records are
+// pushed onto a lock-free multi-producer queue and a dedicated writer thread
+// drains it in batches (one write + flush per batch, plus fsync if asked).
+enum class DurabilityMode {
+    Enqueue,  // acknowledge as soon as the record is queued
+    Fsync     // acknowledge once the batch holding the record is fsync'ed
+};
+
+class PersistenceWriter {
+public:
+    // Completion slot, owned by whoever waits on it
+    struct DurableWaiter {
+        mutex m;
+        condition_variable cv;
+        bool done = false;
+        bool ok = true;   // false when the batch's write or fsync failed
+    };
+    
+    // Runs on the writer thread with the data file name, between batches
+    typedef function<void(const string&)> Control;
+    
+private:
+    struct PendingRecord {
+        atomic<PendingRecord*> next;
+        string text;
+        DurableWaiter* waiter;
+        Control control;
+        
+        PendingRecord() : next(nullptr), waiter(nullptr) {}
+    };
+    
+    static const size_t MAX_BATCH = 256;
+    
+    string filename;
+    DurabilityMode mode;
+    AppendFile file;
+    
+    // Vyukov MPSC queue: producers exchange on head, the writer pops from tail
+    atomic<PendingRecord*> head;
+    PendingRecord* tail;
+    
+    atomic<bool> sleeping;
+    atomic<bool> stopping;
+    mutex wakeMutex;
+    condition_variable wakeCv;
+    bool wakeSignal;
+    thread worker;
+    
+    void push(PendingRecord* rec) {
+        PendingRecord* prev = head.exchange(rec);
+        prev->next.store(rec);
+        
+        if (sleeping.load()) {
+            lock_guard<mutex> lock(wakeMutex);
+            wakeSignal = true;
+            wakeCv.notify_one();
+        }
+    }
+    
+    PendingRecord* pop() {
+        PendingRecord* next = tail->next.load(memory_order_acquire);
+        if (!next) return nullptr;
+        delete tail;
+        tail = next;
+        return next;  // stays allocated as the new stub until the next pop
+    }
+    
+    static void markDone(DurableWaiter* w, bool ok = true) {
+        lock_guard<mutex> lock(w->m);
+        w->done = true;
+        w->ok = ok;
+        w->cv.notify_one();
+    }
+    
+    void run() {
+        vector<DurableWaiter*> waiters;
+        string batch;
+        
+        while (true) {
+            batch.clear();
+            waiters.clear();
+            PendingRecord* control = nullptr;
+            
+            size_t count = 0;
+            while (count < MAX_BATCH) {
+                PendingRecord* rec = pop();
+                if (!rec) break;
+                count++;
+                if (rec->control) {
+                    // Everything queued before the control item is written first
+                    control = rec;
+                    break;
+                }
+                batch += rec->text;
+                rec->text = string();
+                if (rec->waiter) waiters.push_back(rec->waiter);
+            }
+            
+            if (count == 0) {
+                if (stopping.load()) break;
+                
+                sleeping.store(true);
+                if (tail->next.load() == nullptr && !stopping.load()) {
+                    unique_lock<mutex> lock(wakeMutex);
+                    wakeCv.wait_for(lock, chrono::milliseconds(100), [this] { return wakeSignal; });
+                    wakeSignal = false;
+                }
+                sleeping.store(false);
+                continue;
+            }
+            
+            bool written = batch.empty() || file.append(batch, mode == DurabilityMode::Fsync);
+            if (!written) {
+                // Reopen for the next batch rather than trust a descriptor that failed
+                file.close();
+                cerr << "Writer: could not " << (mode == DurabilityMode::Fsync ? "write and fsync " : "write ")
+                     << batch.size() << " bytes to " << filename << endl;
+            }
+            for (auto* w : waiters) markDone(w, written);
+            
+            if (control) {
+                // The control item may swap the file (compaction): reopen after it
+                file.close();
+                control->control(filename);
+                control->control = Control();
+                markDone(control->waiter);
+            }
+        }
+    }
+    
+public:
+    static bool syncFile(FILE* f) {
+        if (fflush(f) != 0) return false;
+#ifdef _WIN32
+        return _commit(_fileno(f)) == 0;
+#else
+        return fsync(fileno(f)) == 0;
+#endif
+    }
+    
+    PersistenceWriter(string path, DurabilityMode m, IoMode io = IoMode::Auto)
+        : filename(path), mode(m), file(path, io), head(nullptr), tail(nullptr),
+          sleeping(false), stopping(false), wakeSignal(false) {
+        PendingRecord* stub = new PendingRecord();
+        head.store(stub);
+        tail = stub;
+        worker = thread(&PersistenceWriter::run, this);
+    }
+    
+    PersistenceWriter(const PersistenceWriter&) = delete;
+    PersistenceWriter& operator=(const PersistenceWriter&) = delete;
+    
+    ~PersistenceWriter() {
+        stopping.store(true);
+        {
+            lock_guard<mutex> lock(wakeMutex);
+            wakeSignal = true;
+            wakeCv.notify_one();
+        }
+        worker.join();  // run() only exits once the queue is empty
+        delete tail;
+    }
+    
+    DurabilityMode getMode() const { return mode; }
+    
+    // Queue a record without blocking. In Fsync mode the returned waiter is
+    // signalled once the record is on disk, in Enqueue mode it is null.
+    shared_ptr<DurableWaiter> enqueue(string text) {
+        PendingRecord* rec = new PendingRecord();
+        rec->text = std::move(text);
+        if (mode == DurabilityMode::Enqueue) {
+            push(rec);
+            return nullptr;
+        }
+        auto waiter = make_shared<DurableWaiter>();
+        rec->waiter = waiter.get();
+        push(rec);
+        return waiter;
+    }
+    
+    // Queue fn to run on the writer thread once every record queued before it
+    // is written. Pass the result to wait().
+    shared_ptr<DurableWaiter> post(Control fn) {
+        auto waiter = make_shared<DurableWaiter>();
+        PendingRecord* rec = new PendingRecord();
+        rec->control = std::move(fn);
+        rec->waiter = waiter.get();
+        push(rec);
+        return waiter;
+    }
+    
+    // False when the record's batch could not be written (or fsync'ed)
+    static bool wait(const shared_ptr<DurableWaiter>& waiter) {
+        unique_lock<mutex> lock(waiter->m);
+        waiter->cv.wait(lock, [&waiter] { return waiter->done; });
+        return waiter->ok;
+    }
+    
+    // Block until everything queued so far has been written
+    void flush() {
+        PendingRecord* rec = new PendingRecord();
+        DurableWaiter waiter;
+        rec->waiter = &waiter;
+        push(rec);
+        
+        unique_lock<mutex> lock(waiter.m);
+        waiter.cv.wait(lock, [&waiter] { return waiter.done; });
+    }
+};
+
+// ==================== WORK-STEALING SCHEDULER ====================
+// Batch jobs (re-grading, per-course statistics, exports) run here instead of
+// on the thread that answers commands. Each worker owns a deque: it pushes and
+// pops at the back, idle workers steal from the front of someone else's.
+class WorkStealingPool {
+public:
+    typedef function<void()> Task;
+    
+private:
+    struct WorkerQueue {
+        mutex m;
+        deque<Task> tasks;
+    };
+    
+    vector<unique_ptr<WorkerQueue>> queues;
+    vector<thread> workers;
+    atomic<bool> stopping;
+    atomic<size_t> queued;
+    atomic<size_t> roundRobin;
+    mutex sleepMutex;
+    condition_variable sleepCv;
+    
+    static thread_local const WorkStealingPool* currentPool;
+    static thread_local size_t currentWorker;
+    
+    bool popLocal(size_t i, Task& task) {
+        lock_guard<mutex> lock(queues[i]->m);
+        if (queues[i]->tasks.empty()) return false;
+        task = std::move(queues[i]->tasks.back());
+        queues[i]->tasks.pop_back();
+        return true;
+    }
+    
+    bool steal(size_t thief, Task& task) {
+        for (size_t k = 1; k <= queues.size(); k++) {
+            WorkerQueue& victim = *queues[(thief + k) % queues.size()];
+            lock_guard<mutex> lock(victim.m);
+            if (victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+    
+    void workerLoop(size_t i) {
+        currentPool = this;
+        currentWorker = i;
+        
+        while (true) {
+            Task task;
+            if (popLocal(i, task) || steal(i, task)) {
+                queued--;
+                // A task that throws must not take the worker down with it
+                try {
+                    task();
+                }
+                catch (const exception& e) {
+                    cerr << "Pool task failed: " << e.what() << endl;
+                }
+                catch (...) {
+                    cerr << "Pool task failed" << endl;
+                }
+                continue;
+            }
+            
+            unique_lock<mutex> lock(sleepMutex);
+            if (stopping) break;
+            sleepCv.wait(lock, [this] { return stopping.load() || queued.load() > 0; });
+            if (stopping) break;
+        }
+    }
+    
+public:
+    explicit WorkStealingPool(size_t threads) : stopping(false), queued(0), roundRobin(0) {
+        if (threads == 0) threads = 1;
+        for (size_t i = 0; i < threads; i++) queues.push_back(make_unique<WorkerQueue>());
+        for (size_t i = 0; i < threads; i++) workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+    
+    ~WorkStealingPool() {
+        {
+            lock_guard<mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        sleepCv.notify_all();
+        for (auto& t : workers) t.join();
+    }
+    
+    size_t size() const { return workers.size(); }
+    
+    void submit(Task task) {
+        size_t i = (currentPool == this) ? currentWorker : roundRobin++ % queues.size();
+        {
+            lock_guard<mutex> lock(queues[i]->m);
+            queues[i]->tasks.push_back(std::move(task));
+        }
+        queued++;
+        {
+            lock_guard<mutex> lock(sleepMutex);
+        }
+        sleepCv.notify_one();
+    }
+    
+};
+
+thread_local const WorkStealingPool* WorkStealingPool::currentPool = nullptr;
+thread_local size_t WorkStealingPool::currentWorker = 0;
+
+// Leaves one core for the thread answering interactive commands
+WorkStealingPool& sharedPool() {
+    // hardware_concurrency() may be 0 (unknown): that gets one worker
+    static WorkStealingPool pool(max(2u, thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+// Fork/join helper: run() fans tasks out, wait() helps until they finish.
+// The group keeps its own list of tasks not started yet. A pool worker and
+// wait() both take from that list, so a waiting thread only ever runs this
+// group's tasks, never an unrelated job queued in the pool. The first
+// exception a task throws is rethrown from wait() once every task is done.
+class TaskGroup {
+private:
+    // Shared with the pool tasks, which may run after the group is gone
+    struct State {
+        mutex m;
+        condition_variable finished;
+        deque<WorkStealingPool::Task> unstarted;
+        size_t pending = 0;  // unstarted or running
+        exception_ptr failure;
+    };
+    
+    WorkStealingPool& pool;
+    shared_ptr<State> state;
+    
+    static bool runNext(const shared_ptr<State>& st) {
+        WorkStealingPool::Task task;
+        {
+            lock_guard<mutex> lock(st->m);
+            if (st->unstarted.empty()) return false;
+            task = std::move(st->unstarted.front());
+            st->unstarted.pop_front();
+        }
+        exception_ptr failure;
+        try {
+            task();
+        }
+        catch (...) {
+            failure = current_exception();
+        }
+        lock_guard<mutex> lock(st->m);
+        if (failure && !st->failure) st->failure = failure;
+        if (--st->pending == 0) st->finished.notify_all();
+        return true;
+    }
+    
+    void finish() {
+        while (runNext(state)) {}
+        unique_lock<mutex> lock(state->m);
+        state->finished.wait(lock, [this] { return state->pending == 0; });
+    }
+    
+public:
+    explicit TaskGroup(WorkStealingPool& p) : pool(p), state(make_shared<State>()) {}
+    // Only reached without wait() when the caller is already unwinding
+    ~TaskGroup() { finish(); }
+    
+    void run(WorkStealingPool::Task task) {
+        {
+            lock_guard<mutex> lock(state->m);
+            state->unstarted.push_back(std::move(task));
+            state->pending++;
+        }
+        shared_ptr<State> st = state;
+        pool.submit([st]() { runNext(st); });
+    }
+    
+    void wait() {
+        finish();
+        exception_ptr failure;
+        swap(failure, state->failure);
+        if (failure) rethrow_exception(failure);
+    }
+};
+
+// ==================== BATCH JOBS ====================
+enum class JobState { Queued, Running, Done, Cancelled, Failed };
+
+const char* jobStateName(JobState s) {
+    switch (s) {
+        case JobState::Queued: return "queued";
+        case JobState::Running: return "running";
+        case JobState::Done: return "done";
+        case JobState::Cancelled: return "cancelled";
+        case JobState::Failed: return "failed";
+    }
+    return "unknown";
+}
+
+struct Job {
+    uint64_t id = 0;
+    string type;
+    atomic<JobState> state{JobState::Queued};
+    atomic<size_t> done{0};
+    atomic<size_t> total{0};
+    atomic<bool> cancelled{false};
+    chrono::steady_clock::time_point started;
+    
+    mutex resultMutex;
+    string result;  // JSON, filled in when the job finishes
+    
+    bool isCancelled() const { return cancelled.load(); }
+    void advance(size_t n) { done += n; }
+};
+
+typedef function<string(Job&)> JobBody;
+
+class JobManager {
+private:
+    // Finished jobs kept for JOB_STATUS; older ones are dropped
+    static const size_t KEEP_FINISHED = 256;
+    
+    WorkStealingPool& pool;
+    map<uint64_t, shared_ptr<Job>> jobs;
+    mutable mutex jobsMutex;
+    uint64_t nextId;
+    atomic<size_t> active;
+    
+public:
+    explicit JobManager(WorkStealingPool& p) : pool(p), nextId(1), active(0) {}
+    
+    ~JobManager() {
+        // Jobs reference the store that owns this manager: stop them first
+        {
+            lock_guard<mutex> lock(jobsMutex);
+            for (auto& pair : jobs) pair.second->cancelled = true;
+        }
+        while (active.load() > 0) this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    
+    shared_ptr<Job> submit(const string& type, JobBody body) {
+        auto job = make_shared<Job>();
+        job->type = type;
+        {
+            lock_guard<mutex> lock(jobsMutex);
+            job->id = nextId++;
+            jobs[job->id] = job;
+            pruneFinished();
+        }
+        
+        active++;
+        pool.submit([this, job, body]() {
+            job->started = chrono::steady_clock::now();
+            job->state = JobState::Running;
+            string out;
+            JobState finalState = JobState::Done;
+            try {
+                out = body(*job);
+                if (job->isCancelled()) finalState = JobState::Cancelled;
+            } catch (const exception& e) {
+                cerr << "Job " << job->id << " (" << job->type << ") failed: " << e.what() << endl;
+                out = "{\"error\":\"Job failed\"}";
+                finalState = JobState::Failed;
+            } catch (...) {
+                cerr << "Job " << job->id << " (" << job->type << ") failed" << endl;
+                out = "{\"error\":\"Job failed\"}";
+                finalState = JobState::Failed;
+            }
+            {
+                lock_guard<mutex> lock(job->resultMutex);
+                job->result = out;
+            }
+            job->state = finalState;
+            active--;
+        });
+        return job;
+    }
+    
+    // Drops the oldest finished jobs beyond KEEP_FINISHED; jobsMutex held
+    void pruneFinished() {
+        size_t finished = 0;
+        for (const auto& pair : jobs) {
+            JobState st = pair.second->state.load();
+            if (st != JobState::Queued && st != JobState::Running) finished++;
+        }
+        for (auto it = jobs.begin(); it != jobs.end() && finished > KEEP_FINISHED;) {
+            JobState st = it->second->state.load();
+            if (st == JobState::Queued || st == JobState::Running) {
+                ++it;
+                continue;
+            }
+            it = jobs.erase(it);
+            finished--;
+        }
+    }
+    
+    shared_ptr<Job> find(uint64_t id) const {
+        lock_guard<mutex> lock(jobsMutex);
+        auto it = jobs.find(id);
+        return (it != jobs.end()) ? it->second : nullptr;
+    }
+    
+    // The cancelled job, or null when there is no such job
+    shared_ptr<Job> cancel(uint64_t id) {
+        auto job = find(id);
+        if (job) job->cancelled = true;
+        return job;
+    }
+    
+    static string statusJSON(Job& job) {
+        JobState st = job.state.load();
+        size_t total = job.total.load(), done = job.done.load();
+        stringstream ss;
+        ss << "{\"jobId\":" << job.id << ",\"type\":\"" << job.type
+           << "\",\"state\":\"" << jobStateName(st) << "\""
+           << ",\"done\":" << done << ",\"total\":" << total
+           << ",\"progress\":" << fixed << setprecision(2)
+           << (total ? (double)done / total : (st == JobState::Done ? 1.0 : 0.0));
+        if (st == JobState::Done || st == JobState::Failed) {
+            lock_guard<mutex> lock(job.resultMutex);
+            ss << ",\"result\":" << (job.result.empty() ? "null" : job.result);
+        }
+        ss << "}";
+        return ss.str();
+    }
+};
+
+// ==================== BINARY ENCODING ====================
+template <typename T>
+void putRaw(string& out, T v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+void putString(string& out, const string& v) {
+    putRaw<uint32_t>(out, (uint32_t)v.size());
+    out += v;
+}
+
+// Bounds-checked reader over an in-memory file image
+class ByteReader {
+private:
+    const char* data;
+    size_t size;
+    size_t pos;
+    
+public:
+    ByteReader(const char* d, size_t n) : data(d), size(n), pos(0) {}
+    
+    bool ok(size_t n) const { return n <= size - pos; }
+    size_t position() const { return pos; }
+    void seek(size_t p) { pos = min(p, size); }
+    
+    template <typename T>
+    bool get(T& v) {
+        if (!ok(sizeof(T))) return false;
+        memcpy(&v, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+    
+    bool getBytes(size_t n, const char*& p) {
+        if (!ok(n)) return false;
+        p = data + pos;
+        pos += n;
+        return true;
+    }
+    
+    bool getString(string& v) {
+        uint32_t n;
+        const char* p;
+        if (!get(n) || !getBytes(n, p)) return false;
+        v.assign(p, n);
+        return true;
+    }
+};
+
+void putStringView(string& out, string_view v) {
+    putRaw<uint32_t>(out, (uint32_t)v.size());
+    out.append(v.data(), v.size());
+}
+
+// Pass the previous result as seed to checksum data that arrives in pieces.
+// Slicing-by-8: eight table lookups per 8 input bytes instead of one per byte.
+uint32_t crc32(const char* data, size_t n, uint32_t seed = 0) {
+    static uint32_t table[8][256];
+    static once_flag init;
+    call_once(init, [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int t = 1; t < 8; t++) table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xFF];
+        }
+    });
+    const unsigned char* p = (const unsigned char*)data;
+    uint32_t crc = seed ^ 0xFFFFFFFFu;
+    for (; n >= 8; n -= 8, p += 8) {
+        uint32_t lo = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24);
+        uint32_t hi = p[4] | p[5] << 8 | p[6] << 16 | (uint32_t)p[7] << 24;
+        crc = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^ table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24] ^
+              table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF] ^ table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+    }
+    for (; n > 0; n--, p++) crc = table[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// ==================== LZ4 BLOCK CODEC ====================
+// Standard LZ4 block format (token, literals, 16-bit offset, match length),
+// greedy matcher over a 64K-entry hash of 4-byte sequences.
+const size_t LZ4_MIN_MATCH = 4;
+const size_t LZ4_LAST_LITERALS = 5;
+const size_t LZ4_MATCH_FIND_LIMIT = 12;
+const int LZ4_HASH_LOG = 16;
+
+inline uint32_t read32(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+void lz4PutLength(string& out, size_t len) {
+    while (len >= 255) {
+        out += (char)255;
+        len -= 255;
+    }
+    out += (char)len;
+}
+
+void lz4Compress(const char* src, size_t n, string& out) {
+    size_t anchor = 0, ip = 0;
+    
+    if (n > LZ4_MATCH_FIND_LIMIT) {
+        vector<int64_t> table(size_t(1) << LZ4_HASH_LOG, -1);
+        size_t findLimit = n - LZ4_MATCH_FIND_LIMIT;
+        size_t matchLimit = n - LZ4_LAST_LITERALS;
+        
+        while (ip < findLimit) {
+            uint32_t seq = read32(src + ip);
+            uint32_t h = (seq * 2654435761u) >> (32 - LZ4_HASH_LOG);
+            int64_t ref = table[h];
+            table[h] = ip;
+            
+            if (ref < 0 || ip - ref > 65535 || read32(src + ref) != seq) {
+                ip++;
+                continue;
+            }
+            
+            size_t len = LZ4_MIN_MATCH;
+            while (ip + len < matchLimit && src[ref + len] == src[ip + len]) len++;
+            
+            size_t literals = ip - anchor;
+            size_t matchCode = len - LZ4_MIN_MATCH;
+            out += (char)((min<size_t>(literals, 15) << 4) | min<size_t>(matchCode, 15));
+            if (literals >= 15) lz4PutLength(out, literals - 15);
+            out.append(src + anchor, literals);
+            
+            uint16_t offset = (uint16_t)(ip - ref);
+            out += (char)(offset & 0xFF);
+            out += (char)(offset >> 8);
+            if (matchCode >= 15) lz4PutLength(out, matchCode - 15);
+            
+            ip += len;
+            anchor = ip;
+        }
+    }
+    
+    size_t literals = n - anchor;
+    out += (char)(min<size_t>(literals, 15) << 4);
+    if (literals >= 15) lz4PutLength(out, literals - 15);
+    out.append(src + anchor, literals);
+}
+
+// Bounds-checked: returns false on any malformed input instead of overrunning
+bool lz4Decompress(const char* src, size_t srcLen, char* dst, size_t dstLen) {
+    size_t ip = 0, op = 0;
+    
+    auto readLength = [&](size_t& len) {
+        unsigned char b;
+        do {
+            if (ip >= srcLen) return false;
+            b = src[ip++];
+            len += b;
+        } while (b == 255);
+        return true;
+    };
+    
+    while (ip < srcLen) {
+        unsigned char token = src[ip++];
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(literals)) return false;
+        if (literals > srcLen - ip || literals > dstLen - op) return false;
+        memcpy(dst + op, src + ip, literals);
+        ip += literals;
+        op += literals;
+        
+        if (ip == srcLen) break;  // last sequence has no match part
+        
+        if (srcLen - ip < 2) return false;
+        size_t offset = (unsigned char)src[ip] | ((unsigned char)src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) return false;
+        
+        size_t len = token & 15;
+        if (len == 15 && !readLength(len)) return false;
+        len += LZ4_MIN_MATCH;
+        if (len > dstLen - op) return false;
+        
+        const char* match = dst + op - offset;
+        if (offset >= len) {
+            memcpy(dst + op, match, len);
+        } else {
+            for (size_t i = 0; i < len; i++) dst[op + i] = match[i];
+        }
+        op += len;
+    }
+    return op == dstLen;
+}
+
+// ==================== SNAPSHOT FILE ====================
+// ResultManager::writeSnapshot() dumps the whole in-memory state into one
+// payload which is cut into 1 MiB blocks, each LZ4-compressed with a CRC32 of
+// its raw bytes:
+//
+//   "SRSNAP\0\0" u32 version
+//   u32 sources, per source: path, u64 size, i64 mtime  (staleness check)
+//   u64 raw size, u32 blocks, per block: u64 raw offset, u32 raw, u32 packed, u32 crc
+//   compressed blocks back to back
+//
+// Blocks are independent, so loading decompresses them in parallel straight
+// into their final position in the payload buffer.
+const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'S', 'N', 'A', 'P', 0, 0};
+const uint32_t SNAPSHOT_VERSION = 4;  // 2: per-student version, 3: change-feed positions and tombstones,
+                                      // 4: version history and commit times
+const size_t SNAPSHOT_BLOCK = 1 << 20;
+
+struct SourceStamp {
+    string path;
+    int64_t size = -1;  // -1 = file missing
+    int64_t mtime = 0;
+    
+    bool operator==(const SourceStamp& o) const {
+        return path == o.path && size == o.size && mtime == o.mtime;
+    }
+};
+
+SourceStamp stampFile(const string& path) {
+    SourceStamp st;
+    st.path = path;
+    error_code ec;
+    auto size = filesystem::file_size(path, ec);
+    if (ec) return st;
+    auto mtime = filesystem::last_write_time(path, ec);
+    if (ec) return st;
+    st.size = (int64_t)size;
+    st.mtime = (int64_t)mtime.time_since_epoch().count();
+    return st;
+}
+
+string packSnapshot(const vector<SourceStamp>& sources, const string& payload) {
+    size_t blockCount = (payload.size() + SNAPSHOT_BLOCK - 1) / SNAPSHOT_BLOCK;
+    vector<string> packed(blockCount);
+    vector<uint32_t> crcs(blockCount);
+    
+    TaskGroup group(sharedPool());
+    for (size_t i = 0; i < blockCount; i++) {
+        group.run([&, i]() {
+            size_t off = i * SNAPSHOT_BLOCK;
+            size_t len = min(SNAPSHOT_BLOCK, payload.size() - off);
+            lz4Compress(payload.data() + off, len, packed[i]);
+            crcs[i] = crc32(payload.data() + off, len);
+        });
+    }
+    group.wait();
+    
+    string out(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    putRaw<uint32_t>(out, SNAPSHOT_VERSION);
+    putRaw<uint32_t>(out, (uint32_t)sources.size());
+    for (const auto& src : sources) {
+        putString(out, src.path);
+        putRaw<int64_t>(out, src.size);
+        putRaw<int64_t>(out, src.mtime);
+    }
+    putRaw<uint64_t>(out, payload.size());
+    putRaw<uint32_t>(out, (uint32_t)blockCount);
+    for (size_t i = 0; i < blockCount; i++) {
+        putRaw<uint64_t>(out, i * SNAPSHOT_BLOCK);
+        putRaw<uint32_t>(out, (uint32_t)min(SNAPSHOT_BLOCK, payload.size() - i * SNAPSHOT_BLOCK));
+        putRaw<uint32_t>(out, (uint32_t)packed[i].size());
+        putRaw<uint32_t>(out, crcs[i]);
+    }
+    for (const auto& block : packed) out += block;
+    return out;
+}
+
+// Validates the header against the current sources, then restores the payload
+bool unpackSnapshot(const string& image, const vector<SourceStamp>& current, string& payload, string& error) {
+    ByteReader r(image.data(), image.size());
+    const char* magic;
+    uint32_t version, sourceCount;
+    if (!r.getBytes(sizeof(SNAPSHOT_MAGIC), magic) || memcmp(magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        error = "not a snapshot";
+        return false;
+    }
+    if (!r.get(version) || version != SNAPSHOT_VERSION) { error = "unsupported snapshot version"; return false; }
+    
+    if (!r.get(sourceCount) || sourceCount != current.size()) { error = "stale"; return false; }
+    for (const auto& cur : current) {
+        SourceStamp st;
+        if (!r.getString(st.path) || !r.get(st.size) || !r.get(st.mtime)) { error = "corrupt header"; return false; }
+        if (!(st == cur)) { error = "stale"; return false; }
+    }
+    
+    uint64_t rawSize;
+    uint32_t blockCount;
+    if (!r.get(rawSize) || !r.get(blockCount)) { error = "corrupt header"; return false; }
+    
+    struct Block { uint64_t offset; uint32_t raw, packed, crc; size_t at; };
+    vector<Block> blocks(blockCount);
+    for (auto& b : blocks) {
+        if (!r.get(b.offset) || !r.get(b.raw) || !r.get(b.packed) || !r.get(b.crc)) { error = "corrupt block table"; return false; }
+        if (b.offset > rawSize || b.raw > rawSize - b.offset) { error = "corrupt block table"; return false; }
+    }
+    for (auto& b : blocks) {
+        const char* p;
+        b.at = r.position();
+        if (!r.getBytes(b.packed, p)) { error = "truncated snapshot"; return false; }
+    }
+    
+    payload.assign(rawSize, '\0');
+    atomic<bool> failed(false);
+    TaskGroup group(sharedPool());
+    for (const auto& b : blocks) {
+        group.run([&, b]() {
+            char* dst = &payload[0] + b.offset;
+            if (!lz4Decompress(image.data() + b.at, b.packed, dst, b.raw) || crc32(dst, b.raw) != b.crc) {
+                failed = true;
+            }
+        });
+    }
+    group.wait();
+    if (failed) { error = "block checksum mismatch"; return false; }
+    return true;
+}
+
+// ==================== XLSX CLASS LIST ====================
+// Reads the class list straight from an Excel workbook, so a published
+// sheet needs no CSV export. An .xlsx file is a ZIP archive of XML parts.
+// The first worksheet is inflated 32 KiB at a time and fed to a SAX-style
+// scanner, so rows reach the index one by one. Memory stays at the shared
+// string table plus a few buffers, whatever the number of rows.
+
+// Streaming DEFLATE (RFC 1951) decoder over a byte range of a file. next()
+// hands out each newly decoded chunk; the 32 KiB before it stay in the
+// buffer for back-references.
+class Inflater {
+private:
+    static const int FAST_BITS = 10;
+    static const size_t WINDOW = 32768;
+    static const size_t CHUNK = 32768;
+    static const size_t MAX_MATCH = 258;
+
+    // Canonical Huffman code: codes up to FAST_BITS long decode with one
+    // table lookup, longer ones by comparing against each length's range
+    struct Huffman {
+        uint16_t fast[1 << FAST_BITS];   // (length << 9) | symbol, 0 = longer code
+        uint32_t maxCode[17];
+        uint16_t firstCode[16];
+        uint16_t firstSymbol[16];
+        uint16_t symbols[288];
+
+        bool build(const uint8_t* lengths, int count) {
+            int sizes[17] = {0};
+            memset(fast, 0, sizeof(fast));
+            for (int i = 0; i < count; i++) sizes[lengths[i]]++;
+            sizes[0] = 0;
+            int nextCode[16];
+            int code = 0, k = 0;
+            for (int i = 1; i < 16; i++) {
+                if (sizes[i] > (1 << i)) return false;
+                nextCode[i] = code;
+                firstCode[i] = (uint16_t)code;
+                firstSymbol[i] = (uint16_t)k;
+                code += sizes[i];
+                if (sizes[i] && code - 1 >= (1 << i)) return false;   // over-subscribed
+                maxCode[i] = (uint32_t)code << (16 - i);
+                code <<= 1;
+                k += sizes[i];
+            }
+            maxCode[16] = 0x10000;
+            for (int i = 0; i < count; i++) {
+                int len = lengths[i];
+                if (len == 0) continue;
+                symbols[nextCode[len] - firstCode[len] + firstSymbol[len]] = (uint16_t)i;
+                if (len <= FAST_BITS) {
+                    for (int j = reverseBits(nextCode[len], len); j < (1 << FAST_BITS); j += 1 << len) {
+                        fast[j] = (uint16_t)((len << 9) | i);
+                    }
+                }
+                nextCode[len]++;
+            }
+            return true;
+        }
+    };
+
+    FILE* file;
+    uint64_t inputLeft;
+    unsigned char input[65536];
+    size_t inPos = 0, inLen = 0;
+    size_t padding = 0;          // zero bytes made up past the end of the input
+    uint64_t bitBuffer = 0;
+    int bitCount = 0;
+
+    vector<char> out;
+    size_t outPos = 0;
+
+    bool lastBlock = false;
+    bool inBlock = false;
+    bool finished = false;
+    int blockType = 0;
+    size_t storedLeft = 0;
+    Huffman literals, distances;
+    string failure;
+
+    static int reverseBits(int v, int bits) {
+        int r = 0;
+        for (int i = 0; i < bits; i++) {
+            r = (r << 1) | (v & 1);
+            v >>= 1;
+        }
+        return r;
+    }
+
+    void refill() {
+        while (bitCount <= 56) {
+            if (inPos == inLen) {
+                size_t want = (size_t)min<uint64_t>(sizeof(input), inputLeft);
+                inLen = want ? fread(input, 1, want, file) : 0;
+                inputLeft -= inLen;
+                inPos = 0;
+                if (inLen == 0) {
+                    // Decoding may look a little past the last real byte; more than
+                    // that means the stream is cut short
+                    if (++padding > 32) {
+                        fail("truncated data");
+                        bitBuffer = 0;
+                        bitCount = 64;
+                        return;
+                    }
+                    bitCount += 8;
+                    continue;
+                }
+            }
+            bitBuffer |= (uint64_t)input[inPos++] << bitCount;
+            bitCount += 8;
+        }
+    }
+
+    unsigned bits(int n) {
+        if (bitCount < n) refill();
+        unsigned v = (unsigned)(bitBuffer & ((1ull << n) - 1));
+        bitBuffer >>= n;
+        bitCount -= n;
+        return v;
+    }
+
+    int decode(const Huffman& h) {
+        if (bitCount < 16) refill();
+        uint16_t entry = h.fast[bitBuffer & ((1 << FAST_BITS) - 1)];
+        if (entry) {
+            int len = entry >> 9;
+            bitBuffer >>= len;
+            bitCount -= len;
+            return entry & 511;
+        }
+        uint32_t k = (uint32_t)reverseBits((int)(bitBuffer & 0xFFFF), 16);
+        int len = FAST_BITS + 1;
+        while (len < 16 && k >= h.maxCode[len]) len++;
+        if (len >= 16) return fail("bad Huffman code"), -1;
+        int slot = (int)(k >> (16 - len)) - h.firstCode[len] + h.firstSymbol[len];
+        if (slot >= 288) return fail("bad Huffman code"), -1;
+        bitBuffer >>= len;
+        bitCount -= len;
+        return h.symbols[slot];
+    }
+
+    void fail(const string& why) {
+        if (failure.empty()) failure = why;
+        finished = true;
+    }
+
+    bool readDynamicTables() {
+        static const uint8_t ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        int literalCount = (int)bits(5) + 257;
+        int distanceCount = (int)bits(5) + 1;
+        int lengthCount = (int)bits(4) + 4;
+        uint8_t codeLengths[19] = {0};
+        for (int i = 0; i < lengthCount; i++) codeLengths[ORDER[i]] = (uint8_t)bits(3);
+        Huffman lengthCode;
+        if (!lengthCode.build(codeLengths, 19)) return false;
+
+        uint8_t lengths[288 + 32];
+        int n = 0, total = literalCount + distanceCount;
+        while (n < total && !finished) {
+            int sym = decode(lengthCode);
+            if (sym < 0) return false;
+            if (sym < 16) {
+                lengths[n++] = (uint8_t)sym;
+                continue;
+            }
+            int repeat;
+            uint8_t value = 0;
+            if (sym == 16) {
+                if (n == 0) return false;
+                value = lengths[n - 1];
+                repeat = 3 + (int)bits(2);
+            } else if (sym == 17) {
+                repeat = 3 + (int)bits(3);
+            } else {
+                repeat = 11 + (int)bits(7);
+            }
+            if (n + repeat > total) return false;
+            memset(lengths + n, value, repeat);
+            n += repeat;
+        }
+        return literals.build(lengths, literalCount) && distances.build(lengths + literalCount, distanceCount);
+    }
+
+    bool startBlock() {
+        lastBlock = bits(1) != 0;
+        blockType = (int)bits(2);
+        if (blockType == 0) {
+            bits(bitCount & 7);   // stored blocks start on a byte boundary
+            unsigned len = bits(16), nlen = bits(16);
+            if ((len ^ 0xFFFF) != nlen) return false;
+            storedLeft = len;
+        } else if (blockType == 1) {
+            uint8_t lengths[288 + 32];
+            memset(lengths, 8, 144);
+            memset(lengths + 144, 9, 112);
+            memset(lengths + 256, 7, 24);
+            memset(lengths + 280, 8, 8);
+            memset(lengths + 288, 5, 32);
+            literals.build(lengths, 288);
+            distances.build(lengths + 288, 32);
+        } else if (blockType != 2 || !readDynamicTables()) {
+            return false;
+        }
+        inBlock = true;
+        return true;
+    }
+
+    // Decodes one block's symbols until the block ends or `limit` is reached
+    bool inflateBlock(size_t limit) {
+        static const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const uint16_t DIST_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                               513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        static const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7,
+                                               8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+        if (blockType == 0) {
+            while (storedLeft > 0 && outPos < limit && !finished) {
+                out[outPos++] = (char)bits(8);
+                storedLeft--;
+            }
+            if (storedLeft == 0) inBlock = false;
+            return true;
+        }
+        while (outPos < limit && !finished) {
+            int sym = decode(literals);
+            if (sym < 0) return false;
+            if (sym < 256) {
+                out[outPos++] = (char)sym;
+                continue;
+            }
+            if (sym == 256) {
+                inBlock = false;
+                return true;
+            }
+            sym -= 257;
+            if (sym >= 29) return false;
+            size_t length = LENGTH_BASE[sym] + bits(LENGTH_EXTRA[sym]);
+            int d = decode(distances);
+            if (d < 0 || d >= 30) return false;
+            size_t distance = DIST_BASE[d] + bits(DIST_EXTRA[d]);
+            if (distance > outPos) return false;
+
+            char* dst = out.data() + outPos;
+            const char* src = dst - distance;
+            if (distance >= length) {
+                memcpy(dst, src, length);
+            } else {
+                for (size_t i = 0; i < length; i++) dst[i] = src[i];   // overlapping run
+            }
+            outPos += length;
+        }
+        return true;
+    }
+
+public:
+    Inflater(FILE* f, uint64_t compressedSize) : file(f), inputLeft(compressedSize), out(WINDOW + CHUNK + MAX_MATCH) {}
+
+    // Next piece of output; false at the end of the stream or on an error
+    bool next(const char*& data, size_t& n) {
+        if (finished) return false;
+        if (outPos > WINDOW) {
+            memmove(out.data(), out.data() + outPos - WINDOW, WINDOW);
+            outPos = WINDOW;
+        }
+        size_t start = outPos;
+        while (outPos - start < CHUNK && !finished) {
+            if (!inBlock) {
+                if (lastBlock) {
+                    finished = true;
+                    break;
+                }
+                if (!startBlock()) fail("bad block header");
+                continue;
+            }
+            if (!inflateBlock(start + CHUNK)) fail("corrupt data");
+        }
+        if (!failure.empty()) return false;
+        data = out.data() + start;
+        n = outPos - start;
+        return n > 0;
+    }
+
+    const string& error() const { return failure; }
+};
+
+// Reads entries out of a ZIP archive (stored or deflated, no ZIP64)
+class ZipReader {
+public:
+    struct Entry {
+        string name;
+        uint16_t method;
+        uint16_t flags;
+        uint32_t crc;
+        uint64_t compressedSize;
+        uint64_t size;
+        uint64_t localOffset;
+    };
+
+private:
+    FILE* file = nullptr;
+    vector<Entry> entries;
+
+    static uint16_t le16(const unsigned char* p) { return (uint16_t)(p[0] | p[1] << 8); }
+    static uint32_t le32(const unsigned char* p) { return (uint32_t)le16(p) | (uint32_t)le16(p + 2) << 16; }
+
+public:
+    ZipReader() {}
+    ZipReader(const ZipReader&) = delete;
+    ZipReader& operator=(const ZipReader&) = delete;
+    ~ZipReader() {
+        if (file) fclose(file);
+    }
+
+    bool open(const string& path, string& error) {
+        file = fopen(path.c_str(), "rb");
+        if (!file) { error = "missing"; return false; }
+
+        // The end-of-central-directory record sits in the last 64 KiB + 22 bytes
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        long tailSize = min<long>(size, 65535 + 22);
+        vector<unsigned char> tail(tailSize);
+        fseek(file, size - tailSize, SEEK_SET);
+        if (tailSize < 22 || fread(tail.data(), 1, tailSize, file) != (size_t)tailSize) {
+            error = "not a zip file";
+            return false;
+        }
+        long eocd = -1;
+        for (long i = tailSize - 22; i >= 0; i--) {
+            if (le32(&tail[i]) == 0x06054b50) { eocd = i; break; }
+        }
+        if (eocd < 0) { error = "not a zip file"; return false; }
+        uint16_t count = le16(&tail[eocd + 10]);
+        uint32_t dirSize = le32(&tail[eocd + 12]);
+        uint32_t dirOffset = le32(&tail[eocd + 16]);
+        if (count == 0xFFFF || dirOffset == 0xFFFFFFFFu) { error = "ZIP64 archives are not supported"; return false; }
+
+        vector<unsigned char> dir(dirSize);
+        fseek(file, (long)dirOffset, SEEK_SET);
+        if (fread(dir.data(), 1, dirSize, file) != dirSize) { error = "truncated central directory"; return false; }
+        size_t pos = 0;
+        for (uint16_t i = 0; i < count; i++) {
+            if (pos + 46 > dir.size() || le32(&dir[pos]) != 0x02014b50) { error = "corrupt central directory"; return false; }
+            Entry e;
+            e.flags = le16(&dir[pos + 8]);
+            e.method = le16(&dir[pos + 10]);
+            e.crc = le32(&dir[pos + 16]);
+            e.compressedSize = le32(&dir[pos + 20]);
+            e.size = le32(&dir[pos + 24]);
+            uint16_t nameLength = le16(&dir[pos + 28]);
+            uint16_t extraLength = le16(&dir[pos + 30]);
+            uint16_t commentLength = le16(&dir[pos + 32]);
+            e.localOffset = le32(&dir[pos + 42]);
+            if (pos + 46 + nameLength > dir.size()) { error = "corrupt central directory"; return false; }
+            e.name.assign((const char*)&dir[pos + 46], nameLength);
+            entries.push_back(std::move(e));
+            pos += 46 + nameLength + extraLength + commentLength;
+        }
+        return true;
+    }
+
+    const Entry* find(const string& name) const {
+        for (const auto& e : entries) {
+            if (e.name == name) return &e;
+        }
+        return nullptr;
+    }
+
+    // Streams an entry's uncompressed bytes to fn(data, n) and checks its CRC
+    template <typename Fn>
+    bool read(const Entry& e, Fn fn, string& error) {
+        if (e.flags & 1) { error = e.name + " is encrypted"; return false; }
+        if (e.method != 0 && e.method != 8) { error = e.name + " uses an unsupported compression method"; return false; }
+        unsigned char local[30];
+        fseek(file, (long)e.localOffset, SEEK_SET);
+        if (fread(local, 1, 30, file) != 30 || le32(local) != 0x04034b50) { error = "corrupt local header"; return false; }
+        fseek(file, (long)(e.localOffset + 30 + le16(local + 26) + le16(local + 28)), SEEK_SET);
+
+        uint32_t crc = 0;
+        uint64_t produced = 0;
+        if (e.method == 0) {
+            char buffer[65536];
+            uint64_t left = e.size;
+            while (left > 0) {
+                size_t n = fread(buffer, 1, (size_t)min<uint64_t>(sizeof(buffer), left), file);
+                if (n == 0) { error = "truncated entry"; return false; }
+                crc = crc32(buffer, n, crc);
+                produced += n;
+                left -= n;
+                fn(buffer, n);
+            }
+        } else {
+            Inflater inflater(file, e.compressedSize);
+            const char* data;
+            size_t n;
+            while (inflater.next(data, n)) {
+                crc = crc32(data, n, crc);
+                produced += n;
+                fn(data, n);
+            }
+            if (!inflater.error().empty()) { error = e.name + ": " + inflater.error(); return false; }
+        }
+        if (produced != e.size || crc != e.crc) { error = e.name + ": checksum mismatch"; return false; }
+        return true;
+    }
+};
+
+// Incremental SAX-style scanner for the XML in workbook parts: elements,
+// attributes, text (entities decoded) and CDATA; comments, processing
+// instructions and doctypes are skipped. Input may arrive in any pieces.
+// Element names are reported without their namespace prefix.
+class XmlScanner {
+public:
+    struct Handler {
+        virtual void startElement(string_view name, string_view attributes) = 0;
+        virtual void endElement(string_view name) = 0;
+        virtual void text(string_view chars) = 0;
+        virtual ~Handler() {}
+    };
+
+private:
+    Handler& handler;
+    string buffer;
+    string decoded;
+
+    static string_view localName(string_view name) {
+        size_t colon = name.find(':');
+        return colon == string_view::npos ? name : name.substr(colon + 1);
+    }
+
+    // Position of the '>' closing the tag that starts at `from`, skipping quoted values
+    size_t tagEnd(size_t from) const {
+        const char* data = buffer.data();
+        for (size_t i = from; i < buffer.size(); i++) {
+            char c = data[i];
+            if (c == '>') return i;
+            if (c == '"' || c == '\'') {
+                const char* close = (const char*)memchr(data + i + 1, c, buffer.size() - i - 1);
+                if (!close) return string::npos;
+                i = close - data;
+            }
+        }
+        return string::npos;
+    }
+
+    void emitText(string_view raw) {
+        if (raw.find('&') == string_view::npos) {
+            handler.text(raw);
+            return;
+        }
+        decodeEntities(raw, decoded);
+        handler.text(decoded);
+    }
+
+    void scan(bool final) {
+        const char* data = buffer.data();
+        size_t size = buffer.size();
+        string_view view(data, size);
+        size_t pos = 0;
+        while (pos < size) {
+            if (data[pos] != '<') {
+                const char* lt = (const char*)memchr(data + pos, '<', size - pos);
+                if (!lt && !final) break;
+                size_t end = lt ? lt - data : size;
+                emitText(view.substr(pos, end - pos));
+                pos = end;
+                continue;
+            }
+            // Wait for enough bytes to tell a comment or CDATA from a tag
+            if (!final && size - pos < 9) break;
+
+            size_t end;
+            char kind = pos + 1 < size ? data[pos + 1] : 0;
+            if (kind == '!' && view.substr(pos, 4) == "<!--") {
+                end = view.find("-->", pos + 4);
+                if (end == string::npos) break;
+                pos = end + 3;
+            } else if (kind == '!' && view.substr(pos, 9) == "<![CDATA[") {
+                end = view.find("]]>", pos + 9);
+                if (end == string::npos) break;
+                handler.text(view.substr(pos + 9, end - pos - 9));
+                pos = end + 3;
+            } else if (kind == '?') {
+                end = view.find("?>", pos + 2);
+                if (end == string::npos) break;
+                pos = end + 2;
+            } else if (kind == '!') {
+                end = view.find('>', pos + 2);
+                if (end == string::npos) break;
+                pos = end + 1;
+            } else {
+                end = tagEnd(pos + 1);
+                if (end == string::npos) break;
+                string_view tag = view.substr(pos + 1, end - pos - 1);
+                pos = end + 1;
+                if (kind == '/') {
+                    handler.endElement(localName(trimView(tag.substr(1))));
+                    continue;
+                }
+                bool selfClosing = !tag.empty() && tag.back() == '/';
+                if (selfClosing) tag.remove_suffix(1);
+                size_t split = 0;
+                while (split < tag.size() && !isspace((unsigned char)tag[split])) split++;
+                string_view name = localName(tag.substr(0, split));
+                handler.startElement(name, tag.substr(split));
+                if (selfClosing) handler.endElement(name);
+            }
+        }
+        buffer.erase(0, pos);
+    }
+
+public:
+    explicit XmlScanner(Handler& h) : handler(h) {}
+
+    void feed(const char* data, size_t n) {
+        buffer.append(data, n);
+        scan(false);
+    }
+
+    void finish() { scan(true); }
+
+    static void decodeEntities(string_view raw, string& out) {
+        out.clear();
+        for (size_t i = 0; i < raw.size(); i++) {
+            size_t semi;
+            if (raw[i] != '&' || (semi = raw.find(';', i)) == string_view::npos) {
+                out += raw[i];
+                continue;
+            }
+            string_view entity = raw.substr(i + 1, semi - i - 1);
+            uint32_t cp = 0;
+            if (entity == "amp") cp = '&';
+            else if (entity == "lt") cp = '<';
+            else if (entity == "gt") cp = '>';
+            else if (entity == "quot") cp = '"';
+            else if (entity == "apos") cp = '\'';
+            else if (entity.size() > 1 && entity[0] == '#') {
+                bool hex = entity[1] == 'x' || entity[1] == 'X';
+                string digits(entity.substr(hex ? 2 : 1));
+                cp = (uint32_t)strtoul(digits.c_str(), nullptr, hex ? 16 : 10);
+            }
+            if (cp == 0) {
+                out += raw[i];
+                continue;
+            }
+            // UTF-8
+            if (cp < 0x80) out += (char)cp;
+            else if (cp < 0x800) { out += (char)(0xC0 | cp >> 6); out += (char)(0x80 | (cp & 0x3F)); }
+            else if (cp < 0x10000) {
+                out += (char)(0xE0 | cp >> 12); out += (char)(0x80 | ((cp >> 6) & 0x3F)); out += (char)(0x80 | (cp & 0x3F));
+            } else {
+                out += (char)(0xF0 | cp >> 18); out += (char)(0x80 | ((cp >> 12) & 0x3F));
+                out += (char)(0x80 | ((cp >> 6) & 0x3F)); out += (char)(0x80 | (cp & 0x3F));
+            }
+            i = semi;
+        }
+    }
+
+    // Raw (undecoded) value of attribute `name`, matched with its prefix
+    static bool attribute(string_view attributes, string_view name, string_view& value) {
+        size_t pos = 0;
+        while (true) {
+            size_t eq = attributes.find('=', pos);
+            if (eq == string_view::npos) return false;
+            size_t open = eq + 1;
+            while (open < attributes.size() && attributes[open] != '"' && attributes[open] != '\'') open++;
+            if (open == attributes.size()) return false;
+            size_t close = attributes.find(attributes[open], open + 1);
+            if (close == string_view::npos) return false;
+            if (trimView(attributes.substr(pos, eq - pos)) == name) {
+                value = attributes.substr(open + 1, close - open - 1);
+                return true;
+            }
+            pos = close + 1;
+        }
+    }
+
+    static int intAttribute(string_view attributes, string_view name, int fallback) {
+        string_view raw;
+        int v;
+        if (!attribute(attributes, name, raw) || from_chars(raw.data(), raw.data() + raw.size(), v).ec != errc()) return fallback;
+        return v;
+    }
+};
+
+// Columns A..C of one sheet row: PRN, name, percentage, as in the CSV
+const int XLSX_COLUMNS = 3;
+
+struct XlsxRow {
+    string cells[XLSX_COLUMNS];      // shared strings resolved, numbers as stored
+    bool percentFormat[XLSX_COLUMNS]; // shown as a percentage, so stored as a fraction
+};
+
+// Streams one part of the workbook through a SAX handler
+bool scanXlsxPart(ZipReader& zip, const string& name, XmlScanner::Handler& handler, string& error) {
+    const ZipReader::Entry* entry = zip.find(name);
+    if (!entry) { error = name + " missing"; return false; }
+    XmlScanner scanner(handler);
+    if (!zip.read(*entry, [&scanner](const char* data, size_t n) { scanner.feed(data, n); }, error)) return false;
+    scanner.finish();
+    return true;
+}
+
+// "worksheets/sheet1.xml" relative to xl/, or an absolute "/xl/..." target
+string xlsxPartPath(string_view target) {
+    if (!target.empty() && target[0] == '/') return string(target.substr(1));
+    return "xl/" + string(target);
+}
+
+// Workbook: the relationship id of the first sheet
+struct WorkbookHandler : XmlScanner::Handler {
+    string firstSheet;
+    void startElement(string_view name, string_view attributes) override {
+        string_view id;
+        if (name == "sheet" && firstSheet.empty() && XmlScanner::attribute(attributes, "r:id", id)) {
+            firstSheet = string(id);
+        }
+    }
+    void endElement(string_view) override {}
+    void text(string_view) override {}
+};
+
+// Workbook relationships: where the first sheet, shared strings and styles live
+struct RelationshipsHandler : XmlScanner::Handler {
+    string sheetId;
+    string sheet, sharedStrings, styles;
+    void startElement(string_view name, string_view attributes) override {
+        string_view id, type, target;
+        if (name != "Relationship" || !XmlScanner::attribute(attributes, "Id", id) ||
+            !XmlScanner::attribute(attributes, "Type", type) || !XmlScanner::attribute(attributes, "Target", target)) return;
+        string_view kind = type.substr(type.rfind('/') + 1);
+        if (id == sheetId) sheet = xlsxPartPath(target);
+        else if (kind == "sharedStrings") sharedStrings = xlsxPartPath(target);
+        else if (kind == "styles") styles = xlsxPartPath(target);
+    }
+    void endElement(string_view) override {}
+    void text(string_view) override {}
+};
+
+// Styles: which cell formats display numbers as percentages
+struct StylesHandler : XmlScanner::Handler {
+    vector<bool> percentStyle;   // by cell format (xf) index
+    set<int> percentFormats = {9, 10};   // built-in 0% and 0.00%
+    bool inCellFormats = false;
+
+    void startElement(string_view name, string_view attributes) override {
+        string_view code;
+        if (name == "numFmt" && XmlScanner::attribute(attributes, "formatCode", code) && code.find('%') != string_view::npos) {
+            percentFormats.insert(XmlScanner::intAttribute(attributes, "numFmtId", 0));
+        } else if (name == "cellXfs") {
+            inCellFormats = true;
+        } else if (name == "xf" && inCellFormats) {
+            percentStyle.push_back(percentFormats.count(XmlScanner::intAttribute(attributes, "numFmtId", 0)) > 0);
+        }
+    }
+    void endElement(string_view name) override {
+        if (name == "cellXfs") inCellFormats = false;
+    }
+    void text(string_view) override {}
+};
+
+// Shared strings: the text of every <si>, rich-text runs joined, phonetic
+// guides (<rPh>) left out
+struct SharedStringsHandler : XmlScanner::Handler {
+    vector<string> strings;
+    string current;
+    bool inText = false;
+    int phonetic = 0;
+
+    void startElement(string_view name, string_view) override {
+        if (name == "si") current.clear();
+        else if (name == "t") inText = phonetic == 0;
+        else if (name == "rPh") phonetic++;
+    }
+    void endElement(string_view name) override {
+        if (name == "t") inText = false;
+        else if (name == "rPh") phonetic--;
+        else if (name == "si") strings.push_back(current);
+    }
+    void text(string_view chars) override {
+        if (inText) current.append(chars.data(), chars.size());
+    }
+};
+
+// Worksheet: one XlsxRow per <row>, handed to the callback as soon as the
+// row closes
+template <typename Fn>
+struct SheetHandler : XmlScanner::Handler {
+    const vector<string>& shared;
+    const vector<bool>& percentStyle;
+    Fn onRow;
+    XlsxRow row;
+    int nextColumn = 0;
+    int column = -1;
+    bool sharedString = false, percent = false, inValue = false, inInline = false;
+    string value;
+
+    SheetHandler(const vector<string>& s, const vector<bool>& p, Fn fn) : shared(s), percentStyle(p), onRow(fn) {}
+
+    // "C12" -> 2
+    static int columnOf(string_view ref) {
+        int col = 0;
+        size_t i = 0;
+        for (; i < ref.size() && isalpha((unsigned char)ref[i]); i++) col = col * 26 + (toupper(ref[i]) - 'A' + 1);
+        return i == 0 ? -1 : col - 1;
+    }
+
+    void startElement(string_view name, string_view attributes) override {
+        if (name == "row") {
+            for (int i = 0; i < XLSX_COLUMNS; i++) {
+                row.cells[i].clear();
+                row.percentFormat[i] = false;
+            }
+            nextColumn = 0;
+        } else if (name == "c") {
+            string_view ref, type;
+            column = XmlScanner::attribute(attributes, "r", ref) ? columnOf(ref) : nextColumn;
+            if (column < 0) column = nextColumn;
+            nextColumn = column + 1;
+            value.clear();
+            if (column >= XLSX_COLUMNS) return;
+            bool typed = XmlScanner::attribute(attributes, "t", type);
+            sharedString = typed && type == "s";
+            size_t s = (size_t)XmlScanner::intAttribute(attributes, "s", 0);
+            percent = (!typed || type == "n") && s < percentStyle.size() && percentStyle[s];
+        } else if (name == "v" || (name == "t" && inInline)) {
+            inValue = true;
+        } else if (name == "is") {
+            inInline = true;
+        }
+    }
+
+    void endElement(string_view name) override {
+        if (name == "v" || name == "t") {
+            inValue = false;
+        } else if (name == "is") {
+            inInline = false;
+        } else if (name == "c") {
+            if (column < 0 || column >= XLSX_COLUMNS) return;
+            if (sharedString) {
+                size_t index = SIZE_MAX;
+                from_chars(value.data(), value.data() + value.size(), index);
+                row.cells[column] = index < shared.size() ? shared[index] : string();
+            } else {
+                row.cells[column] = value;
+            }
+            row.percentFormat[column] = percent;
+        } else if (name == "row") {
+            onRow(static_cast<const XlsxRow&>(row));
+        }
+    }
+
+    void text(string_view chars) override {
+        if (inValue) value.append(chars.data(), chars.size());
+    }
+};
+
+// Calls onRow(const XlsxRow&) for every row of the workbook's first sheet
+template <typename Fn>
+bool readXlsxRows(const string& path, Fn onRow, string& error) {
+    ZipReader zip;
+    if (!zip.open(path, error)) return false;
+
+    WorkbookHandler workbook;
+    RelationshipsHandler rels;
+    string ignored;
+    if (scanXlsxPart(zip, "xl/workbook.xml", workbook, ignored)) {
+        rels.sheetId = workbook.firstSheet;
+        scanXlsxPart(zip, "xl/_rels/workbook.xml.rels", rels, ignored);
+    }
+    if (rels.sheet.empty()) rels.sheet = "xl/worksheets/sheet1.xml";
+    if (rels.sharedStrings.empty()) rels.sharedStrings = "xl/sharedStrings.xml";
+    if (rels.styles.empty()) rels.styles = "xl/styles.xml";
+
+    // Both are optional: a sheet of numbers and inline strings needs neither
+    StylesHandler styles;
+    SharedStringsHandler strings;
+    if (zip.find(rels.styles) && !scanXlsxPart(zip, rels.styles, styles, error)) return false;
+    if (zip.find(rels.sharedStrings) && !scanXlsxPart(zip, rels.sharedStrings, strings, error)) return false;
+
+    SheetHandler<Fn> sheet(strings.strings, styles.percentStyle, onRow);
+    return scanXlsxPart(zip, rels.sheet, sheet, error);
+}
+
+// ==================== COMPACT STORAGE ====================
+// A full Student costs a vtable pointer, two std::strings, a vector of
+// Courses (two more strings each) and a map node keyed by yet another
+// string. Compact mode (--compact) keeps each student as one packed byte
+// string instead: PRN inline in the map key, marks in one byte when the
+// course is out of at most 255, and course code/name/max marks stored once
+// per shard in a dictionary. Cards are unpacked into a Student on every
+// read, trading CPU for several times less memory on very large cohorts.
+
+// What a heap block of n bytes really costs (glibc malloc chunk rounding)
+size_t allocationBytes(size_t n) {
+    if (n == 0) return 0;
+    return max<size_t>(32, (n + sizeof(size_t) + 15) & ~size_t(15));
+}
+
+// Zero for strings short enough to live inside the object (SSO)
+size_t stringHeapBytes(const string& s) {
+    const char* p = s.data();
+    const char* self = reinterpret_cast<const char*>(&s);
+    if (p >= self && p < self + sizeof(string)) return 0;
+    return allocationBytes(s.capacity() + 1);
+}
+
+// A red-black tree node: colour, parent, left, right, then the value
+template <typename Value>
+size_t mapNodeBytes() {
+    return allocationBytes(4 * sizeof(void*) + sizeof(Value));
+}
+
+// Estimated heap bytes per structure, reported by MEMORY
+struct MemoryUsage {
+    size_t index = 0;             // map nodes and PRN keys
+    size_t records = 0;           // the Student / packed card objects
+    size_t strings = 0;           // names and PRNs outside the keys
+    size_t courses = 0;           // course lists and their strings
+    size_t courseDictionary = 0;  // compact mode only
+    size_t rankIndex = 0;
+    size_t changeLog = 0;
+    size_t tombstones = 0;
+    size_t classList = 0;         // the classmate CSV
+    size_t history = 0;           // past versions kept for AS_OF
+    size_t columns = 0;           // SIMULATE's column copy of the marks
+    size_t courseBoards = 0;      // TOP/BOTTOM per-course boards
+    
+    size_t perStudent() const { return index + records + strings + courses + courseDictionary; }
+    size_t total() const {
+        return perStudent() + rankIndex + changeLog + tombstones + classList + history + columns + courseBoards;
+    }
+};
+
+void putVarint(string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out += (char)(v | 0x80);
+        v >>= 7;
+    }
+    out += (char)v;
+}
+
+uint64_t getVarint(const uint8_t*& p) {
+    uint64_t v = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return v;
+    }
+}
+
+// A PRN held inside the key itself when it is at most 15 bytes (every real
+// PRN), on the heap otherwise. 16 bytes against std::string's 32.
+class PrnKey {
+private:
+    static const size_t INLINE_MAX = 15;
+    static const unsigned char ON_HEAP = 0xFF;
+    char bytes[16];   // inline: the characters, then the length in bytes[15]
+    
+    bool onHeap() const { return (unsigned char)bytes[15] == ON_HEAP; }
+    
+    const char* heapData() const {
+        const char* p;
+        memcpy(&p, bytes, sizeof(p));
+        return p;
+    }
+    
+    uint32_t heapLength() const {
+        uint32_t n;
+        memcpy(&n, bytes + sizeof(char*), sizeof(n));
+        return n;
+    }
+    
+    void assign(string_view s) {
+        memset(bytes, 0, sizeof(bytes));
+        if (s.size() <= INLINE_MAX) {
+            if (!s.empty()) memcpy(bytes, s.data(), s.size());   // an empty view may have a null data()
+            bytes[15] = (char)s.size();
+            return;
+        }
+        char* p = new char[s.size()];
+        memcpy(p, s.data(), s.size());
+        uint32_t n = (uint32_t)s.size();
+        memcpy(bytes, &p, sizeof(p));
+        memcpy(bytes + sizeof(char*), &n, sizeof(n));
+        bytes[15] = (char)ON_HEAP;
+    }
+    
+    void release() {
+        if (onHeap()) delete[] heapData();
+    }
+    
+public:
+    explicit PrnKey(string_view s) { assign(s); }
+    PrnKey(const PrnKey& other) { assign(other.view()); }
+    PrnKey(PrnKey&& other) noexcept {
+        memcpy(bytes, other.bytes, sizeof(bytes));
+        other.assign(string_view());
+    }
+    PrnKey& operator=(const PrnKey& other) {
+        if (this != &other) {
+            release();
+            assign(other.view());
+        }
+        return *this;
+    }
+    ~PrnKey() { release(); }
+    
+    string_view view() const {
+        return onHeap() ? string_view(heapData(), heapLength()) : string_view(bytes, (unsigned char)bytes[15]);
+    }
+    
+    size_t heapBytes() const { return onHeap() ? allocationBytes(heapLength()) : 0; }
+};
+
+// Lets the compact map be searched with a plain string
+struct PrnLess {
+    typedef void is_transparent;
+    bool operator()(const PrnKey& a, const PrnKey& b) const { return a.view() < b.view(); }
+    bool operator()(const PrnKey& a, string_view b) const { return a.view() < b; }
+    bool operator()(string_view a, const PrnKey& b) const { return a < b.view(); }
+};
+
+// One student in compact mode. bytes holds, as varints unless noted: the
+// PRN as entered (length 0 when it equals the key), the name, the course
+// count, then per course its dictionary id and marks (one raw byte for
+// narrow dictionary entries, zigzag varint for wide ones).
+struct PackedStudent {
+    unique_ptr<uint8_t[]> bytes;
+    uint64_t seq = 0;
+    float percentage = 0;
+    unsigned version = 0;
+};
+
+// Percentage, version and feed position of a stored card, readable without
+// unpacking it
+struct CardInfo {
+    float percentage = 0;
+    unsigned version = 0;
+    uint64_t seq = 0;
+};
+
+// The students of one shard, in PRN order, held either as full Student
+// objects or packed (compact mode). Callers hold the shard lock.
+class StudentTable {
+private:
+    struct CourseEntry {
+        string code;
+        string name;
+        int maxMarks;
+        bool wide;   // marks need more than one byte
+    };
+    
+    bool compact;
+    map<string, Student> full;
+    map<PrnKey, PackedStudent, PrnLess> packed;
+    vector<CourseEntry> dictionary;
+    unordered_map<string, uint32_t> dictionaryIds;   // code \0 name \0 maxMarks \0 width -> id
+    
+    static bool needsWide(const Course& c) {
+        return c.getMaxMarks() > 255 || c.getMarks() < 0 || c.getMarks() > 255;
+    }
+    
+    uint32_t intern(const Course& c, bool wide) {
+        string key = c.getCode() + '\0' + c.getName() + '\0' + to_string(c.getMaxMarks()) + '\0' + (wide ? 'w' : 'n');
+        auto it = dictionaryIds.find(key);
+        if (it != dictionaryIds.end()) return it->second;
+        uint32_t id = (uint32_t)dictionary.size();
+        dictionary.push_back({c.getCode(), c.getName(), c.getMaxMarks(), wide});
+        dictionaryIds.emplace(std::move(key), id);
+        return id;
+    }
+    
+    PackedStudent pack(string_view key, const Student& s) {
+        string out;
+        const string& id = s.getID();
+        putVarint(out, id == key ? 0 : id.size());
+        if (id != key) out += id;
+        putVarint(out, s.getName().size());
+        out += s.getName();
+        putVarint(out, s.getCourses().size());
+        for (const auto& c : s.getCourses()) {
+            bool wide = needsWide(c);
+            putVarint(out, intern(c, wide));
+            if (wide) {
+                int64_t m = c.getMarks();
+                putVarint(out, ((uint64_t)m << 1) ^ (uint64_t)(m >> 63));
+            } else {
+                out += (char)c.getMarks();
+            }
+        }
+        
+        PackedStudent p;
+        p.bytes.reset(new uint8_t[out.size()]);
+        memcpy(p.bytes.get(), out.data(), out.size());
+        p.seq = s.getSeq();
+        p.percentage = s.getPercentage();
+        p.version = s.getVersion();
+        return p;
+    }
+    
+    Student unpack(string_view key, const PackedStudent& p) const {
+        const uint8_t* in = p.bytes.get();
+        size_t idLength = getVarint(in);
+        string id = idLength ? string((const char*)in, idLength) : string(key);
+        in += idLength;
+        size_t nameLength = getVarint(in);
+        Student s(string((const char*)in, nameLength), id);
+        in += nameLength;
+        
+        uint64_t count = getVarint(in);
+        for (uint64_t i = 0; i < count; i++) {
+            const CourseEntry& e = dictionary[getVarint(in)];
+            int marks;
+            if (e.wide) {
+                uint64_t z = getVarint(in);
+                marks = (int)(int64_t)((z >> 1) ^ (~(z & 1) + 1));
+            } else {
+                marks = *in++;
+            }
+            s.addCourse(Course(e.code, e.name, marks, e.maxMarks));
+        }
+        s.setVersion(p.version);
+        s.setSeq(p.seq);
+        return s;
+    }
+    
+    // Splits a packed card's size into its name part and its course part
+    void packedSizes(const PackedStudent& p, size_t& nameBytes, size_t& courseBytes) const {
+        const uint8_t* start = p.bytes.get();
+        const uint8_t* in = start;
+        size_t idLength = getVarint(in);
+        in += idLength;
+        size_t nameLength = getVarint(in);
+        in += nameLength;
+        nameBytes = in - start;
+        
+        uint64_t count = getVarint(in);
+        for (uint64_t i = 0; i < count; i++) {
+            if (dictionary[getVarint(in)].wide) getVarint(in);
+            else in++;
+        }
+        courseBytes = (in - start) - nameBytes;
+    }
+    
+    static CardInfo infoOf(const Student& s) {
+        CardInfo info;
+        info.percentage = s.getPercentage();
+        info.version = s.getVersion();
+        info.seq = s.getSeq();
+        return info;
+    }
+    
+    static CardInfo infoOf(const PackedStudent& p) {
+        CardInfo info;
+        info.percentage = p.percentage;
+        info.version = p.version;
+        info.seq = p.seq;
+        return info;
+    }
+    
+public:
+    explicit StudentTable(bool compactMode = false) : compact(compactMode) {}
+    
+    StudentTable(const StudentTable& other)
+        : compact(other.compact), full(other.full), dictionary(other.dictionary), dictionaryIds(other.dictionaryIds) {
+        for (const auto& pair : other.packed) {
+            size_t nameBytes, courseBytes;
+            other.packedSizes(pair.second, nameBytes, courseBytes);
+            PackedStudent p;
+            p.bytes.reset(new uint8_t[nameBytes + courseBytes]);
+            memcpy(p.bytes.get(), pair.second.bytes.get(), nameBytes + courseBytes);
+            p.seq = pair.second.seq;
+            p.percentage = pair.second.percentage;
+            p.version = pair.second.version;
+            packed.emplace_hint(packed.end(), pair.first, std::move(p));
+        }
+    }
+    
+    bool isCompact() const { return compact; }
+    size_t size() const { return compact ? packed.size() : full.size(); }
+    
+    void clear() {
+        full.clear();
+        packed.clear();
+        dictionary.clear();
+        dictionaryIds.clear();
+    }
+    
+    bool get(const string& key, Student& out) const {
+        if (!compact) {
+            auto it = full.find(key);
+            if (it == full.end()) return false;
+            out = it->second;
+            return true;
+        }
+        auto it = packed.find(string_view(key));
+        if (it == packed.end()) return false;
+        out = unpack(key, it->second);
+        return true;
+    }
+    
+    bool peek(const string& key, CardInfo& info) const {
+        if (!compact) {
+            auto it = full.find(key);
+            if (it == full.end()) return false;
+            info = infoOf(it->second);
+            return true;
+        }
+        auto it = packed.find(string_view(key));
+        if (it == packed.end()) return false;
+        info = infoOf(it->second);
+        return true;
+    }
+    
+    // Stores s under key; returns true (and what it replaced) if key was taken
+    bool put(const string& key, const Student& s, CardInfo& replaced) {
+        if (!compact) {
+            auto it = full.find(key);
+            if (it == full.end()) {
+                full.emplace(key, s);
+                return false;
+            }
+            replaced = infoOf(it->second);
+            it->second = s;
+            return true;
+        }
+        auto it = packed.find(string_view(key));
+        if (it == packed.end()) {
+            packed.emplace(PrnKey(key), pack(key, s));
+            return false;
+        }
+        replaced = infoOf(it->second);
+        it->second = pack(key, s);
+        return true;
+    }
+    
+    bool erase(const string& key, CardInfo& removed) {
+        if (!compact) {
+            auto it = full.find(key);
+            if (it == full.end()) return false;
+            removed = infoOf(it->second);
+            full.erase(it);
+            return true;
+        }
+        auto it = packed.find(string_view(key));
+        if (it == packed.end()) return false;
+        removed = infoOf(it->second);
+        packed.erase(it);
+        return true;
+    }
+    
+    // Applies fn(Student&) to a stored card in place (repacking it in compact mode)
+    template <typename Fn>
+    bool modify(const string& key, Fn fn) {
+        if (!compact) {
+            auto it = full.find(key);
+            if (it == full.end()) return false;
+            fn(it->second);
+            return true;
+        }
+        auto it = packed.find(string_view(key));
+        if (it == packed.end()) return false;
+        Student s = unpack(key, it->second);
+        fn(s);
+        it->second = pack(key, s);
+        return true;
+    }
+    
+    // fn(key, student) for every key in [first, last); empty bounds are open
+    template <typename Fn>
+    void forEachInRange(const string& first, const string& last, Fn fn) const {
+        if (!compact) {
+            auto it = first.empty() ? full.begin() : full.lower_bound(first);
+            auto end = last.empty() ? full.end() : full.lower_bound(last);
+            for (; it != end; ++it) fn(it->first, it->second);
+            return;
+        }
+        auto it = first.empty() ? packed.begin() : packed.lower_bound(string_view(first));
+        auto end = last.empty() ? packed.end() : packed.lower_bound(string_view(last));
+        string key;
+        for (; it != end; ++it) {
+            key.assign(it->first.view());
+            fn(key, unpack(key, it->second));
+        }
+    }
+    
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        forEachInRange(string(), string(), fn);
+    }
+    
+    // fn(key, info) for every student, without unpacking
+    template <typename Fn>
+    void forEachInfo(Fn fn) const {
+        if (!compact) {
+            for (const auto& pair : full) fn(pair.first, infoOf(pair.second));
+            return;
+        }
+        string key;
+        for (const auto& pair : packed) {
+            key.assign(pair.first.view());
+            fn(key, infoOf(pair.second));
+        }
+    }
+    
+    void addMemory(MemoryUsage& usage) const {
+        if (!compact) {
+            for (const auto& pair : full) {
+                const Student& s = pair.second;
+                usage.index += mapNodeBytes<decltype(full)::value_type>() - sizeof(Student) + stringHeapBytes(pair.first);
+                usage.records += sizeof(Student);
+                usage.strings += stringHeapBytes(s.getID()) + stringHeapBytes(s.getName());
+                usage.courses += allocationBytes(s.getCourses().capacity() * sizeof(Course));
+                for (const auto& c : s.getCourses()) {
+                    usage.courses += stringHeapBytes(c.getCode()) + stringHeapBytes(c.getName());
+                }
+            }
+            return;
+        }
+        for (const auto& pair : packed) {
+            size_t nameBytes, courseBytes;
+            packedSizes(pair.second, nameBytes, courseBytes);
+            usage.index += mapNodeBytes<decltype(packed)::value_type>() - sizeof(PackedStudent) + pair.first.heapBytes();
+            usage.records += sizeof(PackedStudent);
+            // The block's rounding is charged to the name part
+            usage.strings += allocationBytes(nameBytes + courseBytes) - courseBytes;
+            usage.courses += courseBytes;
+        }
+        usage.courseDictionary += allocationBytes(dictionary.capacity() * sizeof(CourseEntry));
+        for (const auto& e : dictionary) usage.courseDictionary += stringHeapBytes(e.code) + stringHeapBytes(e.name);
+        usage.courseDictionary += allocationBytes(dictionaryIds.bucket_count() * sizeof(void*));
+        for (const auto& pair : dictionaryIds) {
+            usage.courseDictionary += allocationBytes(sizeof(void*) + sizeof(pair) + sizeof(size_t)) + stringHeapBytes(pair.first);
+        }
+    }
+};
+
+// ==================== VERSION HISTORY ====================
+// reportcards.txt is append-only, so every version a student ever had is on
+// disk. Each shard also keeps them in memory. The live table holds the
+// current version. The chain here holds each superseded one, keyed by the
+// feed position (seq) that committed it, with deletions as empty cards.
+// Only students that changed after they were added have a chain.
+// AS_OF turns a time into a feed position, then binary-searches the chain:
+// O(log versions) per student, no file access.
+
+struct PastVersion {
+    uint64_t seq;   // position that committed this version
+    string card;    // packCard() bytes; empty = the student was deleted
+};
+
+// Version, PRN, name and courses as varints and length-prefixed strings
+// (about 60 bytes for a six-course card)
+string packCard(const Student& s) {
+    string out;
+    auto putText = [&out](const string& v) {
+        putVarint(out, v.size());
+        out += v;
+    };
+    putVarint(out, s.getVersion());
+    putText(s.getID());
+    putText(s.getName());
+    putVarint(out, s.getCourses().size());
+    for (const auto& c : s.getCourses()) {
+        putText(c.getCode());
+        putText(c.getName());
+        putVarint(out, (uint64_t)c.getMarks());
+        putVarint(out, (uint64_t)c.getMaxMarks());
+    }
+    return out;
+}
+
+Student unpackCard(const string& card, uint64_t seq) {
+    const uint8_t* p = (const uint8_t*)card.data();
+    auto getText = [&p]() {
+        size_t n = (size_t)getVarint(p);
+        string v((const char*)p, n);
+        p += n;
+        return v;
+    };
+    unsigned version = (unsigned)getVarint(p);
+    string id = getText();
+    string name = getText();
+    Student s(name, id);
+    size_t courses = (size_t)getVarint(p);
+    for (size_t i = 0; i < courses; i++) {
+        string code = getText();
+        string courseName = getText();
+        int marks = (int)getVarint(p);
+        int maxMarks = (int)getVarint(p);
+        s.addCourse(Course(code, courseName, marks, maxMarks));
+    }
+    s.setVersion(version);
+    s.setSeq(seq);
+    return s;
+}
+
+class VersionHistory {
+private:
+    map<string, vector<PastVersion>, less<>> chains;
+    
+public:
+    // Adds a superseded version. Chains stay sorted by seq; a second version
+    // at the same position (records from before the feed all have seq 0)
+    // replaces the first.
+    void keep(const string& key, uint64_t seq, string card) {
+        auto& chain = chains[key];
+        auto it = upper_bound(chain.begin(), chain.end(), seq,
+                              [](uint64_t s, const PastVersion& v) { return s < v.seq; });
+        if (it != chain.begin() && prev(it)->seq == seq) {
+            prev(it)->card = std::move(card);
+        } else {
+            chain.insert(it, PastVersion{seq, std::move(card)});
+        }
+    }
+    
+    // The version in force at position `bound`: false if there was none or
+    // the student was deleted then
+    bool find(const string& key, uint64_t bound, Student& out) const {
+        auto chain = chains.find(key);
+        if (chain == chains.end()) return false;
+        const auto& versions = chain->second;
+        auto it = upper_bound(versions.begin(), versions.end(), bound,
+                              [](uint64_t b, const PastVersion& v) { return b < v.seq; });
+        if (it == versions.begin() || prev(it)->card.empty()) return false;
+        --it;
+        out = unpackCard(it->card, it->seq);
+        return true;
+    }
+    
+    bool has(const string& key) const { return chains.count(key) > 0; }
+    
+    // Drops the versions superseded at or before position `cutoff`: no read
+    // at cutoff or later can reach them. headSeq(key, seq) gives the position
+    // of the student's current card or delete, false if there is neither.
+    template <typename Fn>
+    void prune(uint64_t cutoff, Fn headSeq) {
+        for (auto it = chains.begin(); it != chains.end();) {
+            auto& chain = it->second;
+            uint64_t head = 0;
+            bool hasHead = headSeq(it->first, head);
+            size_t dropped = 0;
+            while (dropped < chain.size()) {
+                bool last = dropped + 1 == chain.size();
+                if (last && !hasHead) break;
+                if ((last ? head : chain[dropped + 1].seq) > cutoff) break;
+                dropped++;
+            }
+            chain.erase(chain.begin(), chain.begin() + dropped);
+            it = chain.empty() ? chains.erase(it) : next(it);
+        }
+    }
+    
+    // fn(key, chain) in key order
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (const auto& pair : chains) fn(pair.first, pair.second);
+    }
+    
+    size_t size() const { return chains.size(); }
+    
+    size_t memoryBytes() const {
+        size_t total = 0;
+        for (const auto& pair : chains) {
+            total += mapNodeBytes<decltype(chains)::value_type>() + stringHeapBytes(pair.first)
+                   + allocationBytes(pair.second.capacity() * sizeof(PastVersion));
+            for (const auto& v : pair.second) total += stringHeapBytes(v.card);
+        }
+        return total;
+    }
+};
+
+// ==================== SHARDED STORE ====================
+// PRNs carry a structured prefix (B24CE = batch + department). Students are
+// partitioned by a hash of that prefix so every department gets its own
+// map, data file and writer thread, and ADDs to different shards never touch
+// the same lock.
+// Fenwick tree over percentages in hundredths (0.00 .. 100.00), the
+// resolution they are reported at. Counting the students above a score is
+// O(log buckets) and the index never allocates after construction.
+class RankIndex {
+private:
+    static const int BUCKETS = 10001;
+    vector<int> tree;
+    long count;
+    
+    static int bucket(float percentage) {
+        long b = lround(percentage * 100);
+        return (int)max(0L, min<long>(BUCKETS - 1, b));
+    }
+    
+public:
+    RankIndex() : tree(BUCKETS + 1, 0), count(0) {}
+    
+    void add(float percentage, int delta) {
+        for (int i = bucket(percentage) + 1; i <= BUCKETS; i += i & -i) tree[i] += delta;
+        count += delta;
+    }
+    
+    size_t memoryBytes() const { return allocationBytes(tree.capacity() * sizeof(int)); }
+    
+    // Entries strictly above percentage (at the reported resolution)
+    size_t countAbove(float percentage) const {
+        long atOrBelow = 0;
+        for (int i = bucket(percentage) + 1; i > 0; i -= i & -i) atOrBelow += tree[i];
+        return (size_t)(count - atOrBelow);
+    }
+};
+
+// One course's students ordered by marks normalized to the course maximum,
+// for TOP and BOTTOM. Scores are bucketed in hundredths of a percent like
+// RankIndex; each bucket holds its PRNs sorted, so both ends of the board
+// are read in order without touching the other students.
+class CourseBoard {
+private:
+    map<uint16_t, vector<PrnKey>> buckets;
+    size_t count = 0;
+    
+public:
+    static const uint16_t TOP_BUCKET = 10000;
+    
+    static uint16_t bucket(int marks, int maxMarks) {
+        if (maxMarks <= 0) return 0;
+        long b = lround(10000.0 * marks / maxMarks);
+        return (uint16_t)max(0L, min<long>(TOP_BUCKET, b));
+    }
+    
+    // Bulk building: keys must arrive in PRN order
+    void append(uint16_t b, string_view key) {
+        buckets[b].emplace_back(key);
+        count++;
+    }
+    
+    void add(uint16_t b, string_view key) {
+        auto& keys = buckets[b];
+        auto at = lower_bound(keys.begin(), keys.end(), key, PrnLess());
+        keys.insert(at, PrnKey(key));
+        count++;
+    }
+    
+    void remove(uint16_t b, string_view key) {
+        auto it = buckets.find(b);
+        if (it == buckets.end()) return;
+        auto& keys = it->second;
+        auto at = lower_bound(keys.begin(), keys.end(), key, PrnLess());
+        if (at == keys.end() || at->view() != key) return;
+        keys.erase(at);
+        count--;
+        if (keys.empty()) buckets.erase(it);
+    }
+    
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    
+    // fn(key) for the first k students from the top (highest score, then
+    // PRN) or from the bottom (lowest score, then PRN)
+    template <typename Fn>
+    void visit(bool fromTop, size_t k, Fn fn) const {
+        auto take = [&](const vector<PrnKey>& keys) {
+            for (const auto& key : keys) {
+                if (k == 0) return;
+                fn(key.view());
+                k--;
+            }
+        };
+        if (fromTop) {
+            for (auto it = buckets.rbegin(); it != buckets.rend() && k > 0; ++it) take(it->second);
+        } else {
+            for (auto it = buckets.begin(); it != buckets.end() && k > 0; ++it) take(it->second);
+        }
+    }
+    
+    size_t memoryBytes() const {
+        size_t bytes = 0;
+        for (const auto& pair : buckets) {
+            bytes += mapNodeBytes<decltype(buckets)::value_type>()
+                   + allocationBytes(pair.second.capacity() * sizeof(PrnKey));
+            for (const auto& key : pair.second) bytes += key.heapBytes();
+        }
+        return bytes;
+    }
+};
+
+// Every student's marks laid out as flat columns, for SIMULATE. A shard
+// builds them on first use and again only after it has changed, so repeated
+// what-if queries never unpack a card or walk the map.
+struct CohortColumns {
+    uint64_t generation = 0;       // the shard's generation when built, 0 = never
+    vector<string> keys;           // PRN of each row, in key order
+    vector<float> percentage;      // as stored
+    vector<char> grade;
+    vector<uint32_t> firstCourse;  // row r owns entries firstCourse[r] .. firstCourse[r + 1] - 1
+    vector<uint32_t> course;       // per entry: index into codes
+    vector<int32_t> marks;
+    vector<int32_t> maxMarks;
+    vector<string> codes;          // distinct course codes of the shard
+    
+    size_t rows() const { return keys.size(); }
+    
+    size_t memoryBytes() const {
+        size_t bytes = allocationBytes(keys.capacity() * sizeof(string))
+                     + allocationBytes(percentage.capacity() * sizeof(float))
+                     + allocationBytes(grade.capacity())
+                     + allocationBytes(firstCourse.capacity() * sizeof(uint32_t))
+                     + allocationBytes(course.capacity() * sizeof(uint32_t))
+                     + allocationBytes(marks.capacity() * sizeof(int32_t))
+                     + allocationBytes(maxMarks.capacity() * sizeof(int32_t))
+                     + allocationBytes(codes.capacity() * sizeof(string));
+        for (const auto& k : keys) bytes += stringHeapBytes(k);
+        for (const auto& c : codes) bytes += stringHeapBytes(c);
+        return bytes;
+    }
+};
+
+struct StoreShard {
+    StudentTable students;
+    RankIndex rankIndex;                 // kept in step with students by the mutators below
+    map<uint64_t, string> changeLog;     // feed position of each PRN's latest change -> PRN
+    map<string, uint64_t> tombstones;    // deleted PRN -> feed position of the delete
+    VersionHistory history;              // superseded versions, for AS_OF
+    string dataFile;
+    unique_ptr<PersistenceWriter> writer;
+    mutable shared_mutex lock;
+    unordered_map<string, CourseBoard> courseBoards;  // boardKey(course) -> board, once built
+    bool boardsBuilt = false;            // loading skips the boards, buildBoards() fills them after
+    uint64_t generation = 1;             // bumped by every mutator below
+    mutable mutex columnsLock;
+    mutable CohortColumns columns;       // see cohortColumns()
+    
+    explicit StoreShard(bool compact) : students(compact) {}
+    
+    // Drops every student, before a follower installs a snapshot
+    void clear() {
+        generation++;
+        students.clear();
+        courseBoards.clear();
+        boardsBuilt = false;
+        rankIndex = RankIndex();
+        changeLog.clear();
+        tombstones.clear();
+        history = VersionHistory();
+    }
+    
+    // The mutators below expect the caller to hold the unique lock. Changes
+    // from before the feed existed (seq 0) are not logged.
+    void logChange(uint64_t seq, const string& key) {
+        if (seq > 0) changeLog[seq] = key;
+    }
+    
+    void unlogChange(uint64_t seq) {
+        if (seq > 0) changeLog.erase(seq);
+    }
+    
+    // One board per code and name: class lists reuse codes such as "001"
+    // for different subjects from student to student
+    static string boardKey(const Course& c) {
+        return c.getCode() + '\0' + c.getName();
+    }
+    
+    static string_view boardCode(const string& boardKey) {
+        return string_view(boardKey).substr(0, boardKey.find('\0'));
+    }
+    
+    static string_view boardName(const string& boardKey) {
+        return string_view(boardKey).substr(boardKey.find('\0') + 1);
+    }
+    
+    void boardCourse(const string& key, const Course& c, bool add) {
+        uint16_t b = CourseBoard::bucket(c.getMarks(), c.getMaxMarks());
+        if (add) {
+            courseBoards[boardKey(c)].add(b, key);
+            return;
+        }
+        auto it = courseBoards.find(boardKey(c));
+        if (it == courseBoards.end()) return;
+        it->second.remove(b, key);
+        if (it->second.empty()) courseBoards.erase(it);
+    }
+    
+    void boardStudent(const string& key, const Student& s, bool add) {
+        if (!boardsBuilt) return;
+        for (const auto& c : s.getCourses()) boardCourse(key, c, add);
+    }
+    
+    // Fills the course boards in one pass over the students (in key order,
+    // so every bucket comes out sorted without inserting into the middle)
+    void buildBoards() {
+        courseBoards.clear();
+        students.forEach([this](const string& key, const Student& s) {
+            for (const auto& c : s.getCourses()) {
+                courseBoards[boardKey(c)].append(CourseBoard::bucket(c.getMarks(), c.getMaxMarks()), key);
+            }
+        });
+        boardsBuilt = true;
+    }
+    
+    void put(const string& key, const Student& s) {
+        generation++;
+        CardInfo old;
+        Student previous;
+        if (students.get(key, previous)) {
+            history.keep(key, previous.getSeq(), packCard(previous));
+            boardStudent(key, previous, false);
+        }
+        boardStudent(key, s, true);
+        if (students.put(key, s, old)) {
+            rankIndex.add(old.percentage, -1);
+            unlogChange(old.seq);
+        } else {
+            auto dead = tombstones.find(key);
+            if (dead != tombstones.end()) {
+                history.keep(key, dead->second, "");
+                unlogChange(dead->second);
+                tombstones.erase(dead);
+            }
+        }
+        rankIndex.add(s.getPercentage(), 1);
+        logChange(s.getSeq(), key);
+    }
+    
+    // Records the tombstone even when the student is already gone, as when
+    // replaying a compacted file that kept only the delete
+    void erase(const string& key, uint64_t seq) {
+        generation++;
+        CardInfo old;
+        Student previous;
+        if (students.get(key, previous)) {
+            history.keep(key, previous.getSeq(), packCard(previous));
+            boardStudent(key, previous, false);
+            // Without a tombstone the chain has to remember the delete
+            if (seq == 0) history.keep(key, 0, "");
+        }
+        if (students.erase(key, old)) {
+            rankIndex.add(old.percentage, -1);
+            unlogChange(old.seq);
+        }
+        if (seq > 0) {
+            auto dead = tombstones.find(key);
+            if (dead != tombstones.end()) unlogChange(dead->second);
+            tombstones[key] = seq;
+            logChange(seq, key);
+        }
+    }
+    
+    void updateMarks(const string& key, int courseIndex, int marks, uint64_t seq, unsigned version) {
+        CardInfo old;
+        if (!students.peek(key, old)) return;
+        generation++;
+        float percentage = 0;
+        students.modify(key, [&](Student& s) {
+            history.keep(key, s.getSeq(), packCard(s));
+            if (boardsBuilt) {
+                const Course& c = s.getCourses()[courseIndex];
+                boardCourse(key, c, false);
+                boardCourse(key, Course(c.getCode(), c.getName(), marks, c.getMaxMarks()), true);
+            }
+            s.setCourseMarks(courseIndex, marks);
+            s.setSeq(seq);
+            s.setVersion(version);
+            percentage = s.getPercentage();
+        });
+        rankIndex.add(old.percentage, -1);
+        unlogChange(old.seq);
+        rankIndex.add(percentage, 1);
+        logChange(seq, key);
+    }
+    
+    void addMemory(MemoryUsage& usage) const {
+        students.addMemory(usage);
+        usage.rankIndex += rankIndex.memoryBytes();
+        for (const auto& pair : changeLog) {
+            usage.changeLog += mapNodeBytes<decltype(changeLog)::value_type>() + stringHeapBytes(pair.second);
+        }
+        for (const auto& pair : tombstones) {
+            usage.tombstones += mapNodeBytes<decltype(tombstones)::value_type>() + stringHeapBytes(pair.first);
+        }
+        usage.history += history.memoryBytes();
+        for (const auto& pair : courseBoards) {
+            usage.courseBoards += allocationBytes(sizeof(pair) + sizeof(void*)) + stringHeapBytes(pair.first)
+                                + pair.second.memoryBytes();
+        }
+        usage.courseBoards += allocationBytes(courseBoards.bucket_count() * sizeof(void*));
+        lock_guard<mutex> guard(columnsLock);
+        usage.columns += columns.memoryBytes();
+    }
+    
+    // The marks as columns, rebuilt here if the shard changed since they were
+    // last built. The caller holds the lock (shared is enough: readers that
+    // race to rebuild take turns on columnsLock, and no writer can get in
+    // while the returned reference is in use).
+    const CohortColumns& cohortColumns() const {
+        lock_guard<mutex> guard(columnsLock);
+        if (columns.generation == generation) return columns;
+        
+        CohortColumns built;
+        unordered_map<string, uint32_t> codeIds;
+        built.keys.reserve(students.size());
+        built.percentage.reserve(students.size());
+        built.grade.reserve(students.size());
+        built.firstCourse.reserve(students.size() + 1);
+        students.forEach([&](const string& key, const Student& s) {
+            built.keys.push_back(key);
+            built.percentage.push_back(s.getPercentage());
+            built.grade.push_back(s.getGrade());
+            built.firstCourse.push_back((uint32_t)built.marks.size());
+            for (const auto& c : s.getCourses()) {
+                auto id = codeIds.emplace(c.getCode(), (uint32_t)built.codes.size());
+                if (id.second) built.codes.push_back(c.getCode());
+                built.course.push_back(id.first->second);
+                built.marks.push_back(c.getMarks());
+                built.maxMarks.push_back(c.getMaxMarks());
+            }
+        });
+        built.firstCourse.push_back((uint32_t)built.marks.size());
+        built.generation = generation;
+        columns = std::move(built);
+        return columns;
+    }
+    
+    // Position of the student's current card, or of its delete
+    bool headSeq(const string& key, uint64_t& seq) const {
+        CardInfo current;
+        if (students.peek(key, current)) {
+            seq = current.seq;
+            return true;
+        }
+        auto dead = tombstones.find(key);
+        if (dead == tombstones.end()) return false;
+        seq = dead->second;
+        return true;
+    }
+    
+    // The version in force at feed position `bound` (caller holds the lock)
+    bool versionAsOf(const string& key, uint64_t bound, Student& out) const {
+        CardInfo current;
+        if (students.peek(key, current) && current.seq <= bound) return students.get(key, out);
+        auto dead = tombstones.find(key);
+        if (dead != tombstones.end() && dead->second <= bound) return false;
+        return history.find(key, bound, out);
+    }
+    
+    // fn(key, student) for every student present at `bound`, in key order.
+    // The students deleted since then are the tombstones newer than bound.
+    template <typename Fn>
+    void forEachAsOf(uint64_t bound, Fn fn) const {
+        vector<pair<string, Student>> found;
+        students.forEach([&](const string& key, const Student& s) {
+            Student past;
+            if (s.getSeq() <= bound) found.emplace_back(key, s);
+            else if (history.find(key, bound, past)) found.emplace_back(key, std::move(past));
+        });
+        size_t live = found.size();
+        for (const auto& pair : tombstones) {
+            Student past;
+            if (pair.second > bound && history.find(pair.first, bound, past)) found.emplace_back(pair.first, std::move(past));
+        }
+        inplace_merge(found.begin(), found.begin() + live, found.end(),
+                      [](const pair<string, Student>& a, const pair<string, Student>& b) { return a.first < b.first; });
+        for (const auto& entry : found) fn(entry.first, entry.second);
+    }
+};
+
+// Hands out change-feed positions. A position only becomes visible to
+// readers once every smaller one has been applied, so a subscriber never
+// skips a change that another shard is still in the middle of.
+// It also remembers when each position was handed out, as steps of
+// (first position, time): one entry per distinct millisecond, not per change.
+class ChangeSequencer {
+private:
+    mutable mutex lock;
+    mutable condition_variable advanced;
+    uint64_t last;
+    set<uint64_t> inFlight;
+    vector<pair<uint64_t, int64_t>> times;  // sorted by position and by time
+    
+    uint64_t stableLocked() const {
+        return inFlight.empty() ? last : *inFlight.begin() - 1;
+    }
+    
+public:
+    ChangeSequencer() : last(0) {}
+    
+    uint64_t begin() {
+        lock_guard<mutex> guard(lock);
+        inFlight.insert(++last);
+        // Never step backwards, even if the wall clock does
+        int64_t latest = times.empty() ? 0 : times.back().second;
+        int64_t now = max(nowMillis(), latest);
+        if (now != latest) times.push_back({last, now});
+        return last;
+    }
+    
+    void end(uint64_t seq) {
+        {
+            lock_guard<mutex> guard(lock);
+            inFlight.erase(seq);
+        }
+        advanced.notify_all();
+    }
+    
+    // Highest position with nothing still in flight below it
+    uint64_t stable() const {
+        lock_guard<mutex> guard(lock);
+        return stableLocked();
+    }
+    
+    // stable(), after waiting up to ms for it to pass seq
+    uint64_t waitPast(uint64_t seq, int ms) const {
+        unique_lock<mutex> guard(lock);
+        advanced.wait_for(guard, chrono::milliseconds(ms), [&] { return stableLocked() > seq; });
+        return stableLocked();
+    }
+    
+    // Highest position handed out so far, finished or not
+    uint64_t issued() const {
+        lock_guard<mutex> guard(lock);
+        return last;
+    }
+    
+    // Forget every position and time, before a follower installs a snapshot
+    void reset() {
+        lock_guard<mutex> guard(lock);
+        last = 0;
+        times.clear();
+    }
+    
+    // Continue after the highest position found while loading (or
+    // replicated from the primary)
+    void resume(uint64_t seq) {
+        {
+            lock_guard<mutex> guard(lock);
+            last = max(last, seq);
+        }
+        advanced.notify_all();
+    }
+    
+    // Commit time of a position (0 if it was committed before times were
+    // recorded)
+    int64_t timeOf(uint64_t seq) const {
+        lock_guard<mutex> guard(lock);
+        auto it = upper_bound(times.begin(), times.end(), seq,
+                              [](uint64_t s, const pair<uint64_t, int64_t>& t) { return s < t.first; });
+        return it == times.begin() ? 0 : prev(it)->second;
+    }
+    
+    // Highest position committed at or before ms
+    uint64_t seqAt(int64_t ms) const {
+        lock_guard<mutex> guard(lock);
+        auto it = upper_bound(times.begin(), times.end(), ms,
+                              [](int64_t m, const pair<uint64_t, int64_t>& t) { return m < t.second; });
+        return it == times.end() ? UINT64_MAX : it->first - 1;
+    }
+    
+    // Loading: times arrive per record from every shard file in any order.
+    // finishLoading() sorts them back into steps.
+    void recordTime(uint64_t seq, int64_t ms) {
+        lock_guard<mutex> guard(lock);
+        // In order and within the last step's millisecond (a follower applying
+        // the primary's records): nothing new
+        if (!times.empty() && times.back().first <= seq && times.back().second == ms) return;
+        times.push_back({seq, ms});
+    }
+    
+    void finishLoading() {
+        lock_guard<mutex> guard(lock);
+        sort(times.begin(), times.end());
+        vector<pair<uint64_t, int64_t>> steps;
+        for (auto t : times) {
+            if (!steps.empty()) t.second = max(t.second, steps.back().second);
+            if (steps.empty() || t.second != steps.back().second) steps.push_back(t);
+        }
+        times.swap(steps);
+    }
+    
+    vector<pair<uint64_t, int64_t>> timeSteps() const {
+        lock_guard<mutex> guard(lock);
+        return times;
+    }
+    
+    size_t memoryBytes() const {
+        lock_guard<mutex> guard(lock);
+        return allocationBytes(times.capacity() * sizeof(times[0]));
+    }
+};
+
+
+// A contiguous key range inside one shard, the unit of work for batch jobs
+struct StoreRange {
+    size_t shard = 0;
+    string first;      // inclusive; empty = from the beginning
+    string last;       // exclusive; empty = to the end
+    size_t size = 0;
+};
+
+const size_t JOB_RANGE_SIZE = 2048;
+
+struct ReconcileMismatch {
+    string prn;
+    float computed;   // from the report card in reportcards.txt
+    float published;  // from the classmate CSV
+};
+
+struct ReconcileReport {
+    size_t matched = 0;
+    vector<ReconcileMismatch> mismatches;
+    vector<string> onlyInResults;
+    vector<string> onlyInClassList;
+    vector<pair<string, vector<float>>> duplicates;
+};
+
+struct ShardStats {
+    int count = 0;
+    double totalPercentage = 0;
+    float highest = 0;
+    float lowest = 0;
+    int gradeCounts[6] = {0, 0, 0, 0, 0, 0};  // A..F
+    
+    void add(float perc, char grade) {
+        if (count == 0 || perc > highest) highest = perc;
+        if (count == 0 || perc < lowest) lowest = perc;
+        count++;
+        totalPercentage += perc;
+        int g = grade - 'A';
+        if (g >= 0 && g < 6) gradeCounts[g]++;
+    }
+    
+    void merge(const ShardStats& other) {
+        if (other.count == 0) return;
+        if (count == 0 || other.highest > highest) highest = other.highest;
+        if (count == 0 || other.lowest < lowest) lowest = other.lowest;
+        count += other.count;
+        totalPercentage += other.totalPercentage;
+        for (int i = 0; i < 6; i++) gradeCounts[i] += other.gradeCounts[i];
+    }
+};
+
+string toUpperPRN(string prn) {
+    transform(prn.begin(), prn.end(), prn.begin(), ::toupper);
+    return prn;
+}
+
+// "B24CE1046" -> "B24CE": the PRN without its trailing roll number
+string_view prnPrefix(string_view prn) {
+    size_t end = prn.size();
+    while (end > 0 && isdigit((unsigned char)prn[end - 1])) end--;
+    return prn.substr(0, end);
+}
+
+// "reportcards.txt" + ".shard3" -> "reportcards.shard3.txt"
+string siblingFileName(const string& dataFile, const string& suffix) {
+    size_t dot = dataFile.find_last_of('.');
+    size_t slash = dataFile.find_last_of("/\\");
+    if (dot == string::npos || (slash != string::npos && dot < slash)) return dataFile + suffix;
+    return dataFile.substr(0, dot) + suffix + dataFile.substr(dot);
+}
+
+string shardFileName(const string& dataFile, size_t index) {
+    return siblingFileName(dataFile, ".shard" + to_string(index));
+}
+
+// Shard count the data files were written with, "reportcards.layout.txt"
+string layoutFileName(const string& dataFile) {
+    return siblingFileName(dataFile, ".layout");
+}
+
+// Indexes of every "reportcards.shardK.txt" next to dataFile, whatever
+// shard count wrote them, in increasing order
+vector<size_t> existingShardFiles(const string& dataFile) {
+    string first = shardFileName(dataFile, 0);
+    filesystem::path firstPath(first);
+    string name = firstPath.filename().string();
+    size_t digitsAt = name.rfind(".shard0") + 6;
+    string prefix = name.substr(0, digitsAt), suffix = name.substr(digitsAt + 1);
+    
+    vector<size_t> indexes;
+    error_code ec;
+    filesystem::path dir = firstPath.has_parent_path() ? firstPath.parent_path() : filesystem::path(".");
+    for (filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        string file = it->path().filename().string();
+        if (file.size() <= prefix.size() + suffix.size() || file.compare(0, prefix.size(), prefix) != 0 ||
+            file.compare(file.size() - suffix.size(), suffix.size(), suffix) != 0) continue;
+        string_view digits = string_view(file).substr(prefix.size(), file.size() - prefix.size() - suffix.size());
+        int index = 0;
+        if (digits.find_first_not_of("0123456789") != string_view::npos ||
+            parseInt(digits, index) != ParseError::None) continue;
+        indexes.push_back((size_t)index);
+    }
+    sort(indexes.begin(), indexes.end());
+    return indexes;
+}
+
+// Superseded records removed by compaction, "reportcards.audit.txt"
+string auditFileName(const string& dataFile) {
+    return siblingFileName(dataFile, ".audit");
+}
+
+// Past versions AS_OF needs, rewritten by compaction and replayed before
+// the data file, "reportcards.history.txt"
+string historyFileName(const string& dataFile) {
+    return siblingFileName(dataFile, ".history");
+}
+
+struct CompactionStats {
+    size_t files = 0;
+    size_t liveRecords = 0;
+    size_t archived = 0;
+    uint64_t bytesBefore = 0;
+    uint64_t bytesAfter = 0;
+    uint64_t historyBytes = 0;
+};
+
+bool readFileRange(const string& path, uint64_t from, uint64_t to, string& out) {
+    out.clear();
+    if (to <= from) return true;
+    ifstream fin(path, ios::binary);
+    if (!fin) return false;
+    fin.seekg(from);
+    out.resize(to - from);
+    fin.read(&out[0], out.size());
+    out.resize(fin.gcount());
+    return true;
+}
+
+bool appendDurably(const string& path, const string& data) {
+    if (data.empty()) return true;
+    FILE* f = fopen(path.c_str(), "ab");
+    if (!f) return false;
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size() && PersistenceWriter::syncFile(f);
+    return fclose(f) == 0 && ok;
+}
+
+// Raw blocks from the first `size` bytes of a record file that are no longer
+// the current version of their student: every marks update, blocks that are
+// not the last one for their PRN, last cards that differ from what is live
+// now, and deletes from before the change feed (compaction only keeps
+// tombstones that have a feed position)
+template <typename LiveFn>
+string supersededRecords(const string& path, uint64_t size, LiveFn liveStudent, size_t& count) {
+    string image;
+    if (!readFileRange(path, 0, size, image)) return "";
+    
+    vector<pair<string, string>> blocks;  // PRN, raw text
+    vector<Student> cards;                // parsed card for each Full block
+    vector<pair<RecordKind, uint64_t>> kinds;  // kind and feed position of each block
+    map<string, size_t> lastBlock;
+    istringstream in(image);
+    forEachRecord(in, [&](const FileRecord& rec, const string& raw) {
+        bool isFull = rec.kind == RecordKind::Full;
+        string key = toUpperPRN(isFull ? rec.student.getID() : rec.prn);
+        lastBlock[key] = blocks.size();
+        blocks.emplace_back(key, raw);
+        cards.push_back(isFull ? rec.student : Student());
+        kinds.emplace_back(rec.kind, rec.seq);
+    });
+    
+    string out;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        const string& key = blocks[i].first;
+        bool superseded = kinds[i].first == RecordKind::MarksUpdate || lastBlock[key] != i;
+        if (!superseded && kinds[i].first == RecordKind::Delete) {
+            Student live;
+            superseded = kinds[i].second == 0 || liveStudent(key, live);
+        }
+        else if (!superseded) {
+            Student live;
+            superseded = !liveStudent(key, live);
+            if (!superseded) {
+                // Cards written before versioning carry no Version line
+                if (cards[i].getVersion() == 0) cards[i].setVersion(live.getVersion());
+                superseded = live.toFileRecord() != cards[i].toFileRecord();
+            }
+        }
+        if (superseded) {
+            out += blocks[i].second;
+            count++;
+        }
+    }
+    return out;
+}
+
+// NotDurable: applied in memory, but in Fsync mode the record did not reach the disk
+enum class WriteResult { Ok, NotFound, NoSuchCourse, InvalidMarks, VersionConflict, NotDurable };
+
+struct StoreOptions {
+    DurabilityMode durability = DurabilityMode::Enqueue;
+    size_t shards = 1;
+    string importFile;    // columnar export to start from instead of parsing reportcards.txt
+    string snapshotFile;  // compressed snapshot to start from when it is still fresh
+    bool compact = false; // keep students packed (see COMPACT STORAGE)
+    IoMode io = IoMode::Auto;               // io_uring where the kernel has it (see FILE I/O)
+    string catalogRoot = "datasets";        // DATASET|batch/semester|... reads <root>/batch/semester/
+    size_t datasetBudget = size_t(1) << 30; // bytes of loaded datasets before the coldest are dropped
+    string replicateAddress;                // [host:]port to ship changes to followers on (see REPLICATION)
+    string followAddress;                   // host:port of the primary; makes this store a read-only follower
+    size_t replicationLog = size_t(64) << 20; // bytes of recent records a primary keeps for reconnecting followers
+    string replicationKey;                  // shared secret followers present to the primary
+    bool singleCommand = false;             // --web: the process exits after one reply, before any background job ends
+    int historyDays = 0;                    // how far back AS_OF reaches; compaction drops older versions (0 = no limit)
+};
+
+class ResultManager;
+bool importColumnarFile(ResultManager& manager, const string& path, string& error);
+
+// ==================== REPLICATION STATE ====================
+// Bookkeeping shared by the store and the REPLICATION network threads. A
+// primary keeps the record text of its most recent writes by feed
+// position. A follower that reconnects then resumes from this log instead
+// of taking a new snapshot. A follower is read-only. It tracks what it has
+// applied and how far that is behind the primary.
+enum class ReplicaRole { Standalone, Primary, Follower };
+
+// One connected follower, as its primary sees it
+struct ReplicaPeer {
+    string address;
+    uint64_t acked = 0;        // last position the follower reported applied
+    int64_t lastContact = 0;   // Unix ms
+    unsigned snapshots = 0;
+};
+
+class ReplicationState {
+private:
+    mutable mutex lock;
+    ReplicaRole role = ReplicaRole::Standalone;
+    atomic<bool> shipping{false};   // append() is a no-op unless this is a primary
+    string address;                 // primary: listen address, follower: the primary's
+    uint64_t epoch = 0;             // identifies one run of the primary
+    
+    // Primary
+    map<uint64_t, string> log;      // feed position -> record text
+    size_t logBytes = 0;
+    size_t logCapacity = 0;
+    uint64_t logFloor = 0;          // every position after this one is in the log
+    map<int, ReplicaPeer> peers;
+    int nextPeer = 0;
+    
+    // Follower
+    bool connected = false;
+    uint64_t applied = 0;
+    uint64_t primarySeq = 0;
+    int64_t lagMs = 0;
+    int64_t lastContact = 0;
+    unsigned snapshots = 0;
+    unsigned reconnects = 0;
+    
+public:
+    // issued(): the sequencer's highest position. Writes that began before
+    // shipping was switched on may be missing from the log, so it starts
+    // after the last position handed out by then.
+    template <typename Issued>
+    void startPrimary(const string& listenAddress, size_t capacity, Issued issued) {
+        lock_guard<mutex> guard(lock);
+        role = ReplicaRole::Primary;
+        address = listenAddress;
+        logCapacity = capacity;
+        // A new epoch per run: followers of an earlier run take a snapshot
+        epoch = ((uint64_t)nowMillis() << 20) ^ random_device()();
+        shipping = true;
+        logFloor = issued();
+    }
+    
+    void startFollower(const string& primaryAddress) {
+        lock_guard<mutex> guard(lock);
+        role = ReplicaRole::Follower;
+        address = primaryAddress;
+    }
+    
+    bool isFollower() const {
+        lock_guard<mutex> guard(lock);
+        return role == ReplicaRole::Follower;
+    }
+    
+    uint64_t getEpoch() const {
+        lock_guard<mutex> guard(lock);
+        return epoch;
+    }
+    
+    // ---- primary ----
+    
+    // Called with the record's shard lock held, before the sequencer ends seq
+    void append(uint64_t seq, const string& text) {
+        if (!shipping.load(memory_order_relaxed)) return;
+        lock_guard<mutex> guard(lock);
+        logBytes += text.size();
+        log.emplace(seq, text);
+        while (logBytes > logCapacity && !log.empty()) {
+            logBytes -= log.begin()->second.size();
+            logFloor = log.begin()->first;
+            log.erase(log.begin());
+        }
+    }
+    
+    // Record text for positions in (after, upTo], at most about maxBytes.
+    // False when the log no longer goes back to `after`.
+    bool read(uint64_t after, uint64_t upTo, size_t maxBytes, string& out, uint64_t& last) const {
+        lock_guard<mutex> guard(lock);
+        if (after < logFloor) return false;
+        last = after;
+        for (auto it = log.upper_bound(after); it != log.end() && it->first <= upTo; ++it) {
+            if (!out.empty() && out.size() + it->second.size() > maxBytes) break;
+            out += it->second;
+            last = it->first;
+        }
+        return true;
+    }
+    
+    // Whether a follower at (followerEpoch, position) can continue from the log
+    bool resumable(uint64_t followerEpoch, uint64_t position, uint64_t stable) const {
+        lock_guard<mutex> guard(lock);
+        return followerEpoch == epoch && position >= logFloor && position <= stable;
+    }
+    
+    int addPeer(const string& peerAddress) {
+        lock_guard<mutex> guard(lock);
+        int id = nextPeer++;
+        peers[id].address = peerAddress;
+        peers[id].lastContact = nowMillis();
+        return id;
+    }
+    
+    void peerAcked(int id, uint64_t seq) {
+        lock_guard<mutex> guard(lock);
+        auto it = peers.find(id);
+        if (it == peers.end()) return;
+        it->second.acked = seq;
+        it->second.lastContact = nowMillis();
+    }
+    
+    void peerSnapshot(int id) {
+        lock_guard<mutex> guard(lock);
+        auto it = peers.find(id);
+        if (it != peers.end()) it->second.snapshots++;
+    }
+    
+    void removePeer(int id) {
+        lock_guard<mutex> guard(lock);
+        peers.erase(id);
+    }
+    
+    // ---- follower ----
+    
+    uint64_t appliedSeq() const {
+        lock_guard<mutex> guard(lock);
+        return applied;
+    }
+    
+    void linkUp() {
+        lock_guard<mutex> guard(lock);
+        connected = true;
+        lastContact = nowMillis();
+    }
+    
+    void linkDown() {
+        lock_guard<mutex> guard(lock);
+        if (connected) reconnects++;
+        connected = false;
+    }
+    
+    void installed(uint64_t primaryEpoch, uint64_t seq) {
+        lock_guard<mutex> guard(lock);
+        epoch = primaryEpoch;
+        applied = seq;
+        primarySeq = max(primarySeq, seq);
+        snapshots++;
+        lastContact = nowMillis();
+    }
+    
+    void appliedUpTo(uint64_t seq) {
+        lock_guard<mutex> guard(lock);
+        applied = seq;
+        lastContact = nowMillis();
+    }
+    
+    // stable: the primary's stable position; pendingSince: commit time of the
+    // oldest record not yet shipped to us (0 = none), on the primary's clock
+    void heartbeat(uint64_t stable, int64_t primaryNow, int64_t pendingSince) {
+        lock_guard<mutex> guard(lock);
+        primarySeq = stable;
+        lagMs = pendingSince > 0 ? max<int64_t>(0, primaryNow - pendingSince) : 0;
+        lastContact = nowMillis();
+    }
+    
+    // timeOf(seq): commit time of a position, for each follower's lag
+    template <typename TimeOf>
+    string statusJSON(uint64_t stable, TimeOf timeOf) const {
+        lock_guard<mutex> guard(lock);
+        int64_t now = nowMillis();
+        stringstream ss;
+        if (role == ReplicaRole::Standalone) return "{\"role\":\"standalone\",\"seq\":" + to_string(stable) + "}";
+        if (role == ReplicaRole::Follower) {
+            uint64_t behind = primarySeq > applied ? primarySeq - applied : 0;
+            ss << "{\"role\":\"follower\",\"primary\":\"" << address << "\",\"connected\":"
+               << (connected ? "true" : "false") << ",\"appliedSeq\":" << applied
+               << ",\"primarySeq\":" << primarySeq << ",\"behind\":" << behind
+               << ",\"lagMs\":" << (behind ? lagMs : 0)
+               << ",\"lastContactMs\":" << (lastContact ? now - lastContact : -1)
+               << ",\"snapshots\":" << snapshots << ",\"reconnects\":" << reconnects << "}";
+            return ss.str();
+        }
+        ss << "{\"role\":\"primary\",\"listen\":\"" << address << "\",\"seq\":" << stable
+           << ",\"log\":{\"records\":" << log.size() << ",\"bytes\":" << logBytes
+           << ",\"from\":" << logFloor + 1 << "},\"followers\":[";
+        bool first = true;
+        for (const auto& pair : peers) {
+            const ReplicaPeer& p = pair.second;
+            uint64_t behind = stable > p.acked ? stable - p.acked : 0;
+            int64_t pendingSince = behind ? timeOf(p.acked + 1) : 0;
+            if (!first) ss << ",";
+            first = false;
+            ss << "{\"address\":\"" << p.address << "\",\"ackedSeq\":" << p.acked
+               << ",\"behind\":" << behind
+               << ",\"lagMs\":" << (pendingSince > 0 ? max<int64_t>(0, now - pendingSince) : 0)
+               << ",\"lastContactMs\":" << now - p.lastContact
+               << ",\"snapshots\":" << p.snapshots << "}";
+        }
+        ss << "]}";
+        return ss.str();
+    }
+};
+
+// ==================== CLASS: ResultManager ====================
+class ResultManager {
+private:
+    vector<unique_ptr<StoreShard>> shards;
+    map<string, float> classPercentageMap;
+    map<string, vector<float>> classDuplicates;  // PRNs listed more than once in the CSV
+    ChangeSequencer sequencer;
+    ReplicationState replication;
+    string dataFile;
+    string csvFile;
+    IoMode ioMode;
+    bool singleCommand;
+    int64_t historyRetentionMs;
+    JobManager jobs;  // declared last so running jobs stop before the shards go away
+    
+    size_t shardIndex(const string& prnUpper) const {
+        if (shards.size() == 1) return 0;
+        // FNV-1a over the prefix keeps a whole department on one shard
+        uint32_t hash = 2166136261u;
+        for (char c : prnPrefix(prnUpper)) {
+            hash ^= (unsigned char)c;
+            hash *= 16777619u;
+        }
+        return hash % shards.size();
+    }
+    
+    StoreShard& shardFor(const string& prnUpper) const {
+        return *shards[shardIndex(prnUpper)];
+    }
+    
+    void storeClassmate(const string& prnUpper, float perc) {
+        auto it = classPercentageMap.find(prnUpper);
+        if (it != classPercentageMap.end()) {
+            auto& seen = classDuplicates[prnUpper];
+            if (seen.empty()) seen.push_back(it->second);
+            seen.push_back(perc);
+            it->second = perc;
+            return;
+        }
+        classPercentageMap.emplace(prnUpper, perc);
+    }
+    
+    typedef vector<pair<const string*, float>> ClassList;
+    
+    // Sort-merge one store range against the CSV rows that fall inside it
+    void reconcileRange(const StoreRange& range, const ClassList& csv, float tolerance,
+                        ReconcileReport& out) const {
+        auto keyLess = [](const pair<const string*, float>& e, const string& k) { return *e.first < k; };
+        auto csvIt = range.first.empty() ? csv.begin() : lower_bound(csv.begin(), csv.end(), range.first, keyLess);
+        auto csvEnd = range.last.empty() ? csv.end() : lower_bound(csv.begin(), csv.end(), range.last, keyLess);
+        
+        forEachInRange(range, [&](const string& prn, const Student& s) {
+            while (csvIt != csvEnd && *csvIt->first < prn) {
+                out.onlyInClassList.push_back(*csvIt->first);
+                ++csvIt;
+            }
+            if (csvIt != csvEnd && *csvIt->first == prn) {
+                float diff = s.getPercentage() - csvIt->second;
+                if (fabs(diff) > tolerance) {
+                    out.mismatches.push_back({prn, s.getPercentage(), csvIt->second});
+                } else {
+                    out.matched++;
+                }
+                ++csvIt;
+            } else {
+                out.onlyInResults.push_back(prn);
+            }
+        });
+        for (; csvIt != csvEnd; ++csvIt) out.onlyInClassList.push_back(*csvIt->first);
+    }
+    
+    void storeLoaded(const string& prnUpper, const Student& s) {
+        StoreShard& shard = shardFor(prnUpper);
+        unique_lock<shared_mutex> guard(shard.lock);
+        shard.put(prnUpper, s);
+    }
+    
+    // Replay one block of a record file. Blocks without a version (written
+    // before versioning) count as one change on top of what is loaded.
+    void applyRecord(const FileRecord& rec) {
+        string prnUpper = toUpperPRN(rec.kind == RecordKind::Full ? rec.student.getID() : rec.prn);
+        StoreShard& shard = shardFor(prnUpper);
+        unique_lock<shared_mutex> guard(shard.lock);
+        CardInfo current;
+        bool exists = shard.students.peek(prnUpper, current);
+        unsigned version = rec.version ? rec.version : (exists ? current.version + 1 : 1);
+        if (rec.seq > 0 && rec.time > 0) sequencer.recordTime(rec.seq, rec.time);
+        
+        switch (rec.kind) {
+            case RecordKind::Full: {
+                Student s = rec.student;
+                s.setVersion(version);
+                shard.put(prnUpper, s);
+                break;
+            }
+            case RecordKind::MarksUpdate: {
+                Student s;
+                if (!shard.students.get(prnUpper, s)) break;
+                int index = s.findCourse(rec.courseCode);
+                if (index < 0) break;
+                shard.updateMarks(prnUpper, index, rec.marks, rec.seq, version);
+                break;
+            }
+            case RecordKind::Delete:
+                shard.erase(prnUpper, rec.seq);
+                break;
+        }
+    }
+    
+    // New changes continue after the highest feed position that was loaded
+    void resumeFeed() {
+        for (const auto& shard : shards) {
+            shared_lock<shared_mutex> guard(shard->lock);
+            if (!shard->changeLog.empty()) sequencer.resume(shard->changeLog.rbegin()->first);
+        }
+        sequencer.finishLoading();
+    }
+    
+    // The course boards are skipped while loading and built here in one pass
+    // per shard, the shards in parallel
+    void buildCourseBoards() {
+        scatter([](size_t, StoreShard& shard) {
+            unique_lock<shared_mutex> guard(shard.lock);
+            shard.buildBoards();
+        });
+    }
+    
+    // Run fn(index, shard) on every shard, one thread per shard when there are several
+    template <typename Fn>
+    void scatter(Fn fn) const {
+        if (shards.size() == 1) {
+            fn(0, *shards[0]);
+            return;
+        }
+        vector<thread> workers;
+        for (size_t i = 0; i < shards.size(); i++) {
+            workers.emplace_back([&fn, this, i] { fn(i, *shards[i]); });
+        }
+        for (auto& t : workers) t.join();
+    }
+    
+public:
+    ResultManager(string df, string cf, const StoreOptions& options = StoreOptions())
+        : dataFile(df), csvFile(cf), ioMode(options.io), singleCommand(options.singleCommand),
+          historyRetentionMs((int64_t)max(0, options.historyDays) * 86400000), jobs(sharedPool()) {
+        size_t shardCount = max<size_t>(1, options.shards);
+        for (size_t i = 0; i < shardCount; i++) {
+            auto shard = make_unique<StoreShard>(options.compact);
+            shard->dataFile = (shardCount == 1) ? dataFile : shardFileName(dataFile, i);
+            shard->writer = make_unique<PersistenceWriter>(shard->dataFile, options.durability, options.io);
+            shards.push_back(std::move(shard));
+        }
+        
+        // A follower starts empty and is filled from the primary's snapshot
+        if (!options.followAddress.empty()) {
+            replication.startFollower(options.followAddress);
+            return;
+        }
+        
+        // Files written with another --shards value hold students this layout
+        // routes elsewhere: replay all of them, then rewrite them (below)
+        size_t writtenWith = recordedShardCount();
+        vector<size_t> present = existingShardFiles(dataFile);
+        bool stray = !present.empty() && (shards.size() == 1 || present.back() >= shards.size());
+        // (Turning sharding on keeps working as before: the pre-sharding file
+        // is replayed first and COMPACT retires it)
+        bool reshard = (writtenWith != shards.size() && !present.empty()) || stray;
+        
+        string error;
+        if (!options.snapshotFile.empty() && !reshard) {
+            if (loadSnapshot(options.snapshotFile, error)) return;
+            if (error != "missing" && error != "stale") {
+                cerr << "Snapshot " << options.snapshotFile << " rejected (" << error << "), reading text files" << endl;
+            }
+        }
+        
+        loadClassmateData();
+        
+        bool loadedText = true;
+        if (options.importFile.empty()) {
+            loadExistingStudents(reshard);
+        } else if (!importColumnarFile(*this, options.importFile, error)) {
+            cerr << "Import of " << options.importFile << " failed (" << error << "), reading " << dataFile << endl;
+            loadExistingStudents(reshard);
+        } else {
+            loadedText = false;
+        }
+        resumeFeed();
+        buildCourseBoards();
+        if (loadedText && reshard) reshardFiles(writtenWith);
+        else if (loadedText) recordLayout();
+        
+        // The text sources were newer than the snapshot (or there was none): refresh it
+        if (!options.snapshotFile.empty()) writeSnapshot(options.snapshotFile);
+    }
+    
+    // Everything a snapshot depends on; any change makes the snapshot stale
+    vector<SourceStamp> snapshotSources() const {
+        vector<SourceStamp> sources;
+        sources.push_back(stampFile(csvFile));
+        sources.push_back(stampFile(dataFile));
+        if (shards.size() > 1) {
+            for (const auto& shard : shards) sources.push_back(stampFile(shard->dataFile));
+        }
+        return sources;
+    }
+    
+    // The whole in-memory state as a snapshot payload. With cut, every shard
+    // stays locked for the whole copy and *cut is the feed position it shows.
+    string encodeState(uint64_t* cut = nullptr) const {
+        vector<shared_lock<shared_mutex>> held;
+        if (cut) {
+            for (const auto& shard : shards) held.emplace_back(shard->lock);
+            *cut = sequencer.stable();
+        }
+        
+        string payload;
+        putRaw<uint32_t>(payload, (uint32_t)shards.size());
+        for (const auto& shard : shards) {
+            shared_lock<shared_mutex> guard(shard->lock, defer_lock);
+            if (!cut) guard.lock();
+            putRaw<uint32_t>(payload, (uint32_t)shard->students.size());
+            shard->students.forEach([&payload](const string&, const Student& st) {
+                putString(payload, st.getID());
+                putString(payload, st.getName());
+                putRaw<uint32_t>(payload, st.getVersion());
+                putRaw<uint64_t>(payload, st.getSeq());
+                putRaw<uint32_t>(payload, (uint32_t)st.getCourses().size());
+                for (const auto& c : st.getCourses()) {
+                    putString(payload, c.getCode());
+                    putString(payload, c.getName());
+                    putRaw<int32_t>(payload, c.getMarks());
+                    putRaw<int32_t>(payload, c.getMaxMarks());
+                }
+            });
+            putRaw<uint32_t>(payload, (uint32_t)shard->tombstones.size());
+            for (const auto& pair : shard->tombstones) {
+                putString(payload, pair.first);
+                putRaw<uint64_t>(payload, pair.second);
+            }
+            putRaw<uint32_t>(payload, (uint32_t)shard->history.size());
+            shard->history.forEach([&payload](const string& key, const vector<PastVersion>& chain) {
+                putString(payload, key);
+                putRaw<uint32_t>(payload, (uint32_t)chain.size());
+                for (const auto& v : chain) {
+                    putRaw<uint64_t>(payload, v.seq);
+                    putString(payload, v.card);
+                }
+            });
+        }
+        putRaw<uint32_t>(payload, (uint32_t)classPercentageMap.size());
+        for (const auto& pair : classPercentageMap) {
+            putString(payload, pair.first);
+            putRaw<float>(payload, pair.second);
+        }
+        putRaw<uint32_t>(payload, (uint32_t)classDuplicates.size());
+        for (const auto& pair : classDuplicates) {
+            putString(payload, pair.first);
+            putRaw<uint32_t>(payload, (uint32_t)pair.second.size());
+            for (float v : pair.second) putRaw<float>(payload, v);
+        }
+        auto steps = sequencer.timeSteps();
+        putRaw<uint32_t>(payload, (uint32_t)steps.size());
+        for (const auto& step : steps) {
+            putRaw<uint64_t>(payload, step.first);
+            putRaw<int64_t>(payload, step.second);
+        }
+        return payload;
+    }
+    
+    string writeSnapshot(const string& path) {
+        // Stamp the sources before copying state: a write racing with us then
+        // makes the snapshot look stale rather than silently missing a record
+        flush();
+        vector<SourceStamp> sources = snapshotSources();
+        string payload = encodeState();
+        
+        string image = packSnapshot(sources, payload);
+        string tmp = path + ".tmp";
+        {
+            ofstream fout(tmp, ios::binary | ios::trunc);
+            if (!fout || !fout.write(image.data(), image.size())) return errorJSON("Cannot write snapshot");
+        }
+        error_code ec;
+        filesystem::rename(tmp, path, ec);
+        if (ec) return errorJSON("Cannot write snapshot");
+        
+        stringstream ss;
+        ss << "{\"path\":\"" << path << "\",\"rawBytes\":" << payload.size()
+           << ",\"bytes\":" << image.size() << "}";
+        return ss.str();
+    }
+    
+    bool loadSnapshot(const string& path, string& error) {
+        ifstream fin(path, ios::binary);
+        if (!fin) { error = "missing"; return false; }
+        string image((istreambuf_iterator<char>(fin)), istreambuf_iterator<char>());
+        
+        string payload;
+        if (!unpackSnapshot(image, snapshotSources(), payload, error)) return false;
+        return decodeState(payload, true, error);
+    }
+    
+    // Replaces the whole in-memory state with an encodeState() payload. The
+    // payload may come from a store with a different shard count (a primary).
+    // withClassList = false keeps the class list already loaded.
+    bool decodeState(const string& payload, bool withClassList, string& error) {
+        ByteReader r(payload.data(), payload.size());
+        uint32_t shardCount;
+        if (!r.get(shardCount)) { error = "corrupt payload"; return false; }
+        
+        // Decode everything first so a corrupt payload leaves the store as it was
+        vector<vector<pair<string, Student>>> decoded(shards.size());
+        vector<vector<pair<string, uint64_t>>> deleted(shards.size());
+        vector<VersionHistory> histories(shards.size());
+        for (uint32_t s = 0; s < shardCount; s++) {
+            uint32_t n;
+            if (!r.get(n)) { error = "corrupt payload"; return false; }
+            for (uint32_t i = 0; i < n; i++) {
+                string prn, name;
+                uint32_t version, courses;
+                uint64_t seq;
+                if (!r.getString(prn) || !r.getString(name) || !r.get(version) || !r.get(seq) || !r.get(courses)) {
+                    error = "corrupt payload";
+                    return false;
+                }
+                Student st(name, prn);
+                st.setVersion(version);
+                st.setSeq(seq);
+                for (uint32_t k = 0; k < courses; k++) {
+                    string code, cname;
+                    int32_t marks, maxMarks;
+                    if (!r.getString(code) || !r.getString(cname) || !r.get(marks) || !r.get(maxMarks)) {
+                        error = "corrupt payload";
+                        return false;
+                    }
+                    st.addCourse(Course(code, cname, marks, maxMarks));
+                }
+                string key = toUpperPRN(prn);
+                decoded[shardIndex(key)].emplace_back(key, std::move(st));
+            }
+            if (!r.get(n)) { error = "corrupt payload"; return false; }
+            for (uint32_t i = 0; i < n; i++) {
+                string prn;
+                uint64_t seq;
+                if (!r.getString(prn) || !r.get(seq)) { error = "corrupt payload"; return false; }
+                deleted[shardIndex(prn)].emplace_back(std::move(prn), seq);
+            }
+            if (!r.get(n)) { error = "corrupt payload"; return false; }
+            for (uint32_t i = 0; i < n; i++) {
+                string key;
+                uint32_t count;
+                if (!r.getString(key) || !r.get(count)) { error = "corrupt payload"; return false; }
+                for (uint32_t k = 0; k < count; k++) {
+                    uint64_t seq;
+                    string card;
+                    if (!r.get(seq) || !r.getString(card)) { error = "corrupt payload"; return false; }
+                    histories[shardIndex(key)].keep(key, seq, std::move(card));
+                }
+            }
+        }
+        map<string, float> classmates;
+        map<string, vector<float>> duplicates;
+        uint32_t n;
+        if (!r.get(n)) { error = "corrupt payload"; return false; }
+        for (uint32_t i = 0; i < n; i++) {
+            string prn;
+            float perc;
+            if (!r.getString(prn) || !r.get(perc)) { error = "corrupt payload"; return false; }
+            classmates.emplace_hint(classmates.end(), prn, perc);
+        }
+        if (!r.get(n)) { error = "corrupt payload"; return false; }
+        for (uint32_t i = 0; i < n; i++) {
+            string prn;
+            uint32_t count;
+            if (!r.getString(prn) || !r.get(count)) { error = "corrupt payload"; return false; }
+            auto& values = duplicates[prn];
+            for (uint32_t k = 0; k < count; k++) {
+                float v;
+                if (!r.get(v)) { error = "corrupt payload"; return false; }
+                values.push_back(v);
+            }
+        }
+        vector<pair<uint64_t, int64_t>> steps;
+        if (!r.get(n)) { error = "corrupt payload"; return false; }
+        for (uint32_t i = 0; i < n; i++) {
+            uint64_t seq;
+            int64_t ms;
+            if (!r.get(seq) || !r.get(ms)) { error = "corrupt payload"; return false; }
+            steps.emplace_back(seq, ms);
+        }
+        
+        // Swap every shard at once so readers never mix old and new shards
+        vector<unique_lock<shared_mutex>> held;
+        for (const auto& shard : shards) held.emplace_back(shard->lock);
+        for (size_t i = 0; i < shards.size(); i++) {
+            shards[i]->clear();
+            for (const auto& entry : decoded[i]) shards[i]->put(entry.first, entry.second);
+            for (const auto& entry : deleted[i]) {
+                shards[i]->tombstones[entry.first] = entry.second;
+                shards[i]->logChange(entry.second, entry.first);
+            }
+            shards[i]->history = std::move(histories[i]);
+        }
+        scatter([](size_t, StoreShard& shard) { shard.buildBoards(); });  // still under the locks above
+        held.clear();
+        sequencer.reset();
+        for (const auto& step : steps) sequencer.recordTime(step.first, step.second);
+        if (withClassList) {
+            classPercentageMap.swap(classmates);
+            classDuplicates.swap(duplicates);
+        }
+        resumeFeed();
+        return true;
+    }
+    
+    size_t getShardCount() const { return shards.size(); }
+    JobManager& getJobs() { return jobs; }
+    
+    // False in --web mode, where nothing would be left to finish a job or answer JOB_STATUS
+    bool runsBackgroundJobs() const { return !singleCommand; }
+    const string& getDataFile() const { return dataFile; }
+    
+    // ---- replication (see REPLICATION) ----
+    ReplicationState& getReplication() { return replication; }
+    
+    void startPrimary(const string& listenAddress, size_t logBytes) {
+        replication.startPrimary(listenAddress, logBytes, [this] { return sequencer.issued(); });
+    }
+    bool isReadOnly() const { return replication.isFollower(); }
+    uint64_t stableSeq() const { return sequencer.stable(); }
+    uint64_t waitForChanges(uint64_t after, int ms) const { return sequencer.waitPast(after, ms); }
+    int64_t commitTime(uint64_t seq) const { return sequencer.timeOf(seq); }
+    
+    // The whole store for a new follower, and the feed position it shows
+    string replicaImage(uint64_t& seq) const {
+        return packSnapshot(vector<SourceStamp>(), encodeState(&seq));
+    }
+    
+    bool installReplicaImage(const string& image, uint64_t seq, bool withClassList, string& error) {
+        string payload;
+        if (!unpackSnapshot(image, vector<SourceStamp>(), payload, error)) return false;
+        if (!decodeState(payload, withClassList, error)) return false;
+        sequencer.resume(seq);
+        return true;
+    }
+    
+    // Record blocks shipped by the primary, in feed order
+    void applyReplicated(const string& text) {
+        istringstream in(text);
+        forEachRecord(in, [this](const FileRecord& rec, const string&) {
+            applyRecord(rec);
+            sequencer.resume(rec.seq);
+        });
+    }
+    
+    string replicationJSON() const {
+        return replication.statusJSON(sequencer.stable(), [this](uint64_t seq) { return sequencer.timeOf(seq); });
+    }
+    
+    // Put a student back into memory without writing it to the data file
+    void restoreStudent(const Student& s) {
+        storeLoaded(toUpperPRN(s.getID()), s);
+    }
+    
+    size_t studentCount() const {
+        size_t n = 0;
+        for (const auto& shard : shards) {
+            shared_lock<shared_mutex> guard(shard->lock);
+            n += shard->students.size();
+        }
+        return n;
+    }
+    
+    // Cut every shard into ranges of roughly rangeSize students. Ranges of a
+    // shard are contiguous and together cover its whole key space.
+    vector<StoreRange> partition(size_t rangeSize) const {
+        if (rangeSize == 0) rangeSize = 1;
+        vector<StoreRange> ranges;
+        for (size_t i = 0; i < shards.size(); i++) {
+            shared_lock<shared_mutex> guard(shards[i]->lock);
+            StoreRange current;
+            current.shard = i;
+            shards[i]->students.forEachInfo([&](const string& key, const CardInfo&) {
+                if (current.size == rangeSize) {
+                    current.last = key;
+                    ranges.push_back(current);
+                    current = StoreRange();
+                    current.shard = i;
+                    current.first = key;
+                }
+                current.size++;
+            });
+            ranges.push_back(current);  // an empty shard still gets one (empty) range
+        }
+        return ranges;
+    }
+    
+    // Visit the students of one range under the shard's read lock
+    template <typename Fn>
+    void forEachInRange(const StoreRange& range, Fn fn) const {
+        const StoreShard& shard = *shards[range.shard];
+        shared_lock<shared_mutex> guard(shard.lock);
+        shard.students.forEachInRange(range.first, range.last, fn);
+    }
+    
+    // Joins the report cards with the classmate CSV on normalized PRN. Both
+    // sides are already sorted, so each store range is merged against its
+    // slice of the CSV independently and the ranges run in parallel.
+    ReconcileReport reconcile(float tolerance, Job* job = nullptr) const {
+        vector<ClassList> csvByShard(shards.size());
+        for (const auto& pair : classPercentageMap) {
+            csvByShard[shardIndex(pair.first)].emplace_back(&pair.first, pair.second);
+        }
+        
+        vector<StoreRange> ranges = partition(JOB_RANGE_SIZE);
+        if (job) {
+            size_t total = 0;
+            for (const auto& r : ranges) total += r.size;
+            job->total = total;
+        }
+        
+        vector<ReconcileReport> partials(ranges.size());
+        TaskGroup group(sharedPool());
+        for (size_t i = 0; i < ranges.size(); i++) {
+            group.run([&, i]() {
+                if (job && job->isCancelled()) return;
+                reconcileRange(ranges[i], csvByShard[ranges[i].shard], tolerance, partials[i]);
+                if (job) job->advance(ranges[i].size);
+            });
+        }
+        group.wait();
+        
+        ReconcileReport report;
+        for (auto& p : partials) {
+            report.matched += p.matched;
+            move(p.mismatches.begin(), p.mismatches.end(), back_inserter(report.mismatches));
+            move(p.onlyInResults.begin(), p.onlyInResults.end(), back_inserter(report.onlyInResults));
+            move(p.onlyInClassList.begin(), p.onlyInClassList.end(), back_inserter(report.onlyInClassList));
+        }
+        for (const auto& pair : classDuplicates) report.duplicates.push_back(pair);
+        return report;
+    }
+    
+    void loadClassmateData() {
+        if (isWorkbook(csvFile)) {
+            loadClassmateWorkbook();
+            return;
+        }
+        BlockFileReader reader(csvFile, ioMode);
+        if (!reader.isOpen()) return;
+        istream fin(&reader);
+        
+        string line;
+        getline(fin, line);  // Skip header
+        
+        while (getline(fin, line)) {
+            if (line.empty()) continue;
+            
+            // Remove BOM if present
+            if (line.size() >= 3 && line[0] == '\xEF' && line[1] == '\xBB' && line[2] == '\xBF') {
+                line = line.substr(3);
+            }
+            
+            stringstream ss(line);
+            string prn, name, percStr;
+            
+            getline(ss, prn, ',');
+            getline(ss, name, ',');
+            getline(ss, percStr, ',');
+            
+            try {
+                float perc = stof(percStr);
+                storeClassmate(toUpperPRN(string(trimView(prn))), perc);
+            } catch (...) {
+                continue;
+            }
+        }
+    }
+    
+    static bool isWorkbook(const string& file) {
+        string ext = filesystem::path(file).extension().string();
+        transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+        return ext == ".xlsx";
+    }
+    
+    // Same columns as the CSV (PRN, name, percentage). Rows whose percentage
+    // is not a number (the header, blank rows) are skipped; a cell formatted
+    // as a percentage holds a fraction and is scaled back to 0-100.
+    void loadClassmateWorkbook() {
+        string error;
+        bool ok = readXlsxRows(csvFile, [this](const XlsxRow& row) {
+            const string& percStr = row.cells[2];
+            char* end = nullptr;
+            float perc = strtof(percStr.c_str(), &end);
+            if (percStr.empty() || end == percStr.c_str()) return;
+            string prn = toUpperPRN(string(trimView(row.cells[0])));
+            if (prn.empty()) return;
+            if (row.percentFormat[2]) perc *= 100;
+            storeClassmate(prn, perc);
+        }, error);
+        if (!ok && error != "missing") cerr << "Class list " << csvFile << " unreadable (" << error << ")" << endl;
+    }
+    
+    // The layout file's count; for trees written before it existed, the
+    // highest shard file present (1 when there are none)
+    size_t recordedShardCount() const {
+        ifstream in(layoutFileName(dataFile));
+        string line, value;
+        int count = 0;
+        if (getline(in, line) && startsWith(line, "shards=", value) && parseInt(value, count) == ParseError::None &&
+            count > 0) {
+            return (size_t)count;
+        }
+        vector<size_t> present = existingShardFiles(dataFile);
+        return present.empty() ? 1 : present.back() + 1;
+    }
+    
+    void recordLayout() {
+        if (shards.size() == 1) {
+            remove(layoutFileName(dataFile).c_str());
+            return;
+        }
+        if (recordedShardCount() == shards.size() && filesystem::exists(layoutFileName(dataFile))) return;
+        string tmp = layoutFileName(dataFile) + ".tmp";
+        FILE* out = fopen(tmp.c_str(), "wb");
+        if (!out) return;
+        string text = "shards=" + to_string(shards.size()) + "\n";
+        bool ok = fwrite(text.data(), 1, text.size(), out) == text.size() && PersistenceWriter::syncFile(out);
+        ok = (fclose(out) == 0) && ok;
+        error_code ec;
+        if (ok) filesystem::rename(tmp, layoutFileName(dataFile), ec);
+        else remove(tmp.c_str());
+    }
+    
+    // Rewrites the data files for the current shard count once everything
+    // is in memory: each shard file is compacted, then files of the old
+    // layout are removed and the new count recorded. A crash part way
+    // leaves the old count recorded, so the next start replays every file
+    // again.
+    void reshardFiles(size_t from) {
+        cerr << "Re-sharding " << dataFile << " from " << from << " to " << shards.size() << " shard(s)" << endl;
+        bool ok = true;
+        for (auto& shard : shards) {
+            CompactionStats stats;
+            ok = compactShard(*shard, false, stats) && ok;
+        }
+        if (!ok) {
+            cerr << "Re-sharding " << dataFile << " failed, the old files are kept" << endl;
+            return;
+        }
+        error_code ec;
+        for (size_t index : existingShardFiles(dataFile)) {
+            if (shards.size() == 1 || index >= shards.size()) {
+                filesystem::remove(shardFileName(dataFile, index), ec);
+                filesystem::remove(historyFileName(shardFileName(dataFile, index)), ec);
+            }
+        }
+        if (shards.size() > 1) {
+            filesystem::remove(dataFile, ec);
+            filesystem::remove(historyFileName(dataFile), ec);
+        }
+        recordLayout();
+    }
+    
+    void loadExistingStudents(bool everyLayout = false) {
+        if (everyLayout) {
+            loadEveryShardFile();
+            return;
+        }
+        if (shards.size() == 1) {
+            loadRecordFile(dataFile);
+            return;
+        }
+        
+        // Records written before sharding was enabled are routed on load,
+        // then every shard replays its own (newer) file in parallel
+        loadRecordFile(dataFile);
+        scatter([this](size_t, StoreShard& shard) { loadRecordFile(shard.dataFile); });
+    }
+    
+    // The pre-sharding file and every shard file present, merged in commit
+    // (Seq) order: after a change of shard count one student's records can
+    // be spread over several files. Records from before the change feed
+    // (Seq 0) come first, in file order.
+    void loadEveryShardFile() {
+        vector<string> files = {historyFileName(dataFile), dataFile};
+        for (size_t index : existingShardFiles(dataFile)) {
+            files.push_back(historyFileName(shardFileName(dataFile, index)));
+            files.push_back(shardFileName(dataFile, index));
+        }
+        vector<FileRecord> records;
+        for (const auto& file : files) {
+            BlockFileReader reader(file, ioMode);
+            if (!reader.isOpen()) continue;
+            istream fin(&reader);
+            forEachRecord(fin, [&records](const FileRecord& rec, const string&) { records.push_back(rec); });
+        }
+        stable_sort(records.begin(), records.end(),
+                    [](const FileRecord& a, const FileRecord& b) { return a.seq < b.seq; });
+        for (const auto& rec : records) applyRecord(rec);
+    }
+    
+    // A data file's history segment (written by compaction) holds older
+    // versions than the file itself, so it is replayed first
+    void loadRecordFile(const string& file) {
+        for (const string& path : {historyFileName(file), file}) {
+            BlockFileReader reader(path, ioMode);
+            if (!reader.isOpen()) continue;
+            istream fin(&reader);
+            
+            forEachRecord(fin, [this](const FileRecord& rec, const string&) { applyRecord(rec); });
+        }
+    }
+    
+    // Every write below queues its record while still holding the shard lock,
+    // so the file sees changes to a student in the same order memory did.
+    // Only the wait for fsync happens outside the lock.
+    
+    // Stores (or replaces) a card; stored gets it with its new version
+    WriteResult addStudent(const Student& s, Student& stored) {
+        string prnUpper = toUpperPRN(s.getID());
+        StoreShard& shard = shardFor(prnUpper);
+        shared_ptr<PersistenceWriter::DurableWaiter> durable;
+        {
+            unique_lock<shared_mutex> guard(shard.lock);
+            CardInfo current;
+            unsigned version = shard.students.peek(prnUpper, current) ? current.version + 1 : 1;
+            stored = s;
+            stored.setVersion(version);
+            stored.setSeq(sequencer.begin());
+            shard.put(prnUpper, stored);
+            string record = stored.toFileRecord(sequencer.timeOf(stored.getSeq()));
+            replication.append(stored.getSeq(), record);
+            durable = shard.writer->enqueue(std::move(record));
+            sequencer.end(stored.getSeq());
+        }
+        if (durable && !PersistenceWriter::wait(durable)) return WriteResult::NotDurable;
+        return WriteResult::Ok;
+    }
+    
+    // expectedVersion 0 = unconditional; otherwise the change only applies if
+    // the student is still at that version (compare-and-set)
+    WriteResult updateMarks(const string& prn, const string& courseCode, int marks,
+                            unsigned expectedVersion, Student& out) {
+        string prnUpper = toUpperPRN(prn);
+        StoreShard& shard = shardFor(prnUpper);
+        shared_ptr<PersistenceWriter::DurableWaiter> durable;
+        {
+            unique_lock<shared_mutex> guard(shard.lock);
+            if (!shard.students.get(prnUpper, out)) return WriteResult::NotFound;
+            if (expectedVersion != 0 && expectedVersion != out.getVersion()) return WriteResult::VersionConflict;
+            int index = out.findCourse(courseCode);
+            if (index < 0) return WriteResult::NoSuchCourse;
+            if (marks < 0 || marks > out.getCourses()[index].getMaxMarks()) return WriteResult::InvalidMarks;
+            
+            uint64_t seq = sequencer.begin();
+            shard.updateMarks(prnUpper, index, marks, seq, out.getVersion() + 1);
+            out.setCourseMarks(index, marks);
+            out.setSeq(seq);
+            out.setVersion(out.getVersion() + 1);
+            string record = marksUpdateRecord(out.getID(), courseCode, marks, out.getVersion(), seq,
+                                              sequencer.timeOf(seq));
+            replication.append(seq, record);
+            durable = shard.writer->enqueue(std::move(record));
+            sequencer.end(seq);
+        }
+        if (durable && !PersistenceWriter::wait(durable)) return WriteResult::NotDurable;
+        return WriteResult::Ok;
+    }
+    
+    WriteResult deleteStudent(const string& prn, unsigned expectedVersion, Student& out) {
+        string prnUpper = toUpperPRN(prn);
+        StoreShard& shard = shardFor(prnUpper);
+        shared_ptr<PersistenceWriter::DurableWaiter> durable;
+        {
+            unique_lock<shared_mutex> guard(shard.lock);
+            if (!shard.students.get(prnUpper, out)) return WriteResult::NotFound;
+            if (expectedVersion != 0 && expectedVersion != out.getVersion()) return WriteResult::VersionConflict;
+            
+            uint64_t seq = sequencer.begin();
+            shard.erase(prnUpper, seq);
+            string record = deleteRecord(out.getID(), out.getVersion() + 1, seq, sequencer.timeOf(seq));
+            replication.append(seq, record);
+            durable = shard.writer->enqueue(std::move(record));
+            sequencer.end(seq);
+            out.setSeq(seq);
+        }
+        if (durable && !PersistenceWriter::wait(durable)) return WriteResult::NotDurable;
+        return WriteResult::Ok;
+    }
+    
+    // 1-based position by percentage across all shards; ties share a rank
+    bool rankOf(const string& prn, size_t& rank, size_t& of, Student& out) const {
+        if (!searchStudent(prn, out)) return false;
+        rank = 1;
+        of = 0;
+        for (const auto& shard : shards) {
+            shared_lock<shared_mutex> guard(shard->lock);
+            rank += shard->rankIndex.countAbove(out.getPercentage());
+            of += shard->students.size();
+        }
+        return true;
+    }
+    
+    void flush() {
+        for (auto& shard : shards) shard->writer->flush();
+    }
+    
+    bool isCompact() const { return shards[0]->students.isCompact(); }
+    
+    // Estimated heap bytes of everything held in memory, per structure
+    MemoryUsage memoryUsage() const {
+        MemoryUsage usage;
+        for (const auto& shard : shards) {
+            shared_lock<shared_mutex> guard(shard->lock);
+            shard->addMemory(usage);
+        }
+        usage.history += sequencer.memoryBytes();
+        for (const auto& pair : classPercentageMap) {
+            usage.classList += mapNodeBytes<decltype(classPercentageMap)::value_type>() + stringHeapBytes(pair.first);
+        }
+        for (const auto& pair : classDuplicates) {
+            usage.classList += mapNodeBytes<decltype(classDuplicates)::value_type>() + stringHeapBytes(pair.first)
+                             + allocationBytes(pair.second.capacity() * sizeof(float));
+        }
+        return usage;
+    }
+    
+    // Rewrites one shard's data file with only its live records, and its
+    // history segment with the past versions AS_OF needs, one full card
+    // each (so the data file itself only shrinks). The live set is copied
+    // under the shard lock together with a marker in the writer queue; both
+    // files are rebuilt off to the side, then the writer thread appends
+    // whatever arrived after the marker and renames them into place, the
+    // history first: after a crash between the two renames the old data
+    // file still replays correctly on top of the new history.
+    bool compactShard(StoreShard& shard, bool audit, CompactionStats& stats) {
+        unique_ptr<StudentTable> live;
+        map<string, uint64_t> tombstones;
+        VersionHistory history;
+        uint64_t markSize = 0;
+        shared_ptr<PersistenceWriter::DurableWaiter> marker;
+        if (historyRetentionMs > 0) {
+            uint64_t cutoff = seqAsOf(historyHorizon());
+            unique_lock<shared_mutex> guard(shard.lock);
+            shard.history.prune(cutoff, [&shard](const string& key, uint64_t& seq) { return shard.headSeq(key, seq); });
+        }
+        {
+            shared_lock<shared_mutex> guard(shard.lock);
+            live = make_unique<StudentTable>(shard.students);
+            tombstones = shard.tombstones;
+            history = shard.history;
+            marker = shard.writer->post([&markSize](const string& file) {
+                error_code ec;
+                uintmax_t n = filesystem::file_size(file, ec);
+                markSize = ec ? 0 : n;
+            });
+        }
+        PersistenceWriter::wait(marker);
+        
+        // No history: the segment is removed instead of left empty
+        string historyFile = historyFileName(shard.dataFile);
+        string historyTmp = historyFile + ".compact";
+        bool ok = true;
+        if (history.size() > 0) {
+            FILE* past = fopen(historyTmp.c_str(), "wb");
+            if (!past) return false;
+            history.forEach([&](const string& key, const vector<PastVersion>& chain) {
+                for (const auto& v : chain) {
+                    string rec = v.card.empty() ? deleteRecord(key, 0, v.seq, sequencer.timeOf(v.seq))
+                                                : unpackCard(v.card, v.seq).toFileRecord(sequencer.timeOf(v.seq));
+                    ok = ok && fwrite(rec.data(), 1, rec.size(), past) == rec.size();
+                }
+            });
+            ok = PersistenceWriter::syncFile(past) && ok;
+            ok = (fclose(past) == 0) && ok;
+            if (!ok) {
+                remove(historyTmp.c_str());
+                return false;
+            }
+        }
+        
+        string tmp = shard.dataFile + ".compact";
+        FILE* out = fopen(tmp.c_str(), "wb");
+        if (!out) {
+            remove(historyTmp.c_str());
+            return false;
+        }
+        live->forEach([&](const string&, const Student& s) {
+            string rec = s.toFileRecord(sequencer.timeOf(s.getSeq()));
+            ok = ok && fwrite(rec.data(), 1, rec.size(), out) == rec.size();
+        });
+        // Deletes stay in the file so subscribers behind them still see them
+        for (const auto& pair : tombstones) {
+            string rec = deleteRecord(pair.first, 0, pair.second, sequencer.timeOf(pair.second));
+            ok = ok && fwrite(rec.data(), 1, rec.size(), out) == rec.size();
+        }
+        
+        if (ok && audit) {
+            size_t archived = 0;
+            string dead = supersededRecords(shard.dataFile, markSize,
+                [&live](const string& key, Student& s) { return live->get(key, s); }, archived);
+            ok = appendDurably(auditFileName(shard.dataFile), dead);
+            if (ok) stats.archived += archived;
+        }
+        if (!ok) {
+            fclose(out);
+            remove(tmp.c_str());
+            remove(historyTmp.c_str());
+            return false;
+        }
+        
+        auto commit = shard.writer->post([&](const string& file) {
+            string tail;
+            error_code ec;
+            uintmax_t end = filesystem::file_size(file, ec);
+            if (ec) end = 0;
+            ok = readFileRange(file, markSize, end, tail) &&
+                 fwrite(tail.data(), 1, tail.size(), out) == tail.size() &&
+                 PersistenceWriter::syncFile(out);
+            ok = (fclose(out) == 0) && ok;
+            if (ok && history.size() > 0) {
+                filesystem::rename(historyTmp, historyFile, ec);
+                ok = !ec;
+            } else if (ok) {
+                filesystem::remove(historyFile, ec);
+                ec.clear();
+            }
+            if (ok) {
+                filesystem::rename(tmp, file, ec);
+                ok = !ec;
+            }
+            if (ok) {
+                stats.bytesBefore += end;
+                stats.bytesAfter += filesystem::file_size(file, ec);
+                if (history.size() > 0) stats.historyBytes += filesystem::file_size(historyFile, ec);
+            } else {
+                remove(tmp.c_str());
+                remove(historyTmp.c_str());
+            }
+        });
+        PersistenceWriter::wait(commit);
+        
+        if (ok) {
+            stats.files++;
+            stats.liveRecords += live->size();
+        }
+        return ok;
+    }
+    
+    string compact(bool audit, Job* job = nullptr) {
+        vector<CompactionStats> partial(shards.size());
+        atomic<bool> failed(false);
+        if (job) job->total = shards.size();
+        
+        TaskGroup group(sharedPool());
+        for (size_t i = 0; i < shards.size(); i++) {
+            group.run([&, i]() {
+                if (job && job->isCancelled()) return;
+                if (!compactShard(*shards[i], audit, partial[i])) failed = true;
+                if (job) job->advance(1);
+            });
+        }
+        group.wait();
+        
+        CompactionStats total;
+        for (const auto& p : partial) {
+            total.files += p.files;
+            total.liveRecords += p.liveRecords;
+            total.archived += p.archived;
+            total.bytesBefore += p.bytesBefore;
+            total.bytesAfter += p.bytesAfter;
+            total.historyBytes += p.historyBytes;
+        }
+        
+        // With sharding on, every record of the pre-sharding file now lives in
+        // a compacted shard file, so the legacy file can be retired
+        error_code ec;
+        bool cancelled = job && job->isCancelled();
+        if (!failed && !cancelled && shards.size() > 1 && filesystem::exists(dataFile, ec)) {
+            uint64_t size = filesystem::file_size(dataFile, ec);
+            bool ok = true;
+            if (audit) {
+                size_t archived = 0;
+                string dead = supersededRecords(dataFile, size, [this](const string& key, Student& s) {
+                    return searchStudent(key, s);
+                }, archived);
+                ok = appendDurably(auditFileName(dataFile), dead);
+                if (ok) total.archived += archived;
+            }
+            if (ok && filesystem::remove(dataFile, ec)) {
+                total.files++;
+                total.bytesBefore += size;
+                filesystem::remove(historyFileName(dataFile), ec);
+            }
+        }
+        
+        stringstream ss;
+        ss << "{\"files\":" << total.files << ",\"liveRecords\":" << total.liveRecords
+           << ",\"archived\":" << total.archived << ",\"bytesBefore\":" << total.bytesBefore
+           << ",\"bytesAfter\":" << total.bytesAfter << ",\"historyBytes\":" << total.historyBytes
+           << ",\"failed\":" << (failed ? "true" : "false") << "}";
+        return ss.str();
+    }
+    
+    bool searchStudent(const string& prn, Student& out) const {
+        string searchPRN = toUpperPRN(prn);
+        StoreShard& shard = shardFor(searchPRN);
+        shared_lock<shared_mutex> guard(shard.lock);
+        
+        return shard.students.get(searchPRN, out);
+    }
+    
+    // Last feed position committed at or before ms, for the AS_OF queries.
+    // UINT64_MAX (no bound) is never returned: the answer stops at stable().
+    uint64_t seqAsOf(int64_t ms) const {
+        return min(sequencer.seqAt(ms), sequencer.stable());
+    }
+    
+    // Earliest time AS_OF still answers for (Unix ms, 0 = no limit):
+    // compaction drops the versions that were superseded before it
+    int64_t historyHorizon() const {
+        return historyRetentionMs > 0 ? nowMillis() - historyRetentionMs : 0;
+    }
+    
+    bool searchStudentAsOf(const string& prn, uint64_t bound, Student& out) const {
+        string searchPRN = toUpperPRN(prn);
+        StoreShard& shard = shardFor(searchPRN);
+        shared_lock<shared_mutex> guard(shard.lock);
+        
+        return shard.versionAsOf(searchPRN, bound, out);
+    }
+    
+    bool searchClassmate(const string& prn, float& percentage) {
+        string searchPRN = prn;
+        transform(searchPRN.begin(), searchPRN.end(), searchPRN.begin(), ::toupper);
+        
+        auto it = classPercentageMap.find(searchPRN);
+        if (it != classPercentageMap.end()) {
+            percentage = it->second;
+            return true;
+        }
+        return false;
+    }
+    
+    // asOf = a feed position from seqAsOf() for the students as they were then
+    string getAllStudentsJSON(uint64_t asOf = UINT64_MAX) const {
+        // Each shard serializes its own (already PRN-sorted) students, then
+        // the per-shard runs are merged so the output stays in PRN order
+        vector<vector<pair<string, string>>> parts(shards.size());
+        scatter([&parts, asOf](size_t idx, StoreShard& shard) {
+            shared_lock<shared_mutex> guard(shard.lock);
+            auto& out = parts[idx];
+            auto emit = [&out](const string& key, const Student& s) {
+                out.emplace_back(key, s.toJSON());
+            };
+            if (asOf == UINT64_MAX) {
+                out.reserve(shard.students.size());
+                shard.students.forEach(emit);
+            } else {
+                shard.forEachAsOf(asOf, emit);
+            }
+        });
+        
+        typedef pair<const string*, size_t> Head;  // key, shard
+        auto later = [](const Head& a, const Head& b) { return *a.first > *b.first; };
+        priority_queue<Head, vector<Head>, decltype(later)> heads(later);
+        vector<size_t> pos(parts.size(), 0);
+        for (size_t i = 0; i < parts.size(); i++) {
+            if (!parts[i].empty()) heads.push(Head(&parts[i][0].first, i));
+        }
+        
+        string out = "[";
+        bool first = true;
+        while (!heads.empty()) {
+            size_t i = heads.top().second;
+            heads.pop();
+            if (!first) out += ",";
+            first = false;
+            out += parts[i][pos[i]].second;
+            if (++pos[i] < parts[i].size()) heads.push(Head(&parts[i][pos[i]].first, i));
+        }
+        out += "]";
+        return out;
+    }
+    
+    // Change feed: everything after feed position `since`, oldest first, at
+    // most `limit` entries. since = 0, or a position this store has never
+    // reached (e.g. the data files were replaced), answers with a reset: every
+    // live student, which the subscriber should use to replace its copy.
+    string changesSinceJSON(uint64_t since, size_t limit) const {
+        uint64_t stable = sequencer.stable();
+        bool reset = since == 0 || since > stable;
+        
+        typedef pair<uint64_t, string> Change;  // feed position, JSON
+        vector<Change> changes;
+        bool more = false;
+        for (const auto& shard : shards) {
+            shared_lock<shared_mutex> guard(shard->lock);
+            if (reset) {
+                shard->students.forEach([&changes](const string&, const Student& s) {
+                    changes.emplace_back(s.getSeq(),
+                        "{\"seq\":" + to_string(s.getSeq()) + ",\"op\":\"upsert\",\"student\":" + s.toJSON() + "}");
+                });
+                continue;
+            }
+            size_t taken = 0;
+            for (auto it = shard->changeLog.upper_bound(since); it != shard->changeLog.end() && it->first <= stable; ++it) {
+                if (taken == limit) { more = true; break; }
+                Student live;
+                string body = shard->students.get(it->second, live)
+                    ? "\"op\":\"upsert\",\"student\":" + live.toJSON()
+                    : "\"op\":\"delete\",\"prn\":\"" + it->second + "\"";
+                changes.emplace_back(it->first, "{\"seq\":" + to_string(it->first) + "," + body + "}");
+                taken++;
+            }
+        }
+        
+        uint64_t upTo = stable;
+        if (!reset) {
+            sort(changes.begin(), changes.end());
+            if (changes.size() > limit) {
+                changes.resize(limit);
+                more = true;
+            }
+            // Every shard contributed all of its changes up to the last one kept
+            if (more) upTo = changes.empty() ? since : changes.back().first;
+        }
+        
+        string out = "{\"seq\":" + to_string(upTo) + ",\"reset\":" + (reset ? "true" : "false")
+                   + ",\"more\":" + (more ? "true" : "false") + ",\"changes\":[";
+        for (size_t i = 0; i < changes.size(); i++) {
+            if (i > 0) out += ",";
+            out += changes[i].second;
+        }
+        out += "]}";
+        return out;
+    }
+    
+    ShardStats computeStats(uint64_t asOf = UINT64_MAX) const {
+        vector<ShardStats> partial(shards.size());
+        scatter([&partial, asOf](size_t idx, StoreShard& shard) {
+            shared_lock<shared_mutex> guard(shard.lock);
+            auto add = [&partial, idx](const string&, const Student& s) {
+                partial[idx].add(s.getPercentage(), s.getGrade());
+            };
+            if (asOf == UINT64_MAX) shard.students.forEach(add);
+            else shard.forEachAsOf(asOf, add);
+        });
+        
+        ShardStats total;
+        for (const auto& p : partial) total.merge(p);
+        return total;
+    }
+    
+    // TOP/BOTTOM: `course` is a course name (as in "DSA"), or a code when
+    // no course has that name. Every shard hands over its first k from that
+    // end of each matching board, and the best k of those are the answer.
+    // Marks are reported as a percentage of the course maximum.
+    string courseBoardJSON(const string& course, size_t k, bool fromTop) const {
+        struct Placed {
+            uint16_t bucket;
+            string key;
+            Student student;
+            int index;
+        };
+        vector<shared_lock<shared_mutex>> held;
+        for (const auto& shard : shards) held.emplace_back(shard->lock);
+        bool byName = false;
+        for (const auto& shard : shards) {
+            for (const auto& board : shard->courseBoards) byName = byName || StoreShard::boardName(board.first) == course;
+        }
+        
+        vector<Placed> found;
+        size_t of = 0;
+        for (const auto& shard : shards) {
+            for (const auto& board : shard->courseBoards) {
+                string_view code = StoreShard::boardCode(board.first), name = StoreShard::boardName(board.first);
+                if ((byName ? name : code) != course) continue;
+                of += board.second.size();
+                board.second.visit(fromTop, k, [&](string_view key) {
+                    Placed p;
+                    p.key = string(key);
+                    if (!shard->students.get(p.key, p.student)) return;
+                    const auto& courses = p.student.getCourses();
+                    auto it = find_if(courses.begin(), courses.end(), [&](const Course& c) {
+                        return c.getCode() == code && c.getName() == name;
+                    });
+                    if (it == courses.end()) return;
+                    p.index = (int)(it - courses.begin());
+                    p.bucket = CourseBoard::bucket(it->getMarks(), it->getMaxMarks());
+                    found.push_back(std::move(p));
+                });
+            }
+        }
+        if (of == 0) return errorJSON("Course not found");
+        
+        sort(found.begin(), found.end(), [fromTop](const Placed& a, const Placed& b) {
+            if (a.bucket != b.bucket) return fromTop ? a.bucket > b.bucket : a.bucket < b.bucket;
+            return a.key < b.key;
+        });
+        if (found.size() > k) found.resize(k);
+        
+        stringstream ss;
+        ss << "{\"course\":\"" << course << "\",\"order\":\"" << (fromTop ? "top" : "bottom")
+           << "\",\"of\":" << of << ",\"results\":[";
+        for (size_t i = 0; i < found.size(); i++) {
+            const Student& s = found[i].student;
+            const Course& c = s.getCourses()[found[i].index];
+            ss << (i ? "," : "") << "{\"prn\":\"" << s.getID() << "\",\"name\":\"" << s.getName()
+               << "\",\"marks\":" << c.getMarks() << ",\"maxMarks\":" << c.getMaxMarks()
+               << ",\"normalized\":" << fixed << setprecision(2)
+               << (c.getMaxMarks() > 0 ? 100.0 * c.getMarks() / c.getMaxMarks() : 0.0) << "}";
+        }
+        ss << "]}";
+        return ss.str();
+    }
+    
+    // fn(columns), one CohortColumns per shard, with every shard read-locked
+    // for the whole call so the cohort is a single consistent cut
+    template <typename Fn>
+    auto withCohortColumns(Fn fn) const {
+        vector<shared_lock<shared_mutex>> held;
+        for (const auto& shard : shards) held.emplace_back(shard->lock);
+        vector<const CohortColumns*> columns(shards.size());
+        scatter([&columns](size_t idx, StoreShard& shard) { columns[idx] = &shard.cohortColumns(); });
+        return fn(columns);
+    }
+    
+    string getStatsJSON(uint64_t asOf = UINT64_MAX) const {
+        ShardStats st = computeStats(asOf);
+        stringstream ss;
+        ss << "{\"count\":" << st.count
+           << ",\"average\":" << fixed << setprecision(2) << (st.count ? st.totalPercentage / st.count : 0.0)
+           << ",\"highest\":" << st.highest
+           << ",\"lowest\":" << st.lowest
+           << ",\"shards\":" << shards.size()
+           << ",\"grades\":{";
+        const char gradeNames[] = "ABCDEF";
+        for (int i = 0; i < 6; i++) {
+            if (i > 0) ss << ",";
+            ss << "\"" << gradeNames[i] << "\":" << st.gradeCounts[i];
+        }
+        ss << "}}";
+        return ss.str();
+    }
+    
+    string getClassmateJSON(const string& prn) {
+        float perc;
+        if (searchClassmate(prn, perc)) {
+            char grade;
+            if (perc >= 90) grade = 'A';
+            else if (perc >= 75) grade = 'B';
+            else if (perc >= 60) grade = 'C';
+            else if (perc >= 50) grade = 'D';
+            else if (perc >= 40) grade = 'E';
+            else grade = 'F';
+            
+            stringstream ss;
+            ss << "{\"success\":true,\"prn\":\"" << prn 
+               << "\",\"percentage\":" << fixed << setprecision(2) << perc
+               << ",\"grade\":\"" << grade << "\"}";
+            return ss.str();
+        }
+        return "{\"success\":false,\"error\":\"PRN not found\"}";
+    }
+};
+
+// ==================== BATCH JOB TYPES ====================
+// Cut-offs for A..E, anything below the last one is an F
+struct GradePolicy {
+    float cutoffs[5] = {90, 75, 60, 50, 40};
+    
+    char gradeFor(float perc) const {
+        for (int i = 0; i < 5; i++) {
+            if (perc >= cutoffs[i]) return "ABCDE"[i];
+        }
+        return 'F';
+    }
+};
+
+bool parseGradePolicy(string_view text, GradePolicy& policy) {
+    GradePolicy parsed;
+    size_t n = 0;
+    while (n < 5) {
+        size_t comma = text.find(',');
+        int value = 0;
+        if (parseInt(text.substr(0, comma), value) != ParseError::None) return false;
+        if (value < 0 || value > 100 || (n > 0 && value > parsed.cutoffs[n - 1])) return false;
+        parsed.cutoffs[n++] = (float)value;
+        if (comma == string_view::npos) break;
+        text.remove_prefix(comma + 1);
+    }
+    if (n != 5) return false;
+    policy = parsed;
+    return true;
+}
+
+// Run rangeFn over every partition of the store on the pool, tracking progress
+template <typename Partial, typename RangeFn>
+vector<Partial> runOverStore(const ResultManager& manager, Job& job, RangeFn rangeFn) {
+    vector<StoreRange> ranges = manager.partition(JOB_RANGE_SIZE);
+    size_t total = 0;
+    for (const auto& r : ranges) total += r.size;
+    job.total = total;
+    
+    vector<Partial> partials(ranges.size());
+    TaskGroup group(sharedPool());
+    for (size_t i = 0; i < ranges.size(); i++) {
+        group.run([&, i]() {
+            if (job.isCancelled()) return;
+            rangeFn(ranges[i], partials[i]);
+            job.advance(ranges[i].size);
+        });
+    }
+    group.wait();
+    return partials;
+}
+
+struct RegradePartial {
+    int gradeCounts[6] = {0, 0, 0, 0, 0, 0};
+    size_t changed = 0;
+};
+
+string runRegradeJob(const ResultManager& manager, Job& job, GradePolicy policy) {
+    auto partials = runOverStore<RegradePartial>(manager, job,
+        [&manager, &policy](const StoreRange& range, RegradePartial& out) {
+            manager.forEachInRange(range, [&](const string&, const Student& s) {
+                char g = policy.gradeFor(s.getPercentage());
+                out.gradeCounts[g - 'A']++;
+                if (g != s.getGrade()) out.changed++;
+            });
+        });
+    
+    RegradePartial total;
+    for (const auto& p : partials) {
+        for (int i = 0; i < 6; i++) total.gradeCounts[i] += p.gradeCounts[i];
+        total.changed += p.changed;
+    }
+    
+    stringstream ss;
+    ss << "{\"policy\":[";
+    for (int i = 0; i < 5; i++) ss << (i ? "," : "") << policy.cutoffs[i];
+    ss << "],\"changed\":" << total.changed << ",\"grades\":{";
+    for (int i = 0; i < 6; i++) ss << (i ? "," : "") << "\"" << "ABCDEF"[i] << "\":" << total.gradeCounts[i];
+    ss << "}}";
+    return ss.str();
+}
+
+struct CourseAggregate {
+    size_t count = 0;
+    double totalNormalized = 0;
+    double best = 0;
+    double worst = 0;
+    
+    void add(double v) {
+        if (count == 0 || v > best) best = v;
+        if (count == 0 || v < worst) worst = v;
+        count++;
+        totalNormalized += v;
+    }
+    
+    void merge(const CourseAggregate& o) {
+        if (o.count == 0) return;
+        if (count == 0 || o.best > best) best = o.best;
+        if (count == 0 || o.worst < worst) worst = o.worst;
+        count += o.count;
+        totalNormalized += o.totalNormalized;
+    }
+};
+
+string runCourseStatsJob(const ResultManager& manager, Job& job) {
+    typedef map<string, CourseAggregate> CourseTable;
+    auto partials = runOverStore<CourseTable>(manager, job,
+        [&manager](const StoreRange& range, CourseTable& out) {
+            manager.forEachInRange(range, [&](const string&, const Student& s) {
+                for (const auto& c : s.getCourses()) {
+                    if (c.getMaxMarks() > 0) out[c.getCode()].add(100.0 * c.getMarks() / c.getMaxMarks());
+                }
+            });
+        });
+    
+    CourseTable total;
+    for (const auto& p : partials) {
+        for (const auto& pair : p) total[pair.first].merge(pair.second);
+    }
+    
+    stringstream ss;
+    ss << "[";
+    bool first = true;
+    for (const auto& pair : total) {
+        if (!first) ss << ",";
+        first = false;
+        const CourseAggregate& a = pair.second;
+        ss << "{\"code\":\"" << pair.first << "\",\"students\":" << a.count
+           << ",\"average\":" << fixed << setprecision(2) << a.totalNormalized / a.count
+           << ",\"highest\":" << a.best << ",\"lowest\":" << a.worst << "}";
+    }
+    ss << "]";
+    return ss.str();
+}
+
+string runExportCardsJob(const ResultManager& manager, Job& job, const string& path) {
+    auto partials = runOverStore<string>(manager, job,
+        [&manager](const StoreRange& range, string& out) {
+            manager.forEachInRange(range, [&](const string&, const Student& s) {
+                out += s.toFileRecord();
+            });
+        });
+    if (job.isCancelled()) return "";
+    
+    ofstream fout(path, ios::binary | ios::trunc);
+    if (!fout) throw runtime_error("Cannot open export file");
+    for (const auto& block : partials) fout << block;
+    
+    stringstream ss;
+    ss << "{\"path\":\"" << path << "\",\"students\":" << job.total.load() << "}";
+    return ss.str();
+}
+
+// ==================== WHAT-IF SIMULATION ====================
+// SIMULATE re-grades the whole cohort as if marks or cut-offs had changed
+// (grace marks in one course, moderation to a new maximum, a new grade
+// policy) and reports what would move, without touching the store. Each
+// shard's CohortColumns are cut into chunks that run on the pool; a chunk
+// walks the flat mark columns once and totals every row the way
+// Student::addCourse does, so percentages and grades match a real change.
+const size_t SIMULATION_CHUNK = 8192;
+
+enum class AdjustKind { Add, Scale, Cap };
+
+struct MarkAdjustment {
+    AdjustKind kind = AdjustKind::Add;
+    string code;    // "*" = every course
+    int value = 0;
+    
+    // ADD keeps marks within 0..maxMarks, SCALE re-expresses them out of
+    // value (rounded to the nearest mark), CAP lowers anything above value
+    void apply(int& marks, int& maxMarks) const {
+        switch (kind) {
+            case AdjustKind::Add:
+                marks = max(0, min(maxMarks, marks + value));
+                break;
+            case AdjustKind::Scale:
+                marks = maxMarks > 0 ? (int)lround((double)marks * value / maxMarks) : 0;
+                maxMarks = value;
+                break;
+            case AdjustKind::Cap:
+                marks = min(marks, value);
+                break;
+        }
+    }
+};
+
+const char* adjustmentName(AdjustKind kind) {
+    switch (kind) {
+        case AdjustKind::Add: return "ADD";
+        case AdjustKind::Scale: return "SCALE";
+        case AdjustKind::Cap: return "CAP";
+    }
+    return "";
+}
+
+// ADD:code:n (n may be negative), SCALE:code:newMax or CAP:code:n
+bool parseAdjustment(string_view text, MarkAdjustment& out) {
+    size_t first = text.find(':');
+    size_t last = text.rfind(':');
+    if (first == string_view::npos || first == last) return false;
+    string_view op = text.substr(0, first);
+    string_view code = trimView(text.substr(first + 1, last - first - 1));
+    int value = 0;
+    if (code.empty() || parseInt(text.substr(last + 1), value) != ParseError::None) return false;
+    
+    if (op == "ADD" && value >= -1000 && value <= 1000) out.kind = AdjustKind::Add;
+    else if (op == "SCALE" && value > 0 && value <= 100000) out.kind = AdjustKind::Scale;
+    else if (op == "CAP" && value >= 0) out.kind = AdjustKind::Cap;
+    else return false;
+    out.code = string(code);
+    out.value = value;
+    return true;
+}
+
+struct WhatIfSpec {
+    vector<MarkAdjustment> adjustments;  // applied to each course entry in this order
+    GradePolicy policy;
+    size_t limit = SIZE_MAX;             // students listed in the reply
+};
+
+struct SimulatedChange {
+    string key;
+    float before, after;
+    char gradeBefore, gradeAfter;
+};
+
+struct SimulationPartial {
+    int gradesBefore[6] = {0, 0, 0, 0, 0, 0};
+    int gradesAfter[6] = {0, 0, 0, 0, 0, 0};
+    double totalBefore = 0;
+    double totalAfter = 0;
+    size_t affected = 0;              // percentage moved
+    size_t improved = 0;
+    size_t worsened = 0;
+    vector<size_t> entries;           // course entries each adjustment applied to
+    vector<SimulatedChange> changes;  // grade moved, in key order
+};
+
+// plan[code id] = the adjustments that apply to that course, in spec order
+void simulateRows(const CohortColumns& cols, const vector<vector<uint32_t>>& plan, const WhatIfSpec& spec,
+                  size_t begin, size_t end, SimulationPartial& out) {
+    out.entries.assign(spec.adjustments.size(), 0);
+    for (size_t r = begin; r < end; r++) {
+        int total = 0, totalMax = 0;
+        for (uint32_t e = cols.firstCourse[r]; e < cols.firstCourse[r + 1]; e++) {
+            int marks = cols.marks[e], maxMarks = cols.maxMarks[e];
+            for (uint32_t a : plan[cols.course[e]]) {
+                spec.adjustments[a].apply(marks, maxMarks);
+                out.entries[a]++;
+            }
+            total += marks;
+            totalMax += maxMarks;
+        }
+        // Student::calculatePercentage, to the bit
+        float percentage = (totalMax > 0) ? (float)total / totalMax * 100 : 0;
+        char grade = spec.policy.gradeFor(percentage);
+        float before = cols.percentage[r];
+        char gradeBefore = cols.grade[r];
+        
+        out.gradesBefore[gradeBefore - 'A']++;
+        out.gradesAfter[grade - 'A']++;
+        out.totalBefore += before;
+        out.totalAfter += percentage;
+        if (percentage != before) out.affected++;
+        if (grade != gradeBefore) {
+            if (grade < gradeBefore) out.improved++;
+            else out.worsened++;
+            out.changes.push_back({cols.keys[r], before, percentage, gradeBefore, grade});
+        }
+    }
+}
+
+string runSimulation(const ResultManager& manager, const WhatIfSpec& spec) {
+    auto started = chrono::steady_clock::now();
+    size_t rows = 0;
+    SimulationPartial total;
+    total.entries.assign(spec.adjustments.size(), 0);
+    
+    manager.withCohortColumns([&](const vector<const CohortColumns*>& shards) {
+        struct Chunk { size_t shard, begin, end; };
+        vector<Chunk> chunks;
+        vector<vector<vector<uint32_t>>> plans(shards.size());
+        for (size_t s = 0; s < shards.size(); s++) {
+            const CohortColumns& cols = *shards[s];
+            plans[s].resize(cols.codes.size());
+            for (size_t c = 0; c < cols.codes.size(); c++) {
+                for (size_t a = 0; a < spec.adjustments.size(); a++) {
+                    const string& code = spec.adjustments[a].code;
+                    if (code == "*" || code == cols.codes[c]) plans[s][c].push_back((uint32_t)a);
+                }
+            }
+            rows += cols.rows();
+            for (size_t begin = 0; begin < cols.rows(); begin += SIMULATION_CHUNK) {
+                chunks.push_back({s, begin, min(cols.rows(), begin + SIMULATION_CHUNK)});
+            }
+        }
+        
+        vector<SimulationPartial> partials(chunks.size());
+        TaskGroup group(sharedPool());
+        for (size_t i = 0; i < chunks.size(); i++) {
+            group.run([&, i]() {
+                const Chunk& c = chunks[i];
+                simulateRows(*shards[c.shard], plans[c.shard], spec, c.begin, c.end, partials[i]);
+            });
+        }
+        group.wait();
+        
+        for (auto& p : partials) {
+            for (int g = 0; g < 6; g++) {
+                total.gradesBefore[g] += p.gradesBefore[g];
+                total.gradesAfter[g] += p.gradesAfter[g];
+            }
+            total.totalBefore += p.totalBefore;
+            total.totalAfter += p.totalAfter;
+            total.affected += p.affected;
+            total.improved += p.improved;
+            total.worsened += p.worsened;
+            for (size_t a = 0; a < p.entries.size(); a++) total.entries[a] += p.entries[a];
+            move(p.changes.begin(), p.changes.end(), back_inserter(total.changes));
+        }
+    });
+    
+    // Shards hold interleaved key ranges; list the students in PRN order
+    auto& changes = total.changes;
+    sort(changes.begin(), changes.end(),
+         [](const SimulatedChange& a, const SimulatedChange& b) { return a.key < b.key; });
+    size_t listed = min(changes.size(), spec.limit);
+    
+    stringstream ss;
+    ss << "{\"students\":" << rows << ",\"adjustments\":[";
+    for (size_t a = 0; a < spec.adjustments.size(); a++) {
+        const MarkAdjustment& adj = spec.adjustments[a];
+        ss << (a ? "," : "") << "{\"op\":\"" << adjustmentName(adj.kind) << "\",\"course\":\"" << adj.code
+           << "\",\"value\":" << adj.value << ",\"entries\":" << total.entries[a] << "}";
+    }
+    ss << "],\"policy\":[";
+    for (int i = 0; i < 5; i++) ss << (i ? "," : "") << spec.policy.cutoffs[i];
+    ss << "]";
+    
+    auto distribution = [&ss, rows](const char* label, double sum, const int* grades) {
+        ss << ",\"" << label << "\":{\"average\":" << fixed << setprecision(2) << (rows ? sum / rows : 0.0)
+           << ",\"grades\":{";
+        for (int g = 0; g < 6; g++) ss << (g ? "," : "") << "\"" << "ABCDEF"[g] << "\":" << grades[g];
+        ss << "}}";
+    };
+    distribution("before", total.totalBefore, total.gradesBefore);
+    distribution("after", total.totalAfter, total.gradesAfter);
+    ss << ",\"affected\":" << total.affected << ",\"changed\":" << changes.size()
+       << ",\"improved\":" << total.improved << ",\"worsened\":" << total.worsened << ",\"changes\":[";
+    for (size_t i = 0; i < listed; i++) {
+        const SimulatedChange& c = changes[i];
+        Student s;
+        bool found = manager.searchStudent(c.key, s);
+        ss << (i ? "," : "") << "{\"prn\":\"" << (found ? s.getID() : c.key) << "\",\"name\":\""
+           << (found ? s.getName() : "") << "\",\"before\":{\"percentage\":" << c.before
+           << ",\"grade\":\"" << c.gradeBefore << "\"},\"after\":{\"percentage\":" << c.after
+           << ",\"grade\":\"" << c.gradeAfter << "\"}}";
+    }
+    ss << "],\"more\":" << (listed < changes.size() ? "true" : "false") << ",\"elapsedMs\":"
+       << chrono::duration<double, milli>(chrono::steady_clock::now() - started).count() << "}";
+    return ss.str();
+}
+
+// ==================== REPORT CARD RENDERER ====================
+// Templates use {{field}} or {{field:width}} (left-aligned, padded like setw)
+// and one {{#courses}}...{{/courses}} section repeated per course. They are
+// compiled once into a flat segment list, so rendering a card is a single
+// walk that appends into a reusable buffer.
+class CardTemplate {
+private:
+    enum class Segment { Literal, Field, CoursesBegin, CoursesEnd };
+    
+    enum Field {
+        F_PRN, F_NAME, F_PERCENTAGE, F_GRADE, F_COURSE_COUNT,
+        F_COURSE_CODE, F_COURSE_NAME, F_COURSE_MARKS, F_COURSE_MAX, F_COURSE_PERCENT
+    };
+    
+    struct Part {
+        Segment kind;
+        string text;      // Literal
+        Field field;      // Field
+        size_t width;     // Field, 0 = no padding
+        size_t jump;      // CoursesBegin: index of the matching CoursesEnd
+    };
+    
+    vector<Part> parts;
+    bool escapeHtml;
+    
+    static bool lookupField(string_view name, bool inCourses, Field& f) {
+        if (inCourses) {
+            if (name == "code") { f = F_COURSE_CODE; return true; }
+            if (name == "name") { f = F_COURSE_NAME; return true; }
+            if (name == "marks") { f = F_COURSE_MARKS; return true; }
+            if (name == "maxMarks") { f = F_COURSE_MAX; return true; }
+            if (name == "percent") { f = F_COURSE_PERCENT; return true; }
+        }
+        if (name == "prn") { f = F_PRN; return true; }
+        if (name == "name") { f = F_NAME; return true; }
+        if (name == "percentage") { f = F_PERCENTAGE; return true; }
+        if (name == "grade") { f = F_GRADE; return true; }
+        if (name == "courseCount") { f = F_COURSE_COUNT; return true; }
+        return false;
+    }
+    
+    void appendValue(string& out, string_view value, size_t width) const {
+        size_t start = out.size();
+        if (escapeHtml) {
+            for (char c : value) {
+                switch (c) {
+                    case '&': out += "&amp;"; break;
+                    case '<': out += "&lt;"; break;
+                    case '>': out += "&gt;"; break;
+                    case '"': out += "&quot;"; break;
+                    default: out += c;
+                }
+            }
+        } else {
+            out.append(value.data(), value.size());
+        }
+        if (width > out.size() - start) out.append(width - (out.size() - start), ' ');
+    }
+    
+public:
+    CardTemplate(const string& text, bool html) : escapeHtml(html) {
+        bool inCourses = false;
+        size_t sectionStart = 0;
+        size_t pos = 0;
+        
+        while (pos < text.size()) {
+            size_t open = text.find("{{", pos);
+            if (open == string::npos) open = text.size();
+            if (open > pos) parts.push_back({Segment::Literal, text.substr(pos, open - pos), F_PRN, 0, 0});
+            if (open == text.size()) break;
+            
+            size_t close = text.find("}}", open + 2);
+            if (close == string::npos) throw runtime_error("Unterminated template tag");
+            string_view tag = trimView(string_view(text).substr(open + 2, close - open - 2));
+            pos = close + 2;
+            
+            if (tag == "#courses") {
+                if (inCourses) throw runtime_error("Nested courses section");
+                inCourses = true;
+                sectionStart = parts.size();
+                parts.push_back({Segment::CoursesBegin, "", F_PRN, 0, 0});
+                continue;
+            }
+            if (tag == "/courses") {
+                if (!inCourses) throw runtime_error("Unmatched /courses");
+                inCourses = false;
+                parts[sectionStart].jump = parts.size();
+                parts.push_back({Segment::CoursesEnd, "", F_PRN, 0, sectionStart});
+                continue;
+            }
+            
+            size_t width = 0;
+            size_t colon = tag.find(':');
+            if (colon != string_view::npos) {
+                int w = 0;
+                if (parseInt(tag.substr(colon + 1), w) != ParseError::None || w < 0) {
+                    throw runtime_error("Bad field width in template");
+                }
+                width = w;
+                tag = tag.substr(0, colon);
+            }
+            Field f;
+            if (!lookupField(tag, inCourses, f)) throw runtime_error("Unknown template field");
+            parts.push_back({Segment::Field, "", f, width, 0});
+        }
+        if (inCourses) throw runtime_error("Unterminated courses section");
+    }
+    
+    void render(const Student& s, string& out) const {
+        const vector<Course>& courses = s.getCourses();
+        size_t course = 0;
+        char num[32];
+        
+        for (size_t i = 0; i < parts.size(); i++) {
+            const Part& p = parts[i];
+            switch (p.kind) {
+                case Segment::Literal:
+                    out += p.text;
+                    break;
+                case Segment::CoursesBegin:
+                    course = 0;
+                    if (courses.empty()) i = p.jump;
+                    break;
+                case Segment::CoursesEnd:
+                    if (++course < courses.size()) i = p.jump;
+                    break;
+                case Segment::Field: {
+                    const Course* c = (course < courses.size()) ? &courses[course] : nullptr;
+                    switch (p.field) {
+                        case F_PRN: appendValue(out, s.getID(), p.width); break;
+                        case F_NAME: appendValue(out, s.getName(), p.width); break;
+                        case F_PERCENTAGE:
+                            snprintf(num, sizeof(num), "%.2f", s.getPercentage());
+                            appendValue(out, num, p.width);
+                            break;
+                        case F_GRADE: {
+                            char g = s.getGrade();
+                            appendValue(out, string_view(&g, 1), p.width);
+                            break;
+                        }
+                        case F_COURSE_COUNT:
+                            appendValue(out, to_string(courses.size()), p.width);
+                            break;
+                        case F_COURSE_CODE: if (c) appendValue(out, c->getCode(), p.width); break;
+                        case F_COURSE_NAME: if (c) appendValue(out, c->getName(), p.width); break;
+                        case F_COURSE_MARKS: if (c) appendValue(out, to_string(c->getMarks()), p.width); break;
+                        case F_COURSE_MAX: if (c) appendValue(out, to_string(c->getMaxMarks()), p.width); break;
+                        case F_COURSE_PERCENT:
+                            if (c) {
+                                snprintf(num, sizeof(num), "%.2f",
+                                         c->getMaxMarks() ? 100.0 * c->getMarks() / c->getMaxMarks() : 0.0);
+                                appendValue(out, num, p.width);
+                            }
+                            break;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+};
+
+// Same layout as Student::display() in Student_Result_Management_Enhanced.cpp
+const char* const TEXT_CARD_TEMPLATE =
+    "=====================================================\n"
+    "                  STUDENT REPORT CARD                \n"
+    "=====================================================\n"
+    "Student PRN: {{prn}}\n"
+    "Student Name: {{name}}\n"
+    "\n"
+    "-----------------------------------------------------\n"
+    "Code        Course Name              Marks       Max Marks   \n"
+    "-----------------------------------------------------\n"
+    "{{#courses}}{{code:12}}{{name:25}}{{marks:12}}{{maxMarks:12}}\n{{/courses}}"
+    "-----------------------------------------------------\n"
+    "                       Percentage: {{percentage}}%\n"
+    "                            Grade: {{grade}}\n"
+    "=====================================================\n";
+
+const char* const HTML_CARD_TEMPLATE =
+    "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Report Card - {{prn}}</title>\n"
+    "<style>body{font-family:Arial,sans-serif;margin:40px}h1{text-align:center}"
+    "table{border-collapse:collapse;width:100%}th,td{border:1px solid #999;padding:6px 10px;text-align:left}"
+    "th{background:#eee}.summary{margin-top:16px;font-size:1.1em}</style></head>\n<body>\n"
+    "<h1>Student Report Card</h1>\n"
+    "<p><b>Student PRN:</b> {{prn}}<br><b>Student Name:</b> {{name}}</p>\n"
+    "<table>\n<tr><th>Code</th><th>Course Name</th><th>Marks</th><th>Max Marks</th><th>%</th></tr>\n"
+    "{{#courses}}<tr><td>{{code}}</td><td>{{name}}</td><td>{{marks}}</td><td>{{maxMarks}}</td><td>{{percent}}</td></tr>\n{{/courses}}"
+    "</table>\n"
+    "<p class=\"summary\"><b>Percentage:</b> {{percentage}}% &nbsp; <b>Grade:</b> {{grade}}</p>\n"
+    "</body></html>\n";
+
+// Minimal single-page PDF (Courier, one text line per card line), no dependencies
+void writeTextAsPDF(const string& text, string& out) {
+    string content = "BT\n/F1 10 Tf\n12 TL\n50 780 Td\n";
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t nl = text.find('\n', start);
+        if (nl == string::npos) nl = text.size();
+        content += "(";
+        for (size_t i = start; i < nl; i++) {
+            unsigned char c = text[i];
+            if (c == '(' || c == ')' || c == '\\') content += '\\';
+            content += (c >= 32 && c < 127) ? (char)c : '?';
+        }
+        content += ") Tj T*\n";
+        start = nl + 1;
+    }
+    content += "ET\n";
+    
+    vector<size_t> offsets;
+    out += "%PDF-1.4\n";
+    auto object = [&](const string& body) {
+        offsets.push_back(out.size());
+        out += to_string(offsets.size()) + " 0 obj\n" + body + "\nendobj\n";
+    };
+    object("<< /Type /Catalog /Pages 2 0 R >>");
+    object("<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+    object("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 595 842] "
+           "/Resources << /Font << /F1 4 0 R >> >> /Contents 5 0 R >>");
+    object("<< /Type /Font /Subtype /Type1 /BaseFont /Courier >>");
+    object("<< /Length " + to_string(content.size()) + " >>\nstream\n" + content + "endstream");
+    
+    size_t xref = out.size();
+    out += "xref\n0 " + to_string(offsets.size() + 1) + "\n0000000000 65535 f \n";
+    char entry[24];
+    for (size_t off : offsets) {
+        snprintf(entry, sizeof(entry), "%010zu 00000 n \n", off);
+        out += entry;
+    }
+    out += "trailer\n<< /Size " + to_string(offsets.size() + 1) + " /Root 1 0 R >>\n";
+    out += "startxref\n" + to_string(xref) + "\n%%EOF\n";
+}
+
+const CardTemplate& textCardTemplate() {
+    static const CardTemplate t(TEXT_CARD_TEMPLATE, false);
+    return t;
+}
+
+const CardTemplate& htmlCardTemplate() {
+    static const CardTemplate t(HTML_CARD_TEMPLATE, true);
+    return t;
+}
+
+// Keep PRNs usable as file names on every platform. Any other byte becomes
+// %XX, so two PRNs never share a stem (an empty PRN is "%").
+string cardFileStem(const string& prn) {
+    static const char hex[] = "0123456789ABCDEF";
+    string stem;
+    for (char c : prn) {
+        unsigned char u = (unsigned char)c;
+        if (isalnum(u) || c == '-' || c == '_') {
+            stem += c;
+        } else {
+            stem += '%';
+            stem += hex[u >> 4];
+            stem += hex[u & 15];
+        }
+    }
+    return stem.empty() ? "%" : stem;
+}
+
+struct RenderPartial {
+    size_t files = 0;
+    size_t bytes = 0;
+    size_t failures = 0;
+};
+
+// JOB|RENDER|html|txt|pdf|all|directory
+string runRenderJob(const ResultManager& manager, Job& job, const string& format, const string& directory) {
+    bool wantTxt = format == "txt" || format == "all";
+    bool wantHtml = format == "html" || format == "all";
+    bool wantPdf = format == "pdf" || format == "all";
+    
+    filesystem::create_directories(directory);
+    const CardTemplate& textTpl = textCardTemplate();
+    const CardTemplate& htmlTpl = htmlCardTemplate();
+    
+    // Stems differ in case only on a case-insensitive file system: the
+    // second card would overwrite the first there, so it is a failure
+    mutex stemsLock;
+    set<string> stems;
+    auto claimStem = [&](const string& stem) {
+        string folded = stem;
+        for (char& c : folded) c = (char)tolower((unsigned char)c);
+        lock_guard<mutex> lock(stemsLock);
+        return stems.insert(folded).second;
+    };
+    
+    auto partials = runOverStore<RenderPartial>(manager, job,
+        [&](const StoreRange& range, RenderPartial& out) {
+            // Copy the range out so the shard lock is not held during file I/O
+            vector<Student> batch;
+            batch.reserve(range.size);
+            manager.forEachInRange(range, [&](const string&, const Student& s) { batch.push_back(s); });
+            
+            string text, page;
+            auto emit = [&](const string& path, const string& body) {
+                ofstream fout(path, ios::binary | ios::trunc);
+                if (fout && fout.write(body.data(), body.size())) {
+                    out.files++;
+                    out.bytes += body.size();
+                } else {
+                    out.failures++;
+                }
+            };
+            
+            for (const auto& s : batch) {
+                if (job.isCancelled()) return;
+                string stem = cardFileStem(s.getID());
+                if (!claimStem(stem)) {
+                    out.failures += (size_t)wantTxt + wantPdf + wantHtml;
+                    continue;
+                }
+                string base = directory + "/" + stem;
+                if (wantTxt || wantPdf) {
+                    text.clear();
+                    textTpl.render(s, text);
+                }
+                if (wantTxt) emit(base + ".txt", text);
+                if (wantPdf) {
+                    page.clear();
+                    writeTextAsPDF(text, page);
+                    emit(base + ".pdf", page);
+                }
+                if (wantHtml) {
+                    page.clear();
+                    htmlTpl.render(s, page);
+                    emit(base + ".html", page);
+                }
+            }
+        });
+    
+    RenderPartial total;
+    for (const auto& p : partials) {
+        total.files += p.files;
+        total.bytes += p.bytes;
+        total.failures += p.failures;
+    }
+    
+    stringstream ss;
+    ss << "{\"format\":\"" << format << "\",\"directory\":\"" << directory
+       << "\",\"files\":" << total.files << ",\"bytes\":" << total.bytes
+       << ",\"failures\":" << total.failures << "}";
+    return ss.str();
+}
+
+// ==================== COLUMNAR EXPORT ====================
+// EXPORT writes the store as typed columns instead of JSON/free text, laid
+// out like a small Parquet file:
+//
+//   "SRCOL3\0\0"
+//   row group*   : "RGRP" u32 students u32 courses, then one chunk per column
+//   column chunk : u8 column id, u8 type, u32 values, stats, u64 bytes, data
+//   footer       : schema, course code/name dictionaries, row-group index
+//                  (offset, counts, percentage range, CRC32 of the row group)
+//   u32 footer CRC32, u32 footer length, "SRCOL3\0\0"
+//
+// SRCOL2 files are the same without the two kinds of CRC; they still import.
+// Strings are u32 offsets (values + 1) followed by the bytes. Course codes and
+// names are dictionary-encoded as u32 ids into the footer dictionaries.
+// Numeric chunks carry min/max as two doubles, string chunks as two strings.
+// Integers are little-endian.
+const char COLUMNAR_MAGIC[8] = {'S', 'R', 'C', 'O', 'L', '3', 0, 0};     // 3: adds CRC32s
+const char COLUMNAR_MAGIC_V2[8] = {'S', 'R', 'C', 'O', 'L', '2', 0, 0};  // 2: adds students.version
+const size_t COLUMNAR_ROW_GROUP = 8192;
+
+enum ColumnType : uint8_t { COL_INT32 = 1, COL_FLOAT32 = 2, COL_UINT8 = 3, COL_STRING = 4, COL_DICT = 5 };
+
+struct ColumnSpec {
+    uint8_t id;
+    const char* table;
+    const char* name;
+    ColumnType type;
+};
+
+const ColumnSpec COLUMNAR_SCHEMA[] = {
+    {0, "students", "prn", COL_STRING},
+    {1, "students", "name", COL_STRING},
+    {2, "students", "percentage", COL_FLOAT32},
+    {3, "students", "grade", COL_UINT8},
+    {4, "students", "course_count", COL_INT32},
+    {5, "courses", "code", COL_DICT},
+    {6, "courses", "name", COL_DICT},
+    {7, "courses", "marks", COL_INT32},
+    {8, "courses", "max_marks", COL_INT32},
+    {9, "students", "version", COL_INT32},
+};
+
+const size_t COLUMNAR_COLUMNS = sizeof(COLUMNAR_SCHEMA) / sizeof(COLUMNAR_SCHEMA[0]);
+
+class Dictionary {
+private:
+    unordered_map<string, uint32_t> ids;
+    vector<string> values;
+    
+public:
+    uint32_t idFor(const string& v) {
+        auto it = ids.find(v);
+        if (it != ids.end()) return it->second;
+        uint32_t id = values.size();
+        ids.emplace(v, id);
+        values.push_back(v);
+        return id;
+    }
+    
+    const vector<string>& entries() const { return values; }
+};
+
+struct RowGroupInfo {
+    uint64_t offset;
+    uint32_t students;
+    uint32_t courses;
+    float minPercentage;
+    float maxPercentage;
+    uint32_t crc = 0;  // of the row group's bytes, "RGRP" to the end of its last chunk
+};
+
+class ColumnarWriter {
+private:
+    ofstream out;
+    Dictionary codes, names;
+    vector<RowGroupInfo> groups;
+    uint64_t written;
+    
+    // Column buffers for the row group being built
+    vector<string> prn, studentName;
+    vector<float> percentage;
+    vector<uint8_t> grade;
+    vector<int32_t> courseCount, version;
+    vector<uint32_t> courseCode, courseName;
+    vector<int32_t> marks, maxMarks;
+    
+    void chunkHeader(string& buf, uint8_t id, ColumnType type, size_t values) {
+        putRaw<uint8_t>(buf, id);
+        putRaw<uint8_t>(buf, type);
+        putRaw<uint32_t>(buf, (uint32_t)values);
+    }
+    
+    template <typename T>
+    void numericChunk(string& buf, uint8_t id, ColumnType type, const vector<T>& v) {
+        chunkHeader(buf, id, type, v.size());
+        double lo = 0, hi = 0;
+        if (!v.empty()) {
+            auto mm = minmax_element(v.begin(), v.end());
+            lo = *mm.first;
+            hi = *mm.second;
+        }
+        putRaw<double>(buf, lo);
+        putRaw<double>(buf, hi);
+        putRaw<uint64_t>(buf, v.size() * sizeof(T));
+        buf.append(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+    }
+    
+    void stringChunk(string& buf, uint8_t id, const vector<string>& v) {
+        chunkHeader(buf, id, COL_STRING, v.size());
+        string lo, hi;
+        if (!v.empty()) {
+            auto mm = minmax_element(v.begin(), v.end());
+            lo = *mm.first;
+            hi = *mm.second;
+        }
+        putString(buf, lo);
+        putString(buf, hi);
+        
+        uint64_t bytes = (v.size() + 1) * sizeof(uint32_t);
+        for (const auto& x : v) bytes += x.size();
+        putRaw<uint64_t>(buf, bytes);
+        
+        uint32_t offset = 0;
+        putRaw<uint32_t>(buf, offset);
+        for (const auto& x : v) {
+            offset += x.size();
+            putRaw<uint32_t>(buf, offset);
+        }
+        for (const auto& x : v) buf += x;
+    }
+    
+    void clearColumns() {
+        prn.clear(); studentName.clear(); percentage.clear(); grade.clear(); courseCount.clear(); version.clear();
+        courseCode.clear(); courseName.clear(); marks.clear(); maxMarks.clear();
+    }
+    
+public:
+    explicit ColumnarWriter(const string& path) : out(path, ios::binary | ios::trunc), written(0) {
+        out.write(COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC));
+        written = sizeof(COLUMNAR_MAGIC);
+    }
+    
+    bool good() const { return (bool)out; }
+    
+    void add(const Student& s) {
+        prn.push_back(s.getID());
+        studentName.push_back(s.getName());
+        percentage.push_back(s.getPercentage());
+        grade.push_back((uint8_t)s.getGrade());
+        courseCount.push_back((int32_t)s.getCourses().size());
+        version.push_back((int32_t)s.getVersion());
+        for (const auto& c : s.getCourses()) {
+            courseCode.push_back(codes.idFor(c.getCode()));
+            courseName.push_back(names.idFor(c.getName()));
+            marks.push_back(c.getMarks());
+            maxMarks.push_back(c.getMaxMarks());
+        }
+        if (prn.size() >= COLUMNAR_ROW_GROUP) flushRowGroup();
+    }
+    
+    void flushRowGroup() {
+        if (prn.empty()) return;
+        
+        RowGroupInfo info;
+        info.offset = written;
+        info.students = prn.size();
+        info.courses = marks.size();
+        auto mm = minmax_element(percentage.begin(), percentage.end());
+        info.minPercentage = *mm.first;
+        info.maxPercentage = *mm.second;
+        
+        string buf = "RGRP";
+        putRaw<uint32_t>(buf, info.students);
+        putRaw<uint32_t>(buf, info.courses);
+        stringChunk(buf, 0, prn);
+        stringChunk(buf, 1, studentName);
+        numericChunk(buf, 2, COL_FLOAT32, percentage);
+        numericChunk(buf, 3, COL_UINT8, grade);
+        numericChunk(buf, 4, COL_INT32, courseCount);
+        numericChunk(buf, 5, COL_DICT, courseCode);
+        numericChunk(buf, 6, COL_DICT, courseName);
+        numericChunk(buf, 7, COL_INT32, marks);
+        numericChunk(buf, 8, COL_INT32, maxMarks);
+        numericChunk(buf, 9, COL_INT32, version);
+        info.crc = crc32(buf.data(), buf.size());
+        groups.push_back(info);
+        
+        out.write(buf.data(), buf.size());
+        written += buf.size();
+        clearColumns();
+    }
+    
+    bool finish() {
+        flushRowGroup();
+        
+        string footer;
+        putRaw<uint32_t>(footer, (uint32_t)COLUMNAR_COLUMNS);
+        for (const auto& col : COLUMNAR_SCHEMA) {
+            putRaw<uint8_t>(footer, col.id);
+            putRaw<uint8_t>(footer, col.type);
+            putString(footer, string(col.table) + "." + col.name);
+        }
+        for (const Dictionary* d : {&codes, &names}) {
+            putRaw<uint32_t>(footer, (uint32_t)d->entries().size());
+            for (const auto& v : d->entries()) putString(footer, v);
+        }
+        putRaw<uint32_t>(footer, (uint32_t)groups.size());
+        for (const auto& g : groups) {
+            putRaw<uint64_t>(footer, g.offset);
+            putRaw<uint32_t>(footer, g.students);
+            putRaw<uint32_t>(footer, g.courses);
+            putRaw<float>(footer, g.minPercentage);
+            putRaw<float>(footer, g.maxPercentage);
+            putRaw<uint32_t>(footer, g.crc);
+        }
+        uint32_t footerLen = (uint32_t)footer.size();
+        putRaw<uint32_t>(footer, crc32(footer.data(), footerLen));
+        putRaw<uint32_t>(footer, footerLen);
+        footer.append(COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC));
+        
+        out.write(footer.data(), footer.size());
+        written += footer.size();
+        out.close();
+        return !out.fail();
+    }
+    
+    size_t rowGroups() const { return groups.size(); }
+    size_t dictionarySize() const { return codes.entries().size(); }
+    uint64_t bytesWritten() const { return written; }
+};
+
+// Streams the store range by range into the file; only one row group of
+// columns is ever held in memory
+string exportColumnar(const ResultManager& manager, const string& path, Job* job = nullptr) {
+    ColumnarWriter writer(path);
+    if (!writer.good()) return errorJSON("Cannot open export file");
+    
+    vector<StoreRange> ranges = manager.partition(COLUMNAR_ROW_GROUP);
+    size_t students = 0;
+    if (job) {
+        for (const auto& r : ranges) students += r.size;
+        job->total = students;
+        students = 0;
+    }
+    for (const auto& range : ranges) {
+        if (job && job->isCancelled()) return "";
+        manager.forEachInRange(range, [&](const string&, const Student& s) {
+            writer.add(s);
+            students++;
+        });
+        if (job) job->advance(range.size);
+    }
+    if (!writer.finish()) return errorJSON("Export write failed");
+    
+    stringstream ss;
+    ss << "{\"path\":\"" << path << "\",\"students\":" << students
+       << ",\"rowGroups\":" << writer.rowGroups() << ",\"courseCodes\":" << writer.dictionarySize()
+       << ",\"bytes\":" << writer.bytesWritten() << "}";
+    return ss.str();
+}
+
+struct ColumnChunk {
+    uint8_t id = 0;
+    uint8_t type = 0;
+    uint32_t values = 0;
+    const char* data = nullptr;
+    uint64_t bytes = 0;
+};
+
+bool readColumnChunk(ByteReader& r, ColumnChunk& c) {
+    if (!r.get(c.id) || !r.get(c.type) || !r.get(c.values)) return false;
+    if (c.type == COL_STRING) {
+        string lo, hi;
+        if (!r.getString(lo) || !r.getString(hi)) return false;
+    } else {
+        double lo, hi;
+        if (!r.get(lo) || !r.get(hi)) return false;
+    }
+    if (!r.get(c.bytes) || !r.getBytes(c.bytes, c.data)) return false;
+    
+    size_t width = (c.type == COL_STRING) ? 0 : (c.type == COL_UINT8 ? 1 : 4);
+    if (width && c.bytes != (uint64_t)c.values * width) return false;
+    if (c.type == COL_STRING && c.bytes < ((uint64_t)c.values + 1) * 4) return false;
+    return true;
+}
+
+template <typename T>
+T columnValue(const ColumnChunk& c, size_t i) {
+    T v;
+    memcpy(&v, c.data + i * sizeof(T), sizeof(T));
+    return v;
+}
+
+bool columnString(const ColumnChunk& c, size_t i, string& out) {
+    if ((i + 1) * 4 + 4 > c.bytes) return false;
+    uint32_t begin = columnValue<uint32_t>(c, i), end = columnValue<uint32_t>(c, i + 1);
+    size_t base = ((size_t)c.values + 1) * 4;
+    if (begin > end || base + end > c.bytes) return false;
+    out.assign(c.data + base + begin, end - begin);
+    return true;
+}
+
+// The whole file is decoded and checked (CRCs, column lengths, string
+// offsets, dictionary ids) before the first student reaches the store, so
+// a damaged file leaves the store untouched
+bool importColumnarFile(ResultManager& manager, const string& path, string& error) {
+    ifstream fin(path, ios::binary);
+    if (!fin) { error = "Cannot open import file"; return false; }
+    string image((istreambuf_iterator<char>(fin)), istreambuf_iterator<char>());
+    
+    const size_t magic = sizeof(COLUMNAR_MAGIC);
+    bool checksummed = image.size() >= magic && memcmp(image.data(), COLUMNAR_MAGIC, magic) == 0;
+    const char* expectedMagic = checksummed ? COLUMNAR_MAGIC : COLUMNAR_MAGIC_V2;
+    const size_t trailer = magic + (checksummed ? 8 : 4);
+    if (image.size() < magic + trailer || memcmp(image.data(), expectedMagic, magic) != 0 ||
+        memcmp(image.data() + image.size() - magic, expectedMagic, magic) != 0) {
+        error = "Not a columnar export";
+        return false;
+    }
+    
+    uint32_t footerLen, footerCrc = 0;
+    memcpy(&footerLen, image.data() + image.size() - magic - 4, 4);
+    if (footerLen > image.size() - magic - trailer) { error = "Corrupt footer"; return false; }
+    const char* footerStart = image.data() + image.size() - trailer - footerLen;
+    if (checksummed) {
+        memcpy(&footerCrc, image.data() + image.size() - magic - 8, 4);
+        if (crc32(footerStart, footerLen) != footerCrc) { error = "Footer checksum mismatch"; return false; }
+    }
+    
+    ByteReader footer(footerStart, footerLen);
+    uint32_t columns;
+    if (!footer.get(columns)) { error = "Corrupt footer"; return false; }
+    for (uint32_t i = 0; i < columns; i++) {
+        uint8_t id, type;
+        string name;
+        if (!footer.get(id) || !footer.get(type) || !footer.getString(name)) { error = "Corrupt schema"; return false; }
+    }
+    vector<string> dicts[2];
+    for (auto& d : dicts) {
+        uint32_t n;
+        if (!footer.get(n)) { error = "Corrupt dictionary"; return false; }
+        d.resize(n);
+        for (auto& v : d) if (!footer.getString(v)) { error = "Corrupt dictionary"; return false; }
+    }
+    uint32_t groupCount;
+    if (!footer.get(groupCount)) { error = "Corrupt footer"; return false; }
+    
+    ByteReader body(image.data(), footerStart - image.data());
+    vector<Student> staged;
+    for (uint32_t g = 0; g < groupCount; g++) {
+        RowGroupInfo info;
+        if (!footer.get(info.offset) || !footer.get(info.students) || !footer.get(info.courses) ||
+            !footer.get(info.minPercentage) || !footer.get(info.maxPercentage) ||
+            (checksummed && !footer.get(info.crc))) {
+            error = "Corrupt row-group index";
+            return false;
+        }
+        
+        body.seek(info.offset);
+        const char* tag;
+        uint32_t students, courses;
+        if (!body.getBytes(4, tag) || memcmp(tag, "RGRP", 4) != 0 || !body.get(students) || !body.get(courses) ||
+            students != info.students || courses != info.courses) {
+            error = "Corrupt row group";
+            return false;
+        }
+        
+        // Chunks must come in schema order with the schema's types: the
+        // readers below take the value width from the schema, not the file
+        ColumnChunk col[COLUMNAR_COLUMNS];
+        for (size_t i = 0; i < COLUMNAR_COLUMNS; i++) {
+            if (!readColumnChunk(body, col[i]) || col[i].id != i || col[i].type != COLUMNAR_SCHEMA[i].type) {
+                error = "Corrupt column chunk";
+                return false;
+            }
+        }
+        if (checksummed && crc32(tag, body.position() - info.offset) != info.crc) {
+            error = "Row group checksum mismatch";
+            return false;
+        }
+        for (size_t i = 0; i < COLUMNAR_COLUMNS; i++) {
+            uint32_t expected = strcmp(COLUMNAR_SCHEMA[i].table, "students") == 0 ? students : courses;
+            if (col[i].values != expected) { error = "Column length mismatch"; return false; }
+        }
+        
+        size_t course = 0;
+        for (size_t i = 0; i < students; i++) {
+            string prn, name;
+            if (!columnString(col[0], i, prn) || !columnString(col[1], i, name)) { error = "Corrupt string column"; return false; }
+            int32_t count = columnValue<int32_t>(col[4], i);
+            if (count < 0 || course + count > courses) { error = "Corrupt course count"; return false; }
+            
+            Student s(name, prn);
+            s.setVersion((unsigned)max(0, columnValue<int32_t>(col[9], i)));
+            for (int32_t k = 0; k < count; k++, course++) {
+                uint32_t code = columnValue<uint32_t>(col[5], course), cname = columnValue<uint32_t>(col[6], course);
+                if (code >= dicts[0].size() || cname >= dicts[1].size()) { error = "Bad dictionary id"; return false; }
+                s.addCourse(Course(dicts[0][code], dicts[1][cname],
+                                   columnValue<int32_t>(col[7], course), columnValue<int32_t>(col[8], course)));
+            }
+            staged.push_back(std::move(s));
+        }
+        if (course != courses) { error = "Corrupt course count"; return false; }
+    }
+    
+    for (const auto& s : staged) manager.restoreStudent(s);
+    return true;
+}
+
+string reconcileJSON(const ReconcileReport& r, float tolerance, size_t limit) {
+    stringstream ss;
+    ss << fixed << setprecision(2);
+    ss << "{\"tolerance\":" << tolerance
+       << ",\"matched\":" << r.matched
+       << ",\"mismatchCount\":" << r.mismatches.size()
+       << ",\"onlyInResultsCount\":" << r.onlyInResults.size()
+       << ",\"onlyInClassListCount\":" << r.onlyInClassList.size()
+       << ",\"duplicateCount\":" << r.duplicates.size();
+    
+    ss << ",\"mismatches\":[";
+    for (size_t i = 0; i < r.mismatches.size() && i < limit; i++) {
+        const auto& m = r.mismatches[i];
+        ss << (i ? "," : "") << "{\"prn\":\"" << m.prn << "\",\"computed\":" << m.computed
+           << ",\"published\":" << m.published << ",\"difference\":" << m.computed - m.published << "}";
+    }
+    ss << "],\"onlyInResults\":[";
+    for (size_t i = 0; i < r.onlyInResults.size() && i < limit; i++) {
+        ss << (i ? "," : "") << "\"" << r.onlyInResults[i] << "\"";
+    }
+    ss << "],\"onlyInClassList\":[";
+    for (size_t i = 0; i < r.onlyInClassList.size() && i < limit; i++) {
+        ss << (i ? "," : "") << "\"" << r.onlyInClassList[i] << "\"";
+    }
+    ss << "],\"duplicates\":[";
+    for (size_t i = 0; i < r.duplicates.size() && i < limit; i++) {
+        ss << (i ? "," : "") << "{\"prn\":\"" << r.duplicates[i].first << "\",\"values\":[";
+        for (size_t j = 0; j < r.duplicates[i].second.size(); j++) {
+            ss << (j ? "," : "") << r.duplicates[i].second[j];
+        }
+        ss << "]}";
+    }
+    ss << "]}";
+    return ss.str();
+}
+
+// RECONCILE|tolerance|limit, both optional (0.5 percentage points, 100 entries per list)
+bool parseReconcileArgs(FieldCursor& fields, float& tolerance, int& limit) {
+    tolerance = 0.5f;
+    limit = 100;
+    string_view field;
+    if (fields.next(field) && !trimView(field).empty()) {
+        field = trimView(field);
+        double value = 0;
+        auto result = from_chars(field.data(), field.data() + field.size(), value);
+        if (result.ec != errc() || result.ptr != field.data() + field.size() || value < 0) return false;
+        tolerance = (float)value;
+    }
+    if (fields.next(field) && !trimView(field).empty()) {
+        if (parseInt(field, limit) != ParseError::None || limit < 0) return false;
+    }
+    return true;
+}
+
+// ==================== WEB BRIDGE ====================
+typedef string (*CommandHandler)(ResultManager&, FieldCursor&);
+
+string writeErrorJSON(WriteResult result, const Student& current) {
+    switch (result) {
+        case WriteResult::NotFound: return errorJSON("Student not found");
+        case WriteResult::NoSuchCourse: return errorJSON("Course not found");
+        case WriteResult::InvalidMarks: return errorJSON("Invalid marks range");
+        case WriteResult::NotDurable: return errorJSON("Could not save the change to disk");
+        case WriteResult::VersionConflict: {
+            stringstream ss;
+            ss << "{\"error\":\"Version conflict\",\"version\":" << current.getVersion() << "}";
+            return ss.str();
+        }
+        case WriteResult::Ok: break;
+    }
+    return errorJSON("Write failed");
+}
+
+string handleAdd(ResultManager& manager, FieldCursor& fields) {
+    string_view prn, studentName;
+    int courseCount = 0;
+    
+    if (fields.nextText(prn) != ParseError::None || fields.nextText(studentName) != ParseError::None) {
+        return errorJSON("Invalid command format", ParseError::MissingField, fields.fieldIndex() + 1);
+    }
+    
+    ParseError err = fields.nextInt(courseCount);
+    if (err == ParseError::MissingField) {
+        return errorJSON("Invalid command format", err, fields.fieldIndex() + 1);
+    }
+    if (err != ParseError::None) {
+        return errorJSON("Invalid course count format", err, fields.fieldIndex());
+    }
+    if (courseCount <= 0) {
+        return errorJSON("Invalid course count", ParseError::OutOfRange, fields.fieldIndex());
+    }
+    
+    Student student((string(studentName)), string(prn));
+    
+    for (int i = 0; i < courseCount; i++) {
+        string_view code, name;
+        int marks = 0, maxMarks = 0;
+        
+        if (fields.nextText(code) != ParseError::None || fields.nextText(name) != ParseError::None) {
+            return errorJSON("Missing course data", ParseError::MissingField, fields.fieldIndex() + 1);
+        }
+        
+        err = fields.nextInt(marks);
+        if (err == ParseError::None) err = fields.nextInt(maxMarks);
+        if (err == ParseError::MissingField) {
+            return errorJSON("Missing course data", err, fields.fieldIndex() + 1);
+        }
+        if (err != ParseError::None) {
+            return errorJSON("Invalid marks format", err, fields.fieldIndex());
+        }
+        if (marks < 0 || maxMarks <= 0 || marks > maxMarks) {
+            return errorJSON("Invalid marks range", ParseError::OutOfRange, fields.fieldIndex());
+        }
+        
+        student.addCourse(Course(string(code), string(name), marks, maxMarks));
+    }
+    
+    Student stored;
+    WriteResult result = manager.addStudent(student, stored);
+    if (result != WriteResult::Ok) return writeErrorJSON(result, stored);
+    return stored.toJSON();
+}
+
+// Optional last field of UPDATE_MARKS/DELETE: the version the client last
+// read. 0 (field absent or empty) means write unconditionally.
+ParseError nextExpectedVersion(FieldCursor& fields, unsigned& expected) {
+    expected = 0;
+    string_view field;
+    if (!fields.next(field) || trimView(field).empty()) return ParseError::None;
+    int value = 0;
+    ParseError err = parseInt(field, value);
+    if (err != ParseError::None) return err;
+    if (value <= 0) return ParseError::OutOfRange;
+    expected = (unsigned)value;
+    return ParseError::None;
+}
+
+// UPDATE_MARKS|PRN|CourseCode|marks[|expectedVersion]
+string handleUpdateMarks(ResultManager& manager, FieldCursor& fields) {
+    string_view prn, code;
+    int marks = 0;
+    if (fields.nextText(prn) != ParseError::None || fields.nextText(code) != ParseError::None) {
+        return errorJSON("Invalid command format", ParseError::MissingField, fields.fieldIndex() + 1);
+    }
+    ParseError err = fields.nextInt(marks);
+    if (err == ParseError::MissingField) {
+        return errorJSON("Invalid command format", err, fields.fieldIndex() + 1);
+    }
+    if (err != ParseError::None) {
+        return errorJSON("Invalid marks format", err, fields.fieldIndex());
+    }
+    unsigned expected;
+    err = nextExpectedVersion(fields, expected);
+    if (err != ParseError::None) return errorJSON("Invalid version", err, fields.fieldIndex());
+    
+    Student s;
+    WriteResult result = manager.updateMarks(string(trimView(prn)), string(trimView(code)), marks, expected, s);
+    if (result != WriteResult::Ok) return writeErrorJSON(result, s);
+    return s.toJSON();
+}
+
+// DELETE|PRN[|expectedVersion]
+string handleDelete(ResultManager& manager, FieldCursor& fields) {
+    string_view prn;
+    if (fields.nextText(prn) != ParseError::None) {
+        return errorJSON("Invalid command format", ParseError::MissingField, fields.fieldIndex() + 1);
+    }
+    unsigned expected;
+    ParseError err = nextExpectedVersion(fields, expected);
+    if (err != ParseError::None) return errorJSON("Invalid version", err, fields.fieldIndex());
+    
+    Student s;
+    WriteResult result = manager.deleteStudent(string(trimView(prn)), expected, s);
+    if (result != WriteResult::Ok) return writeErrorJSON(result, s);
+    stringstream ss;
+    ss << "{\"deleted\":\"" << s.getID() << "\",\"version\":" << s.getVersion() + 1
+       << ",\"seq\":" << s.getSeq() << "}";
+    return ss.str();
+}
+
+string handleGetAll(ResultManager& manager, FieldCursor&) {
+    return manager.getAllStudentsJSON();
+}
+
+string handleSearch(ResultManager& manager, FieldCursor& fields) {
+    string_view prn;
+    if (fields.nextText(prn) != ParseError::None) {
+        return errorJSON("Invalid command format", ParseError::MissingField, fields.fieldIndex() + 1);
+    }
+    
+    Student s;
+    if (manager.searchStudent(string(trimView(prn)), s)) return s.toJSON();
+    return errorJSON("Student not found");
+}
+
+// SUBSCRIBE|since_seq|limit: change-feed entries after since_seq (default 0 =
+// full reset), at most limit (default 500). Continue from the returned seq.
+string handleSubscribe(ResultManager& manager, FieldCursor& fields) {
+    uint64_t since = 0;
+    int limit = 500;
+    string_view field;
+    if (fields.next(field) && !trimView(field).empty()) {
+        field = trimView(field);
+        auto result = from_chars(field.data(), field.data() + field.size(), since);
+        if (result.ec != errc() || result.ptr != field.data() + field.size()) {
+            return errorJSON("Invalid sequence number", ParseError::NotANumber, fields.fieldIndex());
+        }
+    }
+    if (fields.next(field) && !trimView(field).empty()) {
+        ParseError err = parseInt(field, limit);
+        if (err == ParseError::None && limit <= 0) err = ParseError::OutOfRange;
+        if (err != ParseError::None) return errorJSON("Invalid limit", err, fields.fieldIndex());
+    }
+    return manager.changesSinceJSON(since, (size_t)limit);
+}
+
+// RANK|PRN: position by percentage among all students (1 = highest)
+string handleRank(ResultManager& manager, FieldCursor& fields) {
+    string_view prn;
+    if (fields.nextText(prn) != ParseError::None) {
+        return errorJSON("Invalid command format", ParseError::MissingField, fields.fieldIndex() + 1);
+    }
+    
+    Student s;
+    size_t rank, of;
+    if (!manager.rankOf(string(trimView(prn)), rank, of, s)) return errorJSON("Student not found");
+    stringstream ss;
+    ss << "{\"prn\":\"" << s.getID() << "\",\"rank\":" << rank << ",\"of\":" << of
+       << ",\"percentage\":" << fixed << setprecision(2) << s.getPercentage() << "}";
+    return ss.str();
+}
+
+string handleStats(ResultManager& manager, FieldCursor&) {
+    return manager.getStatsJSON();
+}
+
+// AS_OF|time|SEARCH|PRN, AS_OF|time|GET_ALL, AS_OF|time|STATS: the answer as
+// it stood at that time. time is Unix seconds or UTC ISO 8601; a bare date
+// means the end of that day.
+string handleAsOf(ResultManager& manager, FieldCursor& fields) {
+    string_view field, verb;
+    int64_t ms;
+    if (fields.nextText(field) != ParseError::None) {
+        return errorJSON("Missing time", ParseError::MissingField, fields.fieldIndex() + 1);
+    }
+    if (!parseTimestamp(trimView(field), ms)) return errorJSON("Invalid time", ParseError::NotANumber, fields.fieldIndex());
+    if (ms < manager.historyHorizon()) {
+        return errorJSON("Time is before the kept history", ParseError::OutOfRange, fields.fieldIndex());
+    }
+    if (fields.nextText(verb) != ParseError::None) {
+        return errorJSON("Missing command", ParseError::MissingField, fields.fieldIndex() + 1);
+    }
+    uint64_t bound = manager.seqAsOf(ms);
+    
+    verb = trimView(verb);
+    if (verb == "GET_ALL") return manager.getAllStudentsJSON(bound);
+    if (verb == "STATS") return manager.getStatsJSON(bound);
+    if (verb != "SEARCH") return errorJSON("AS_OF supports SEARCH, GET_ALL and STATS");
+    
+    string_view prn;
+    if (fields.nextText(prn) != ParseError::None) {
+        return errorJSON("Invalid command format", ParseError::MissingField, fields.fieldIndex() + 1);
+    }
+    Student s;
+    if (manager.searchStudentAsOf(string(trimView(prn)), bound, s)) return s.toJSON();
+    return errorJSON("Student not found");
+}
+
+// Resident set size of this process, 0 where /proc is not available
+size_t residentBytes() {
+    ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) return 0;
+#ifdef _WIN32
+    return 0;
+#else
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+string handleMemory(ResultManager& manager, FieldCursor&) {
+    MemoryUsage m = manager.memoryUsage();
+    size_t students = manager.studentCount();
+    stringstream ss;
+    ss << "{\"mode\":\"" << (manager.isCompact() ? "compact" : "full") << "\",\"students\":" << students
+       << ",\"bytes\":{\"index\":" << m.index << ",\"records\":" << m.records
+       << ",\"strings\":" << m.strings << ",\"courses\":" << m.courses
+       << ",\"courseDictionary\":" << m.courseDictionary << ",\"rankIndex\":" << m.rankIndex
+       << ",\"changeLog\":" << m.changeLog << ",\"tombstones\":" << m.tombstones
+       << ",\"classList\":" << m.classList << ",\"history\":" << m.history
+       << ",\"columns\":" << m.columns << ",\"courseBoards\":" << m.courseBoards << "},\"total\":" << m.total()
+       << ",\"perStudent\":" << fixed << setprecision(1)
+       << (students ? (double)m.perStudent() / students : 0.0);
+    size_t rss = residentBytes();
+    if (rss > 0) ss << ",\"rssBytes\":" << rss;
+    ss << "}";
+    return ss.str();
+}
+
+string handleClassmate(ResultManager& manager, FieldCursor& fields) {
+    string_view prn;
+    if (fields.nextText(prn) != ParseError::None) {
+        return errorJSON("Invalid command format", ParseError::MissingField, fields.fieldIndex() + 1);
+    }
+    return manager.getClassmateJSON(string(trimView(prn)));
+}
+
+string jobsUnavailableJSON() {
+    return errorJSON("Background jobs need a long-running backend (--serve or the in-process store)");
+}
+
+string readOnlyJSON() {
+    return errorJSON("Read-only follower, send writes to the primary");
+}
+
+// Job types that write files (the rest only read the store)
+bool jobWritesFiles(string_view type) {
+    return type == "RENDER" || type == "EXPORT" || type == "EXPORT_CARDS";
+}
+
+string handleJob(ResultManager& manager, FieldCursor& fields) {
+    if (!manager.runsBackgroundJobs()) return jobsUnavailableJSON();
+    string_view type;
+    if (fields.nextText(type) != ParseError::None) {
+        return errorJSON("Invalid command format", ParseError::MissingField, fields.fieldIndex() + 1);
+    }
+    if (jobWritesFiles(trimView(type)) && manager.isReadOnly()) return readOnlyJSON();
+    
+    shared_ptr<Job> job;
+    if (type == "REGRADE") {
+        GradePolicy policy;
+        string_view spec;
+        if (fields.nextText(spec) == ParseError::None && !parseGradePolicy(spec, policy)) {
+            return errorJSON("Invalid grade policy", ParseError::NotANumber, fields.fieldIndex());
+        }
+        job = manager.getJobs().submit("REGRADE", [&manager, policy](Job& j) {
+            return runRegradeJob(manager, j, policy);
+        });
+    }
+    else if (type == "COURSE_STATS") {
+        job = manager.getJobs().submit("COURSE_STATS", [&manager](Job& j) {
+            return runCourseStatsJob(manager, j);
+        });
+    }
+    else if (type == "RECONCILE") {
+        float tolerance;
+        int limit;
+        if (!parseReconcileArgs(fields, tolerance, limit)) {
+            return errorJSON("Invalid reconcile arguments", ParseError::NotANumber, fields.fieldIndex());
+        }
+        job = manager.getJobs().submit("RECONCILE", [&manager, tolerance, limit](Job& j) {
+            ReconcileReport report = manager.reconcile(tolerance, &j);
+            return reconcileJSON(report, tolerance, limit);
+        });
+    }
+    else if (type == "RENDER") {
+        string_view format, dir;
+        if (fields.nextText(format) != ParseError::None || fields.nextText(dir) != ParseError::None ||
+            trimView(dir).empty()) {
+            return errorJSON("Invalid command format", ParseError::MissingField, fields.fieldIndex() + 1);
+        }
+        string fmt(trimView(format)), target(trimView(dir));
+        if (fmt != "txt" && fmt != "html" && fmt != "pdf" && fmt != "all") {
+            return errorJSON("Unknown render format");
+        }
+        job = manager.getJobs().submit("RENDER", [&manager, fmt, target](Job& j) {
+            return runRenderJob(manager, j, fmt, target);
+        });
+    }
+    else if (type == "EXPORT") {
+        string_view path;
+        if (fields.nextText(path) != ParseError::None || trimView(path).empty()) {
+            return errorJSON("Missing export path", ParseError::MissingField, fields.fieldIndex() + 1);
+        }
+        string target(trimView(path));
+        job = manager.getJobs().submit("EXPORT", [&manager, target](Job& j) {
+            return exportColumnar(manager, target, &j);
+        });
+    }
+    else if (type == "EXPORT_CARDS") {
+        string_view path;
+        if (fields.nextText(path) != ParseError::None || trimView(path).empty()) {
+            return errorJSON("Missing export path", ParseError::MissingField, fields.fieldIndex() + 1);
+        }
+        string target(trimView(path));
+        job = manager.getJobs().submit("EXPORT_CARDS", [&manager, target](Job& j) {
+            return runExportCardsJob(manager, j, target);
+        });
+    }
+    else {
+        return errorJSON("Unknown job type");
+    }
+    
+    return JobManager::statusJSON(*job);
+}
+
+string handleJobStatus(ResultManager& manager, FieldCursor& fields) {
+    if (!manager.runsBackgroundJobs()) return jobsUnavailableJSON();
+    int id = 0;
+    ParseError err = fields.nextInt(id);
+    if (err != ParseError::None) return errorJSON("Invalid job id", err, fields.fieldIndex());
+    
+    auto job = manager.getJobs().find(id);
+    if (!job) return errorJSON("Job not found");
+    return JobManager::statusJSON(*job);
+}
+
+string handleJobCancel(ResultManager& manager, FieldCursor& fields) {
+    if (!manager.runsBackgroundJobs()) return jobsUnavailableJSON();
+    int id = 0;
+    ParseError err = fields.nextInt(id);
+    if (err != ParseError::None) return errorJSON("Invalid job id", err, fields.fieldIndex());
+    
+    auto job = manager.getJobs().cancel(id);
+    if (!job) return errorJSON("Job not found");
+    return JobManager::statusJSON(*job);
+}
+
+string handleReconcile(ResultManager& manager, FieldCursor& fields) {
+    float tolerance;
+    int limit;
+    if (!parseReconcileArgs(fields, tolerance, limit)) {
+        return errorJSON("Invalid reconcile arguments", ParseError::NotANumber, fields.fieldIndex());
+    }
+    return reconcileJSON(manager.reconcile(tolerance), tolerance, limit);
+}
+
+string handleExport(ResultManager& manager, FieldCursor& fields) {
+    string_view path;
+    if (fields.nextText(path) != ParseError::None || trimView(path).empty()) {
+        return errorJSON("Missing export path", ParseError::MissingField, fields.fieldIndex() + 1);
+    }
+    return exportColumnar(manager, string(trimView(path)));
+}
+
+// SNAPSHOT|path, default reportcards.snapshot next to the data file
+string handleSnapshot(ResultManager& manager, FieldCursor& fields) {
+    string_view path;
+    string target = filesystem::path(manager.getDataFile()).replace_extension(".snapshot").string();
+    if (fields.next(path) && !trimView(path).empty()) target = string(trimView(path));
+    return manager.writeSnapshot(target);
+}
+
+// COMPACT or COMPACT|audit, runs as a background job (inline in --web mode)
+string handleCompact(ResultManager& manager, FieldCursor& fields) {
+    string_view mode;
+    bool audit = fields.next(mode) && trimView(mode) == "audit";
+    if (!manager.runsBackgroundJobs()) return manager.compact(audit);
+    auto job = manager.getJobs().submit("COMPACT", [&manager, audit](Job& j) {
+        return manager.compact(audit, &j);
+    });
+    return JobManager::statusJSON(*job);
+}
+
+// TOP|Course|k and BOTTOM|Course|k: the k best (or worst) marks in
+// one course, normalized by its maximum; k defaults to 10
+string handleCourseBoard(ResultManager& manager, FieldCursor& fields, bool fromTop) {
+    string_view code;
+    if (fields.nextText(code) != ParseError::None || trimView(code).empty()) {
+        return errorJSON("Invalid command format", ParseError::MissingField, fields.fieldIndex() + 1);
+    }
+    int k = 10;
+    string_view field;
+    if (fields.next(field) && !trimView(field).empty()) {
+        ParseError err = parseInt(field, k);
+        if (err == ParseError::None && (k <= 0 || k > 1000)) err = ParseError::OutOfRange;
+        if (err != ParseError::None) return errorJSON("Invalid k", err, fields.fieldIndex());
+    }
+    return manager.courseBoardJSON(string(trimView(code)), (size_t)k, fromTop);
+}
+
+string handleTop(ResultManager& manager, FieldCursor& fields) {
+    return handleCourseBoard(manager, fields, true);
+}
+
+string handleBottom(ResultManager& manager, FieldCursor& fields) {
+    return handleCourseBoard(manager, fields, false);
+}
+
+// SIMULATE|ADD:code:n|SCALE:code:newMax|CAP:code:n|POLICY:a,b,c,d,e|LIMIT:n,
+// any number of adjustments (code * = every course), applied in the order
+// given; nothing is written
+string handleSimulate(ResultManager& manager, FieldCursor& fields) {
+    WhatIfSpec spec;
+    string_view field;
+    while (fields.next(field)) {
+        field = trimView(field);
+        if (field.empty()) continue;
+        if (field.substr(0, 7) == "POLICY:") {
+            if (!parseGradePolicy(field.substr(7), spec.policy)) {
+                return errorJSON("Invalid grade policy", ParseError::NotANumber, fields.fieldIndex());
+            }
+        } else if (field.substr(0, 6) == "LIMIT:") {
+            int limit = 0;
+            ParseError err = parseInt(field.substr(6), limit);
+            if (err == ParseError::None && limit < 0) err = ParseError::OutOfRange;
+            if (err != ParseError::None) return errorJSON("Invalid limit", err, fields.fieldIndex());
+            spec.limit = (size_t)limit;
+        } else {
+            MarkAdjustment adjustment;
+            if (!parseAdjustment(field, adjustment)) {
+                return errorJSON("Invalid adjustment", ParseError::NotANumber, fields.fieldIndex());
+            }
+            spec.adjustments.push_back(adjustment);
+        }
+    }
+    return runSimulation(manager, spec);
+}
+
+string handleReplication(ResultManager& manager, FieldCursor&) {
+    return manager.replicationJSON();
+}
+
+struct CommandEntry {
+    string_view verb;
+    CommandHandler handler;
+    bool changesFiles = false;   // refused on a read-only follower (JOB checks its type itself)
+};
+
+const CommandEntry commandTable[] = {
+    {"ADD", handleAdd, true},
+    {"GET_ALL", handleGetAll},
+    {"UPDATE_MARKS", handleUpdateMarks, true},
+    {"DELETE", handleDelete, true},
+    {"SEARCH", handleSearch},
+    {"RANK", handleRank},
+    {"SUBSCRIBE", handleSubscribe},
+    {"CLASSMATE", handleClassmate},
+    {"STATS", handleStats},
+    {"AS_OF", handleAsOf},
+    {"MEMORY", handleMemory},
+    {"RECONCILE", handleReconcile},
+    {"EXPORT", handleExport, true},
+    {"SNAPSHOT", handleSnapshot, true},
+    {"COMPACT", handleCompact, true},
+    {"TOP", handleTop},
+    {"BOTTOM", handleBottom},
+    {"SIMULATE", handleSimulate},
+    {"REPLICATION", handleReplication},
+    {"JOB", handleJob},
+    {"JOB_STATUS", handleJobStatus},
+    {"JOB_CANCEL", handleJobCancel},
+};
+
+string dispatchCommand(ResultManager& manager, string_view line) {
+    FieldCursor fields(trimView(line));
+    string_view verb;
+    fields.next(verb);
+    
+    for (const auto& entry : commandTable) {
+        if (entry.verb != verb) continue;
+        if (entry.changesFiles && manager.isReadOnly()) return readOnlyJSON();
+        return entry.handler(manager, fields);
+    }
+    return errorJSON("Invalid command");
+}
+
+// ==================== DATASET CATALOG ====================
+// One backend serves every batch and semester. Dataset "2024-SE/sem3" lives
+// in <catalogRoot>/2024-SE/sem3/: reportcards.txt, plus classlist.csv or
+// classlist.xlsx. A dataset is loaded on its first command. Other commands
+// for it that arrive during the load wait for that load rather than
+// starting their own. When loaded datasets are estimated (MEMORY's total)
+// above the budget, the least recently used ones that no command is using
+// are dropped, after their queued writes are flushed.
+class DatasetCatalog {
+private:
+    struct Entry {
+        shared_ptr<ResultManager> manager;   // null until loaded, and after eviction
+        bool busy = false;                   // being loaded or unloaded
+        size_t bytes = 0;
+        uint64_t lastUse = 0;
+        uint64_t loads = 0;
+        uint64_t evictions = 0;
+    };
+    
+    StoreOptions options;
+    mutex lock;
+    condition_variable settled;
+    map<string, Entry> entries;
+    uint64_t useClock = 0;
+    
+    string directoryOf(const string& key) const {
+        return options.catalogRoot + "/" + key;
+    }
+    
+    static string classListIn(const string& dir) {
+        if (!filesystem::exists(dir + "/classlist.csv") && filesystem::exists(dir + "/classlist.xlsx")) {
+            return dir + "/classlist.xlsx";
+        }
+        return dir + "/classlist.csv";
+    }
+    
+    // Shards and durability follow the process flags; an import applies to the
+    // default dataset only, and a snapshot sits in the dataset's directory
+    StoreOptions optionsFor(const string& dir) const {
+        StoreOptions o = options;
+        o.importFile.clear();
+        o.replicateAddress.clear();   // replication covers the default store only
+        o.followAddress.clear();
+        if (!o.snapshotFile.empty()) o.snapshotFile = dir + "/" + filesystem::path(o.snapshotFile).filename().string();
+        return o;
+    }
+    
+    size_t residentBytes() const {
+        size_t total = 0;
+        for (const auto& pair : entries) total += pair.second.bytes;
+        return total;
+    }
+    
+    // Picks idle datasets to drop, coldest first, until the rest fit. Sizes are
+    // re-estimated here since writes grow a dataset after it was loaded.
+    vector<string> chooseEvictions(const string& keep) {
+        vector<pair<uint64_t, string>> idle;
+        for (auto& pair : entries) {
+            Entry& e = pair.second;
+            // Only the catalog holds it: no command can be using it, and no new
+            // one can start without this lock
+            if (!e.manager || e.busy || pair.first == keep || e.manager.use_count() != 1) continue;
+            e.bytes = e.manager->memoryUsage().total();
+            idle.push_back({e.lastUse, pair.first});
+        }
+        sort(idle.begin(), idle.end());
+        
+        vector<string> victims;
+        size_t total = residentBytes();
+        for (const auto& candidate : idle) {
+            if (total <= options.datasetBudget) break;
+            Entry& e = entries[candidate.second];
+            total -= e.bytes;
+            e.busy = true;
+            victims.push_back(candidate.second);
+        }
+        return victims;
+    }
+    
+    // Flushing and freeing happen outside the lock; the entries stay busy so
+    // a command for them waits instead of loading a second copy meanwhile
+    void evict(unique_lock<mutex>& guard, const vector<string>& victims) {
+        vector<shared_ptr<ResultManager>> dropped;
+        for (const auto& key : victims) {
+            Entry& e = entries[key];
+            dropped.push_back(std::move(e.manager));
+            e.manager.reset();
+            e.bytes = 0;
+            e.evictions++;
+        }
+        guard.unlock();
+        dropped.clear();
+        guard.lock();
+        for (const auto& key : victims) entries[key].busy = false;
+        settled.notify_all();
+    }
+    
+public:
+    explicit DatasetCatalog(const StoreOptions& o) : options(o) {}
+    
+    // "batch/semester": two non-empty parts of letters, digits, '-', '_' and '.'
+    static bool validKey(string_view key) {
+        size_t slash = key.find('/');
+        if (slash == string_view::npos) return false;
+        string_view parts[2] = {key.substr(0, slash), key.substr(slash + 1)};
+        for (string_view part : parts) {
+            if (part.empty() || part == "." || part == "..") return false;
+            for (char c : part) {
+                if (!isalnum((unsigned char)c) && c != '-' && c != '_' && c != '.') return false;
+            }
+        }
+        return true;
+    }
+    
+    // The dataset's store, loading it first if needed. Null with `error` set
+    // when the key is malformed or there is no such dataset.
+    shared_ptr<ResultManager> acquire(const string& key, string& error) {
+        if (!validKey(key)) {
+            error = "Invalid dataset name";
+            return nullptr;
+        }
+        unique_lock<mutex> guard(lock);
+        settled.wait(guard, [&] { return !entries[key].busy; });
+        Entry& entry = entries[key];
+        entry.lastUse = ++useClock;
+        if (entry.manager) return entry.manager;
+        
+        string dir = directoryOf(key);
+        if (!filesystem::is_directory(dir)) {
+            if (entry.loads == 0) entries.erase(key);
+            error = "Unknown dataset";
+            return nullptr;
+        }
+        
+        entry.busy = true;
+        guard.unlock();
+        shared_ptr<ResultManager> manager;
+        size_t bytes = 0;
+        try {
+            manager = make_shared<ResultManager>(dir + "/reportcards.txt", classListIn(dir), optionsFor(dir));
+            bytes = manager->memoryUsage().total();
+        }
+        catch (const exception& e) {
+            error = "Dataset failed to load";
+        }
+        guard.lock();
+        
+        Entry& loaded = entries[key];
+        loaded.busy = false;
+        loaded.manager = manager;
+        loaded.bytes = bytes;
+        if (manager) loaded.loads++;
+        settled.notify_all();
+        
+        vector<string> victims = chooseEvictions(key);
+        if (!victims.empty()) evict(guard, victims);
+        return manager;
+    }
+    
+    // {"root":...,"budgetBytes":N,"residentBytes":N,"datasets":[...]}: every
+    // dataset directory under the root, loaded or not
+    string statusJSON() {
+        set<string> keys;
+        error_code ec;
+        for (const auto& batch : filesystem::directory_iterator(options.catalogRoot, ec)) {
+            if (!batch.is_directory()) continue;
+            for (const auto& semester : filesystem::directory_iterator(batch.path(), ec)) {
+                string key = batch.path().filename().string() + "/" + semester.path().filename().string();
+                if (semester.is_directory() && validKey(key)) keys.insert(key);
+            }
+        }
+        
+        lock_guard<mutex> guard(lock);
+        for (const auto& pair : entries) keys.insert(pair.first);
+        stringstream ss;
+        ss << "{\"root\":\"" << options.catalogRoot << "\",\"budgetBytes\":" << options.datasetBudget
+           << ",\"residentBytes\":" << residentBytes() << ",\"datasets\":[";
+        bool first = true;
+        for (const auto& key : keys) {
+            auto it = entries.find(key);
+            bool resident = it != entries.end() && it->second.manager;
+            if (!first) ss << ",";
+            first = false;
+            ss << "{\"dataset\":\"" << key << "\",\"resident\":" << (resident ? "true" : "false");
+            if (resident) {
+                ss << ",\"students\":" << it->second.manager->studentCount() << ",\"bytes\":" << it->second.bytes;
+            }
+            if (it != entries.end()) {
+                ss << ",\"loads\":" << it->second.loads << ",\"evictions\":" << it->second.evictions;
+            }
+            ss << "}";
+        }
+        ss << "]}";
+        return ss.str();
+    }
+};
+
+// DATASET|batch/semester|COMMAND|... runs COMMAND against that dataset;
+// DATASETS lists the catalog; anything else goes to the default dataset
+string routeCommand(ResultManager& manager, DatasetCatalog& catalog, string_view line) {
+    line = trimView(line);
+    if (line == "DATASETS") return catalog.statusJSON();
+    if (line.substr(0, 8) != "DATASET|") return dispatchCommand(manager, line);
+    
+    string_view rest = line.substr(8);
+    size_t bar = rest.find('|');
+    string key(trimView(rest.substr(0, bar)));
+    if (!DatasetCatalog::validKey(key)) return errorJSON("Invalid dataset name", ParseError::OutOfRange, 2);
+    if (bar == string_view::npos) return errorJSON("Missing dataset command", ParseError::MissingField, 3);
+    
+    string error;
+    shared_ptr<ResultManager> dataset = catalog.acquire(key, error);
+    if (!dataset) return errorJSON(error);
+    return dispatchCommand(*dataset, rest.substr(bar + 1));
+}
+
+// One command line to one JSON reply line; never throws
+string executeCommand(ResultManager& manager, DatasetCatalog& catalog, string_view line) {
+    try {
+        return routeCommand(manager, catalog, line);
+    }
+    catch (const exception& e) {
+        return "{\"error\":\"Data processing error\"}";
+    }
+}
+
+void handleWebRequest(ResultManager& manager, DatasetCatalog& catalog) {
+    string command;
+    getline(cin, command);
+    cout << executeCommand(manager, catalog, command) << endl;
+}
+
+// Why these options cannot be used together, empty when they can. A
+// follower writes no files and loads only what the primary sends, so it
+// refuses --import.
+string storeArgsError(const StoreOptions& options) {
+    if (!options.followAddress.empty() && !options.importFile.empty()) {
+        return "--import cannot be used with --follow: a follower starts from the primary's snapshot";
+    }
+    return "";
+}
+
+// Store flags shared by the executable and the library (--web/--serve and
+// anything unknown are ignored). Returns the class list to load.
+string parseStoreArgs(int argc, const char* const* argv, StoreOptions& options) {
+    string classList;
+    for (int i = 0; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--compact") options.compact = true;
+        else if (arg == "--durability=fsync") options.durability = DurabilityMode::Fsync;
+        else if (arg == "--durability=enqueue") options.durability = DurabilityMode::Enqueue;
+        else if (arg.rfind("--shards=", 0) == 0) {
+            int n = 0;
+            if (parseInt(string_view(arg).substr(9), n) == ParseError::None && n > 0) options.shards = n;
+        }
+        else if (arg.rfind("--import=", 0) == 0) options.importFile = arg.substr(9);
+        else if (arg.rfind("--snapshot=", 0) == 0) options.snapshotFile = arg.substr(11);
+        else if (arg.rfind("--classlist=", 0) == 0) classList = arg.substr(12);
+        else if (arg.rfind("--catalog=", 0) == 0) options.catalogRoot = arg.substr(10);
+        else if (arg.rfind("--dataset-budget=", 0) == 0) {
+            int mb = 0;
+            if (parseInt(string_view(arg).substr(17), mb) == ParseError::None && mb >= 0) options.datasetBudget = size_t(mb) << 20;
+        }
+        else if (arg == "--io=posix") options.io = IoMode::Posix;
+        else if (arg == "--io=auto") options.io = IoMode::Auto;
+        else if (arg.rfind("--replicate=", 0) == 0) options.replicateAddress = arg.substr(12);
+        else if (arg.rfind("--follow=", 0) == 0) options.followAddress = arg.substr(9);
+        else if (arg.rfind("--history-days=", 0) == 0) {
+            int days = 0;
+            if (parseInt(string_view(arg).substr(15), days) == ParseError::None && days >= 0) options.historyDays = days;
+        }
+        else if (arg.rfind("--replication-key=", 0) == 0) options.replicationKey = arg.substr(18);
+        else if (arg.rfind("--replication-log=", 0) == 0) {
+            int mb = 0;
+            if (parseInt(string_view(arg).substr(18), mb) == ParseError::None && mb > 0) options.replicationLog = size_t(mb) << 20;
+        }
+    }
+    
+    // Without --classlist, fall back to the workbook when only it was published
+    if (classList.empty()) {
+        classList = "sample_se1.csv";
+        if (!filesystem::exists(classList) && filesystem::exists("sample_se1.xlsx")) classList = "sample_se1.xlsx";
+    }
+    return classList;
+}
+
+// ==================== REPLICATION ====================
+// Log shipping over TCP for read scaling. A primary (--replicate=[host:]port)
+// first sends each follower (--follow=host:port) a snapshot of the whole
+// store. It then sends the record text of every later write, in feed order.
+// Followers apply it in memory and answer reads. They write no files.
+//
+// A frame is a type byte, a u32 body length and the body (little-endian):
+//   follower -> primary   'H' u32 protocol, u64 epoch, u64 applied position,
+//                             u32 length + replication key                  (hello)
+//                         'A' u64 applied position                          (ack)
+//   primary -> follower   'S' u64 epoch, u64 position, snapshot image        (catch-up)
+//                         'R' u64 last position, record blocks              (changes)
+//                         'B' u64 stable position, i64 clock ms, i64 commit ms of the
+//                             oldest record not yet sent, 0 = none           (heartbeat)
+// A follower whose epoch and position are still covered by the primary's log
+// resumes from the log. Any other follower gets a snapshot. A follower
+// whose key differs from the primary's --replication-key is dropped before
+// anything is sent. A bare port listens on loopback only; listening on
+// another address needs a key.
+#ifndef _WIN32
+const uint32_t REPLICATION_PROTOCOL = 2;
+const size_t REPLICATION_BATCH = 1 << 20;         // record bytes per 'R' frame
+const uint32_t REPLICATION_MAX_FRAME = 1u << 30;
+const int REPLICATION_HEARTBEAT_MS = 1000;
+const int REPLICATION_TIMEOUT_MS = 5000;          // silence before a link counts as dead
+const int REPLICATION_FIRST_SYNC_MS = 30000;      // a new follower waits this long for its snapshot
+
+// "host:port", or just "port" (127.0.0.1: listening on every interface
+// takes an explicit host such as 0.0.0.0)
+bool splitHostPort(const string& address, string& host, string& port) {
+    size_t colon = address.rfind(':');
+    host = colon == string::npos ? "127.0.0.1" : address.substr(0, colon);
+    port = colon == string::npos ? address : address.substr(colon + 1);
+    return !host.empty() && !port.empty();
+}
+
+bool isLoopbackHost(const string& host) {
+    return host == "localhost" || host == "::1" || host.rfind("127.", 0) == 0;
+}
+
+// Compares in time independent of where the keys differ
+bool sameKey(const string& a, const string& b) {
+    unsigned char diff = a.size() != b.size();
+    for (size_t i = 0; i < a.size() && i < b.size(); i++) diff |= (unsigned char)(a[i] ^ b[i]);
+    return diff == 0;
+}
+
+// connect() that gives up after timeoutMs instead of the system's minutes
+bool connectWithin(int fd, const sockaddr* to, socklen_t length, int timeoutMs) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    bool ok = connect(fd, to, length) == 0;
+    if (!ok && errno == EINPROGRESS) {
+        pollfd p = {fd, POLLOUT, 0};
+        int err = 0;
+        socklen_t errLength = sizeof(err);
+        ok = poll(&p, 1, timeoutMs) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errLength) == 0 && err == 0;
+        if (!ok && err) errno = err;
+        if (!ok && !err) errno = ETIMEDOUT;
+    }
+    fcntl(fd, F_SETFL, flags);
+    return ok;
+}
+
+// A listening or connected TCP socket, -1 on failure
+int openSocket(const string& address, bool listening, string& error) {
+    string host, port;
+    if (!splitHostPort(address, host, port)) {
+        error = "bad address";
+        return -1;
+    }
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (listening) hints.ai_flags = AI_PASSIVE;
+    addrinfo* found = nullptr;
+    int rc = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found);
+    if (rc != 0) {
+        error = gai_strerror(rc);
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo* a = found; a; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) continue;
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        int one = 1;
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (::bind(fd, a->ai_addr, a->ai_addrlen) == 0 && listen(fd, 16) == 0) break;
+        } else {
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            if (connectWithin(fd, a->ai_addr, a->ai_addrlen, 3000)) break;
+        }
+        error = strerror(errno);
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+// Sockets to a peer: no SIGPIPE when it has gone, and a send that makes no
+// progress for a while fails instead of blocking the thread for good
+void configurePeerSocket(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    timeval timeout = {REPLICATION_TIMEOUT_MS / 1000 * 2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+bool sendAll(int fd, const char* data, size_t size) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, flags);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+// The body is head followed by tail, sent without joining them
+bool sendFrame(int fd, char type, const string& head, const string& tail = string()) {
+    string header(1, type);
+    putRaw<uint32_t>(header, (uint32_t)(head.size() + tail.size()));
+    return sendAll(fd, header.data(), header.size()) && sendAll(fd, head.data(), head.size()) &&
+           sendAll(fd, tail.data(), tail.size());
+}
+
+class FrameReader {
+private:
+    int fd;
+    string buffer;
+    size_t start;
+    
+public:
+    explicit FrameReader(int socket) : fd(socket), start(0) {}
+    
+    // 1 = a frame, 0 = none complete within waitMs, -1 = closed or malformed
+    int next(char& type, string& body, int waitMs) {
+        while (true) {
+            if (buffer.size() - start >= 5) {
+                uint32_t length;
+                memcpy(&length, buffer.data() + start + 1, sizeof(length));
+                if (length > REPLICATION_MAX_FRAME) return -1;
+                if (buffer.size() - start - 5 >= length) {
+                    type = buffer[start];
+                    body.assign(buffer, start + 5, length);
+                    start += 5 + length;
+                    if (start == buffer.size()) {
+                        buffer.clear();
+                        start = 0;
+                    }
+                    return 1;
+                }
+            }
+            pollfd p = {fd, POLLIN, 0};
+            int ready = poll(&p, 1, waitMs);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready <= 0) return ready;
+            char chunk[65536];
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            if (n <= 0) return -1;
+            if (start > 0) {
+                buffer.erase(0, start);
+                start = 0;
+            }
+            buffer.append(chunk, (size_t)n);
+        }
+    }
+};
+
+// The primary side: one thread accepting followers, one thread per follower
+class ReplicationServer {
+private:
+    struct Peer {
+        int fd = -1;
+        atomic<bool> done{false};
+        thread worker;
+    };
+    
+    ResultManager& manager;
+    string key;
+    int listener;
+    atomic<bool> stopping;
+    mutex peersLock;
+    vector<unique_ptr<Peer>> peers;
+    thread acceptor;
+    
+    static void finish(Peer& peer) {
+        shutdown(peer.fd, SHUT_RDWR);   // wakes a worker blocked in send()
+        peer.worker.join();
+        close(peer.fd);
+    }
+    
+    void acceptLoop() {
+        while (!stopping) {
+            pollfd p = {listener, POLLIN, 0};
+            if (poll(&p, 1, 200) <= 0) continue;
+            sockaddr_storage from;
+            socklen_t length = sizeof(from);
+            int fd = accept(listener, (sockaddr*)&from, &length);
+            if (fd < 0) continue;
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            configurePeerSocket(fd);
+            char host[NI_MAXHOST], port[NI_MAXSERV];
+            string address = "unknown";
+            if (getnameinfo((sockaddr*)&from, length, host, sizeof(host), port, sizeof(port),
+                            NI_NUMERICHOST | NI_NUMERICSERV) == 0) {
+                address = string(host) + ":" + port;
+            }
+            
+            lock_guard<mutex> guard(peersLock);
+            for (auto it = peers.begin(); it != peers.end();) {
+                if ((*it)->done) {
+                    finish(**it);
+                    it = peers.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            auto peer = make_unique<Peer>();
+            Peer* raw = peer.get();
+            raw->fd = fd;
+            raw->worker = thread([this, raw, address] {
+                serve(raw->fd, address);
+                raw->done = true;
+            });
+            peers.push_back(std::move(peer));
+        }
+    }
+    
+    bool sendSnapshot(int fd, uint64_t& sent) {
+        string head;
+        string image = manager.replicaImage(sent);
+        putRaw<uint64_t>(head, manager.getReplication().getEpoch());
+        putRaw<uint64_t>(head, sent);
+        return sendFrame(fd, 'S', head, image);
+    }
+    
+    void serve(int fd, const string& address) {
+        ReplicationState& state = manager.getReplication();
+        FrameReader in(fd);
+        char type;
+        string body;
+        uint32_t protocol;
+        uint64_t epoch, position;
+        string peerKey;
+        if (in.next(type, body, REPLICATION_TIMEOUT_MS) != 1 || type != 'H') return;
+        ByteReader hello(body.data(), body.size());
+        if (!hello.get(protocol) || !hello.get(epoch) || !hello.get(position) || protocol != REPLICATION_PROTOCOL ||
+            !hello.getString(peerKey)) {
+            return;
+        }
+        if (!sameKey(peerKey, key)) {
+            cerr << "Replication: refused " << address << " (wrong replication key)" << endl;
+            return;
+        }
+        
+        int id = state.addPeer(address);
+        bool needSnapshot = !state.resumable(epoch, position, manager.stableSeq());
+        uint64_t sent = position;
+        int64_t lastSend = 0;
+        int got = 0;
+        while (!stopping && got >= 0) {
+            if (needSnapshot) {
+                if (!sendSnapshot(fd, sent)) break;
+                state.peerSnapshot(id);
+                needSnapshot = false;
+                lastSend = 0;
+            }
+            
+            uint64_t stable = manager.waitForChanges(sent, 200);
+            if (stable > sent) {
+                string head, records;
+                uint64_t last;
+                // Fell behind the log (or it has a gap): start over from a snapshot
+                if (!state.read(sent, stable, REPLICATION_BATCH, records, last) || last == sent) {
+                    needSnapshot = true;
+                    continue;
+                }
+                putRaw<uint64_t>(head, last);
+                if (!sendFrame(fd, 'R', head, records)) break;
+                sent = last;
+                lastSend = 0;
+            }
+            
+            int64_t now = nowMillis();
+            if (now - lastSend >= REPLICATION_HEARTBEAT_MS) {
+                string beat;
+                putRaw<uint64_t>(beat, stable);
+                putRaw<int64_t>(beat, now);
+                putRaw<int64_t>(beat, stable > sent ? manager.commitTime(sent + 1) : 0);
+                if (!sendFrame(fd, 'B', beat)) break;
+                lastSend = now;
+            }
+            
+            while ((got = in.next(type, body, 0)) == 1) {
+                ByteReader ack(body.data(), body.size());
+                uint64_t applied;
+                if (type == 'A' && ack.get(applied)) state.peerAcked(id, applied);
+            }
+        }
+        state.removePeer(id);
+        shutdown(fd, SHUT_RDWR);
+    }
+    
+public:
+    ReplicationServer(ResultManager& m, const string& address, size_t logBytes, const string& replicationKey)
+        : manager(m), key(replicationKey), listener(-1), stopping(false) {
+        string error, host, port;
+        if (splitHostPort(address, host, port) && !isLoopbackHost(host) && key.empty()) {
+            cerr << "Replication: listening on " << address << " needs --replication-key" << endl;
+            return;
+        }
+        listener = openSocket(address, true, error);
+        if (listener < 0) {
+            cerr << "Replication: cannot listen on " << address << " (" << error << ")" << endl;
+            return;
+        }
+        manager.startPrimary(address, logBytes);
+        acceptor = thread(&ReplicationServer::acceptLoop, this);
+    }
+    
+    ReplicationServer(const ReplicationServer&) = delete;
+    ReplicationServer& operator=(const ReplicationServer&) = delete;
+    
+    ~ReplicationServer() {
+        stopping = true;
+        if (acceptor.joinable()) acceptor.join();
+        for (auto& peer : peers) finish(*peer);
+        if (listener >= 0) close(listener);
+    }
+};
+
+// The follower side: one thread that connects, applies what arrives and
+// reconnects with back-off when the link drops
+class ReplicationClient {
+private:
+    ResultManager& manager;
+    string primary;
+    string key;
+    atomic<bool> stopping;
+    mutex lock;
+    condition_variable changed;
+    bool synced;    // a snapshot has been installed
+    bool serving;   // reads are being answered: keep the class list from now on
+    thread worker;
+    
+    bool install(const string& body) {
+        ByteReader r(body.data(), body.size());
+        uint64_t epoch, seq;
+        if (!r.get(epoch) || !r.get(seq)) return false;
+        lock_guard<mutex> guard(lock);
+        string error;
+        if (!manager.installReplicaImage(body.substr(r.position()), seq, !serving, error)) {
+            cerr << "Replication: snapshot from " << primary << " rejected (" << error << ")" << endl;
+            return false;
+        }
+        manager.getReplication().installed(epoch, seq);
+        synced = true;
+        changed.notify_all();
+        return true;
+    }
+    
+    void session(int fd) {
+        ReplicationState& state = manager.getReplication();
+        string hello;
+        putRaw<uint32_t>(hello, REPLICATION_PROTOCOL);
+        putRaw<uint64_t>(hello, state.getEpoch());
+        putRaw<uint64_t>(hello, state.appliedSeq());
+        putString(hello, key);
+        if (!sendFrame(fd, 'H', hello)) return;
+        state.linkUp();
+        
+        FrameReader in(fd);
+        int64_t lastFrame = nowMillis();
+        char type;
+        string body;
+        while (!stopping) {
+            int got = in.next(type, body, 200);
+            if (got < 0) return;
+            if (got == 0) {
+                if (nowMillis() - lastFrame > REPLICATION_TIMEOUT_MS) return;
+                continue;
+            }
+            lastFrame = nowMillis();
+            
+            ByteReader r(body.data(), body.size());
+            if (type == 'S') {
+                if (!install(body)) return;
+            } else if (type == 'R') {
+                uint64_t last;
+                if (!r.get(last)) return;
+                manager.applyReplicated(body.substr(r.position()));
+                state.appliedUpTo(last);
+            } else if (type == 'B') {
+                uint64_t stable;
+                int64_t clock, pendingSince;
+                if (!r.get(stable) || !r.get(clock) || !r.get(pendingSince)) return;
+                state.heartbeat(stable, clock, pendingSince);
+            } else {
+                continue;
+            }
+            string ack;
+            putRaw<uint64_t>(ack, state.appliedSeq());
+            if (!sendFrame(fd, 'A', ack)) return;
+        }
+    }
+    
+    void run() {
+        int failures = 0;
+        while (!stopping) {
+            string error;
+            int fd = openSocket(primary, false, error);
+            if (fd >= 0) {
+                configurePeerSocket(fd);
+                failures = 0;
+                session(fd);
+                close(fd);
+                manager.getReplication().linkDown();
+            } else {
+                failures++;
+            }
+            // 100 ms after a dropped link, then doubling up to 5 s while the primary is unreachable
+            unique_lock<mutex> guard(lock);
+            changed.wait_for(guard, chrono::milliseconds(min(5000, 100 << min(failures, 6))),
+                             [this] { return stopping.load(); });
+        }
+    }
+    
+public:
+    ReplicationClient(ResultManager& m, const string& address, const string& replicationKey)
+        : manager(m), primary(address), key(replicationKey), stopping(false), synced(false), serving(false) {
+        worker = thread(&ReplicationClient::run, this);
+    }
+    
+    ReplicationClient(const ReplicationClient&) = delete;
+    ReplicationClient& operator=(const ReplicationClient&) = delete;
+    
+    ~ReplicationClient() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+    
+    // Waits up to ms for the first snapshot. Reads start after this, so a
+    // class list arriving later would race with them and is not installed.
+    bool waitForSync(int ms) {
+        unique_lock<mutex> guard(lock);
+        changed.wait_for(guard, chrono::milliseconds(ms), [this] { return synced; });
+        serving = true;
+        return synced;
+    }
+};
+
+// Starts the side of replication the store flags ask for, for the default
+// store only (not catalog datasets)
+struct Replication {
+    unique_ptr<ReplicationServer> server;
+    unique_ptr<ReplicationClient> client;
+    
+    Replication(ResultManager& manager, const StoreOptions& options) {
+        if (!options.followAddress.empty()) {
+            client = make_unique<ReplicationClient>(manager, options.followAddress, options.replicationKey);
+            if (!client->waitForSync(REPLICATION_FIRST_SYNC_MS)) {
+                cerr << "Replication: no snapshot from " << options.followAddress
+                     << " yet, serving an empty store until it arrives" << endl;
+            }
+        } else if (!options.replicateAddress.empty()) {
+            server = make_unique<ReplicationServer>(manager, options.replicateAddress, options.replicationLog,
+                                                    options.replicationKey);
+        }
+    }
+};
+#else
+struct Replication {
+    Replication(ResultManager&, const StoreOptions& options) {
+        if (!options.followAddress.empty() || !options.replicateAddress.empty()) {
+            cerr << "Replication needs a POSIX system (Linux, macOS or WSL)" << endl;
+        }
+    }
+};
+#endif
+
+// ==================== C ABI ====================
+// result_core.h: the store behind an opaque handle, one command string in,
+// one JSON reply out, so callers in other languages (the Node addon) keep
+// working across changes to the C++ classes.
+extern "C" {
+
+struct rc_store {
+    ResultManager manager;
+    DatasetCatalog catalog;
+    Replication replication;
+    rc_store(const string& classList, const StoreOptions& options)
+        : manager("reportcards.txt", classList, options), catalog(options), replication(manager, options) {}
+};
+
+RESULT_CORE_API unsigned rc_abi_version(void) {
+    return RESULT_CORE_ABI_VERSION;
+}
+
+RESULT_CORE_API rc_store* rc_open(int argc, const char* const* argv) {
+    try {
+        StoreOptions options;
+        string classList = parseStoreArgs(argc, argv, options);
+        if (!storeArgsError(options).empty()) return nullptr;
+        return new rc_store(classList, options);
+    }
+    catch (const exception& e) {
+        return nullptr;
+    }
+}
+
+RESULT_CORE_API char* rc_execute(rc_store* store, const char* command, size_t length, size_t* replyLength) {
+    string reply = store ? executeCommand(store->manager, store->catalog, string_view(command, length))
+                         : string("{\"error\":\"Store not open\"}");
+    char* out = (char*)malloc(reply.size() + 1);
+    if (!out) return nullptr;
+    memcpy(out, reply.c_str(), reply.size() + 1);
+    if (replyLength) *replyLength = reply.size();
+    return out;
+}
+
+RESULT_CORE_API void rc_free(char* reply) {
+    free(reply);
+}
+
+RESULT_CORE_API void rc_close(rc_store* store) {
+    delete store;
+}
+
+}
+
+// ==================== MAIN ====================
+#ifndef RESULT_CORE_LIBRARY
+int main(int argc, char* argv[]) {
+    bool webMode = false, serveMode = false;
+    StoreOptions options;
+    string classList = parseStoreArgs(argc - 1, argv + 1, options);
+    
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--web") webMode = true;
+        else if (arg == "--serve") serveMode = true;
+    }
+    options.singleCommand = webMode;
+    string argsError = storeArgsError(options);
+    if (!argsError.empty()) {
+        cerr << argsError << endl;
+        return 1;
+    }
+    
+    ResultManager manager("reportcards.txt", classList, options);
+    DatasetCatalog catalog(options);
+    
+    // Web bridge mode - process single command from stdin
+    if (webMode) {
+        handleWebRequest(manager, catalog);
+        return 0;
+    }
+    
+    // Only long-running processes take part in replication
+    Replication replication(manager, options);
+    
+    // Long-running mode - one command per stdin line, one JSON line back
+    if (serveMode) {
+        string command;
+        while (getline(cin, command)) {
+            cout << executeCommand(manager, catalog, command) << endl;
+        }
+        return 0;
+    }
+    
+    // Regular console mode
+    cout << "\n╔════════════════════════════════════════════════╗\n";
+    cout << "║   STUDENT RESULT MANAGEMENT SYSTEM (OOP)      ║\n";
+    cout << "╚════════════════════════════════════════════════╝\n";
+    
+    int choice;
     do {
         cout << "\n1. Add New Student Result\n";
         cout << "2. Search by PRN\n";
@@ -499,7 +8129,11 @@ int main(int argc, char* argv[]) {
                     student.addCourse(c);
                 }
                 
-                manager.addStudent(student);
+                Student stored;
+                if (manager.addStudent(student, stored) != WriteResult::Ok) {
+                    cout << "\n✗ Could not save the student to disk!\n";
+                    break;
+                }
                 cout << "\n✓ Student added successfully!\n";
                 cout << "Percentage: " << fixed << setprecision(2) << student.getPercentage() << "%\n";
                 cout << "Grade: " << student.getGrade() << "\n";
@@ -511,10 +8145,10 @@ int main(int argc, char* argv[]) {
                 cout << "\nEnter PRN: ";
                 getline(cin, prn);
                 
-                Student* s = manager.searchStudent(prn);
-                if (s) {
+                Student s;
+                if (manager.searchStudent(prn, s)) {
                     cout << "\n========= STUDENT FOUND =========\n";
-                    cout << s->toJSON() << endl;
+                    cout << s.toJSON() << endl;
                 } else {
                     cout << "\n✗ Student not found!\n";
                 }
@@ -546,3 +8180,4 @@ int main(int argc, char* argv[]) {
     
     return 0;
 }
+#endif
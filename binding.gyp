@@ -0,0 +1,26 @@
+{
+  "targets": [
+    {
+      "target_name": "result_addon",
+      "sources": ["result_addon.cpp", "backend_server.cpp"],
+      "defines": ["RESULT_CORE_LIBRARY"],
+      "include_dirs": ["."],
+      "cflags_cc": ["-std=c++17", "-O2", "-pthread"],
+      "cflags_cc!": ["-fno-exceptions", "-fno-rtti", "-std=gnu++14", "-std=gnu++17"],
+      "ldflags": ["-pthread"],
+      "xcode_settings": {
+        "GCC_ENABLE_CPP_EXCEPTIONS": "YES",
+        "GCC_ENABLE_CPP_RTTI": "YES",
+        "CLANG_CXX_LANGUAGE_STANDARD": "c++17",
+        "MACOSX_DEPLOYMENT_TARGET": "10.15"
+      },
+      "msvs_settings": {
+        "VCCLCompilerTool": {
+          "ExceptionHandling": 1,
+          "RuntimeTypeInfo": "true",
+          "AdditionalOptions": ["/std:c++17", "/utf-8"]
+        }
+      }
+    }
+  ]
+}
@@ -4,7 +4,7 @@ echo Compiling C++ Backend...
 echo ========================================
 echo.
 
-g++ backend_server.cpp -o Student_Result_Management_Enhanced.exe
+g++ -std=c++17 -O2 -pthread backend_server.cpp -o Student_Result_Management_Enhanced.exe
 
 if %ERRORLEVEL% EQU 0 (
     echo.
@@ -0,0 +1,309 @@
+// I/O benchmark for the Student Result Management backend.
+//
+// Compares the record-file paths of backend_server.cpp (the FILE I/O
+// section: BlockFileReader and AppendFile, io_uring or pread/write) with the
+// iostream code they replaced, on a generated reportcards file large enough
+// to measure:
+//   read    the whole file in 1 MiB pieces, line by line, and through the
+//           record parser the loader uses
+//   append  batches of records as PersistenceWriter writes them, with and
+//           without an fsync per batch
+// Read runs are "cold" (the file's cached pages are dropped first with
+// posix_fadvise, so the data comes from the disk) and "warm" (page cache).
+// POSIX only (Linux, macOS, WSL); the io_uring rows need Linux 5.6+.
+//
+// Build:  g++ -std=c++17 -O2 -pthread io_benchmark.cpp -o io_benchmark
+// Run:    ./io_benchmark --students=300000 --batch=64 --batches=4000 --sync-batches=300 --dir=/tmp
+//
+// It compiles backend_server.cpp in (as the library, without its main) so
+// the rows measure exactly the code the backend runs.
+#ifdef _WIN32
+#error "io_benchmark uses POSIX file calls; build it on Linux, macOS or WSL"
+#endif
+
+#define RESULT_CORE_LIBRARY
+#include "backend_server.cpp"
+
+struct BenchOptions {
+    size_t students = 300000;
+    size_t batch = 64;            // records per append
+    size_t batches = 4000;        // appends without fsync
+    size_t syncBatches = 300;     // appends with an fsync each
+    string dir = ".";
+    bool keep = false;            // leave the generated files behind
+};
+
+struct BenchRow {
+    string name;
+    string backend;
+    double seconds;
+    uint64_t bytes;
+    uint64_t items;
+    const char* itemName;
+};
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Drop the file's pages from the page cache so the next read hits the disk
+void evictFromCache(const string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    fsync(fd);
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    ::close(fd);
+}
+
+// A plausible report card: 6 courses, marks around 68%
+string sampleRecord(size_t i, mt19937& rng) {
+    static const char* const codes[] = {"DSA", "OOP", "DBMS", "CN", "OS", "MATH"};
+    static const char* const names[] = {"Data Structures", "Object Oriented Programming", "Databases",
+                                        "Computer Networks", "Operating Systems", "Engineering Mathematics"};
+    normal_distribution<double> marks(68, 15);
+    ostringstream prn;
+    prn << "B24" << "CEITENME"[(i % 4) * 2] << "CEITENME"[(i % 4) * 2 + 1] << setw(5) << setfill('0') << i / 4;
+    Student s("Student " + to_string(i), prn.str());
+    for (int c = 0; c < 6; c++) {
+        int m = (int)max(0.0, min(100.0, marks(rng)));
+        s.addCourse(Course(codes[c], names[c], m, 100));
+    }
+    s.setVersion(1);
+    s.setSeq(i + 1);
+    return s.toFileRecord(1750000000000LL + (int64_t)i);
+}
+
+uint64_t generateFile(const string& path, size_t students) {
+    mt19937 rng(42);
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) throw runtime_error("Cannot create " + path);
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < students; i++) {
+        string rec = sampleRecord(i, rng);
+        bytes += fwrite(rec.data(), 1, rec.size(), f);
+    }
+    fflush(f);
+    fsync(fileno(f));
+    fclose(f);
+    return bytes;
+}
+
+// ---- read rows ----
+BenchRow readRawIostream(const string& path) {
+    auto start = chrono::steady_clock::now();
+    ifstream fin(path, ios::binary);
+    vector<char> buffer(IO_BLOCK);
+    uint64_t bytes = 0, reads = 0;
+    while (fin.read(buffer.data(), buffer.size()) || fin.gcount() > 0) {
+        bytes += (uint64_t)fin.gcount();
+        reads++;
+    }
+    return {"raw 1 MiB reads, ifstream", "iostream", secondsSince(start), bytes, reads, "reads"};
+}
+
+BenchRow readRawBlocks(const string& path, IoMode mode) {
+    auto start = chrono::steady_clock::now();
+    BlockFileReader reader(path, mode);
+    vector<char> buffer(IO_BLOCK);
+    uint64_t bytes = 0, reads = 0;
+    streamsize n;
+    while ((n = reader.sgetn(buffer.data(), (streamsize)buffer.size())) > 0) {
+        bytes += (uint64_t)n;
+        reads++;
+    }
+    return {"raw 1 MiB reads, BlockFileReader", reader.backendName(), secondsSince(start), bytes, reads, "reads"};
+}
+
+BenchRow readLines(const string& path, IoMode* mode) {
+    auto start = chrono::steady_clock::now();
+    unique_ptr<BlockFileReader> reader;
+    unique_ptr<istream> in;
+    string backend = "iostream";
+    if (mode) {
+        reader = make_unique<BlockFileReader>(path, *mode);
+        in = make_unique<istream>(reader.get());
+        backend = reader->backendName();
+    } else {
+        in = make_unique<ifstream>(path);
+    }
+    string line;
+    uint64_t lines = 0, bytes = 0;
+    while (getline(*in, line)) {
+        lines++;
+        bytes += line.size() + 1;
+    }
+    return {mode ? "getline, BlockFileReader" : "getline, ifstream", backend, secondsSince(start), bytes, lines, "lines"};
+}
+
+BenchRow readRecords(const string& path, IoMode* mode) {
+    auto start = chrono::steady_clock::now();
+    unique_ptr<BlockFileReader> reader;
+    unique_ptr<istream> in;
+    string backend = "iostream";
+    if (mode) {
+        reader = make_unique<BlockFileReader>(path, *mode);
+        in = make_unique<istream>(reader.get());
+        backend = reader->backendName();
+    } else {
+        in = make_unique<ifstream>(path);
+    }
+    uint64_t records = 0, bytes = 0;
+    forEachRecord(*in, [&](const FileRecord&, const string& raw) {
+        records++;
+        bytes += raw.size();
+    });
+    return {mode ? "forEachRecord, BlockFileReader" : "forEachRecord, ifstream", backend, secondsSince(start),
+            bytes, records, "records"};
+}
+
+// ---- append rows ----
+vector<string> makeBatches(size_t count, size_t perBatch) {
+    mt19937 rng(7);
+    vector<string> batches(count);
+    for (size_t b = 0; b < count; b++) {
+        for (size_t r = 0; r < perBatch; r++) batches[b] += sampleRecord(b * perBatch + r, rng);
+    }
+    return batches;
+}
+
+uint64_t totalBytes(const vector<string>& batches) {
+    uint64_t n = 0;
+    for (const auto& b : batches) n += b.size();
+    return n;
+}
+
+// What Student::saveToFile() did for every ADD: open, append one record, close
+BenchRow appendOfstreamPerRecord(const string& path, const vector<string>& batches) {
+    remove(path.c_str());
+    vector<string> records;
+    for (const auto& b : batches) {
+        // split the batch back into its records at the closing rule + blank line
+        size_t from = 0, end;
+        while ((end = b.find("\n\n", from)) != string::npos) {
+            records.push_back(b.substr(from, end + 2 - from));
+            from = end + 2;
+        }
+    }
+    auto start = chrono::steady_clock::now();
+    for (const auto& rec : records) {
+        ofstream fout(path, ios::app);
+        fout << rec;
+    }
+    return {"open/append/close per record, ofstream", "iostream", secondsSince(start), totalBytes(batches),
+            records.size(), "records"};
+}
+
+// The PersistenceWriter before this change: fopen("ab") / fwrite / fclose per batch
+BenchRow appendStdio(const string& path, const vector<string>& batches, size_t perBatch, bool sync) {
+    remove(path.c_str());
+    auto start = chrono::steady_clock::now();
+    for (const auto& b : batches) {
+        FILE* f = fopen(path.c_str(), "ab");
+        fwrite(b.data(), 1, b.size(), f);
+        if (sync) PersistenceWriter::syncFile(f);
+        fclose(f);
+    }
+    return {string("fopen/fwrite/fclose per batch") + (sync ? " + fsync" : ""), "stdio", secondsSince(start),
+            totalBytes(batches), batches.size() * perBatch, "records"};
+}
+
+BenchRow appendFile(const string& path, const vector<string>& batches, size_t perBatch, bool sync, IoMode mode) {
+    remove(path.c_str());
+    auto start = chrono::steady_clock::now();
+    AppendFile file(path, mode);
+    for (const auto& b : batches) {
+        if (!file.append(b, sync)) throw runtime_error("Append to " + path + " failed");
+    }
+    double seconds = secondsSince(start);
+    return {string("AppendFile per batch") + (sync ? " + fsync" : ""), file.backendName(), seconds,
+            totalBytes(batches), batches.size() * perBatch, "records"};
+}
+
+void printRow(const BenchRow& r) {
+    cout << left << setw(44) << r.name << setw(30) << r.backend << right << fixed << setprecision(3)
+         << setw(9) << r.seconds << " s" << setprecision(1) << setw(10) << (r.bytes / 1048576.0) / r.seconds
+         << " MiB/s" << setprecision(0) << setw(12) << r.items / r.seconds << " " << r.itemName << "/s" << endl;
+}
+
+bool parseBenchArgs(int argc, char** argv, BenchOptions& o) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto number = [&](size_t prefix, size_t& out) {
+            int n = 0;
+            if (parseInt(string_view(arg).substr(prefix), n) != ParseError::None || n <= 0) return false;
+            out = (size_t)n;
+            return true;
+        };
+        if (arg.rfind("--students=", 0) == 0) { if (!number(11, o.students)) return false; }
+        else if (arg.rfind("--batch=", 0) == 0) { if (!number(8, o.batch)) return false; }
+        else if (arg.rfind("--batches=", 0) == 0) { if (!number(10, o.batches)) return false; }
+        else if (arg.rfind("--sync-batches=", 0) == 0) { if (!number(15, o.syncBatches)) return false; }
+        else if (arg.rfind("--dir=", 0) == 0) o.dir = arg.substr(6);
+        else if (arg == "--keep") o.keep = true;
+        else return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions o;
+    if (!parseBenchArgs(argc, argv, o)) {
+        cerr << "Usage: io_benchmark [--students=N] [--batch=N] [--batches=N] [--sync-batches=N] [--dir=path] [--keep]"
+             << endl;
+        return 2;
+    }
+    string dataPath = o.dir + "/io_benchmark_reportcards.txt";
+    string appendPath = o.dir + "/io_benchmark_append.txt";
+
+    try {
+        cout << "Generating " << o.students << " report cards in " << dataPath << " ..." << flush;
+        uint64_t size = generateFile(dataPath, o.students);
+        cout << " " << size / 1048576 << " MiB" << endl << endl;
+
+        IoMode uring = IoMode::Auto, posix = IoMode::Posix;
+        for (bool cold : {true, false}) {
+            cout << "== read, " << (cold ? "cold (page cache dropped)" : "warm (page cache)") << " ==" << endl;
+            auto run = [&](BenchRow row) {
+                printRow(row);
+                if (cold) evictFromCache(dataPath);
+            };
+            if (cold) evictFromCache(dataPath);
+            run(readRawIostream(dataPath));
+            run(readRawBlocks(dataPath, posix));
+            run(readRawBlocks(dataPath, uring));
+            run(readLines(dataPath, nullptr));
+            run(readLines(dataPath, &posix));
+            run(readLines(dataPath, &uring));
+            run(readRecords(dataPath, nullptr));
+            run(readRecords(dataPath, &posix));
+            run(readRecords(dataPath, &uring));
+            cout << endl;
+        }
+
+        cout << "== append, " << o.batches << " batches of " << o.batch << " records ==" << endl;
+        vector<string> batches = makeBatches(o.batches, o.batch);
+        printRow(appendOfstreamPerRecord(appendPath, batches));
+        printRow(appendStdio(appendPath, batches, o.batch, false));
+        printRow(appendFile(appendPath, batches, o.batch, false, posix));
+        printRow(appendFile(appendPath, batches, o.batch, false, uring));
+        cout << endl;
+
+        cout << "== append + fsync, " << o.syncBatches << " batches of " << o.batch << " records ==" << endl;
+        batches.resize(min(batches.size(), o.syncBatches));
+        if (batches.size() < o.syncBatches) batches = makeBatches(o.syncBatches, o.batch);
+        printRow(appendStdio(appendPath, batches, o.batch, true));
+        printRow(appendFile(appendPath, batches, o.batch, true, posix));
+        printRow(appendFile(appendPath, batches, o.batch, true, uring));
+    } catch (const exception& e) {
+        cerr << endl << "io_benchmark: " << e.what() << endl;
+        return 1;
+    }
+
+    if (!o.keep) {
+        remove(dataPath.c_str());
+        remove(appendPath.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,919 @@
+// Load generator for the Student Result Management backend.
+//
+// Replays result-day traffic against the web bridge (server.js) or straight
+// against the backend's stdin protocol (--serve), so latency under load can
+// be measured before the real day. Works offline against localhost.
+// POSIX only (Linux, macOS, WSL).
+//
+// Build:  g++ -std=c++17 -O2 load_generator.cpp -o load_generator
+// Run:    ./load_generator --rate=200 --duration=60 --mix=search:80,classmate:10,all:2,add:8
+//         ./load_generator --target=stdin:./Student_Result_Management_Enhanced.exe --rate=500
+//
+// Arrivals are open-loop: every request has a scheduled time that does not
+// depend on earlier replies, and its latency is measured from that time.
+// A server that stalls therefore shows up as latency, not as a lower
+// request rate (no coordinated omission).
+#ifdef _WIN32
+#error "load_generator uses POSIX sockets and pipes; build it on Linux, macOS or WSL"
+#endif
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <string>
+#include <deque>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+using namespace std;
+using Clock = chrono::steady_clock;
+
+// ==================== OPTIONS ====================
+enum Op { OP_SEARCH, OP_CLASSMATE, OP_ALL, OP_ADD, OP_COUNT };
+const char* const OP_NAMES[OP_COUNT] = {"search", "classmate", "all", "add"};
+
+struct Options {
+    string target = "http://127.0.0.1:3000";
+    double rate = 50;                 // requests per second
+    double duration = 30;             // seconds of arrivals
+    double warmup = 0;                // seconds at the start left out of the report
+    bool poisson = true;              // exponential gaps (false: evenly spaced)
+    double mix[OP_COUNT] = {70, 20, 5, 5};
+    double zipf = 1.0;                // PRN popularity exponent, 0 = uniform
+    string csv = "sample_se1.csv";
+    int connections = 32;             // HTTP connections / pipelined stdin commands
+    double timeout = 30;              // seconds per request, and for draining at the end
+    uint64_t seed = 42;
+    string histogramFile;             // percentile distribution in HdrHistogram's text format
+};
+
+void usage() {
+    cerr << "Usage: load_generator [options]\n"
+         << "  --target=http://HOST:PORT    web bridge (default http://127.0.0.1:3000)\n"
+         << "  --target=stdin:PATH          spawn PATH --serve and pipe commands to it\n"
+         << "  --rate=N                     requests per second (default 50)\n"
+         << "  --duration=S                 seconds of traffic (default 30)\n"
+         << "  --warmup=S                   leave the first S seconds out of the report\n"
+         << "  --arrivals=poisson|uniform   gaps between requests (default poisson)\n"
+         << "  --mix=search:70,classmate:20,all:5,add:5\n"
+         << "  --zipf=S                     PRN popularity exponent (default 1.0, 0 = uniform)\n"
+         << "  --csv=PATH                   PRNs and names to draw from (default sample_se1.csv)\n"
+         << "  --connections=N              concurrent requests (default 32)\n"
+         << "  --timeout=S                  per-request timeout (default 30)\n"
+         << "  --seed=N                     random seed, same seed = same traffic (default 42)\n"
+         << "  --histogram=PATH             write the latency distribution (HdrHistogram format)\n";
+}
+
+bool parseNumber(const string& text, double& value) {
+    char* end = nullptr;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && end && *end == '\0' && value >= 0 && isfinite(value);
+}
+
+bool parseMix(const string& text, double mix[OP_COUNT]) {
+    fill(mix, mix + OP_COUNT, 0.0);
+    stringstream ss(text);
+    string item;
+    double total = 0;
+    while (getline(ss, item, ',')) {
+        size_t colon = item.find(':');
+        if (colon == string::npos) return false;
+        string name = item.substr(0, colon);
+        int op = int(find(OP_NAMES, OP_NAMES + OP_COUNT, name) - OP_NAMES);
+        double weight;
+        if (op == OP_COUNT || !parseNumber(item.substr(colon + 1), weight)) return false;
+        mix[op] = weight;
+        total += weight;
+    }
+    return total > 0;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        string name = arg.substr(0, eq);
+        string value = eq == string::npos ? "" : arg.substr(eq + 1);
+        double number = 0;
+
+        if (name == "--target") options.target = value;
+        else if (name == "--csv") options.csv = value;
+        else if (name == "--histogram") options.histogramFile = value;
+        else if (name == "--mix") {
+            if (!parseMix(value, options.mix)) return false;
+        }
+        else if (name == "--arrivals") {
+            if (value != "poisson" && value != "uniform") return false;
+            options.poisson = value == "poisson";
+        }
+        else if (!parseNumber(value, number)) return false;
+        else if (name == "--rate" && number > 0) options.rate = number;
+        else if (name == "--duration" && number > 0) options.duration = number;
+        else if (name == "--warmup") options.warmup = number;
+        else if (name == "--zipf") options.zipf = number;
+        else if (name == "--connections" && number >= 1) options.connections = int(number);
+        else if (name == "--timeout" && number > 0) options.timeout = number;
+        else if (name == "--seed") options.seed = uint64_t(number);
+        else return false;
+    }
+    return options.warmup < options.duration;
+}
+
+// ==================== LATENCY HISTOGRAM ====================
+// HdrHistogram-style log-linear buckets over microseconds: values below
+// 2048 are exact, above that each power of two is split into 1024 buckets,
+// so every recorded value is kept to 3 significant digits.
+class LatencyHistogram {
+    static constexpr int SUB_BITS = 11;
+    static constexpr uint64_t SUB_COUNT = uint64_t(1) << SUB_BITS;
+    static constexpr uint64_t HALF_COUNT = SUB_COUNT / 2;
+    static constexpr int MAX_MAGNITUDE = 30;   // up to ~2^40 us, about 12 days
+
+    vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t maxValue = 0;
+    double sum = 0, sumSquares = 0;
+
+    static size_t indexOf(uint64_t value) {
+        if (value < SUB_COUNT) return size_t(value);
+        int magnitude = 63 - __builtin_clzll(value) - (SUB_BITS - 1);
+        return size_t(SUB_COUNT + (magnitude - 1) * HALF_COUNT + ((value >> magnitude) - HALF_COUNT));
+    }
+
+    // Largest value that lands in the same bucket
+    static uint64_t highestEquivalent(size_t index) {
+        if (index < SUB_COUNT) return index;
+        uint64_t magnitude = (index - SUB_COUNT) / HALF_COUNT + 1;
+        uint64_t sub = (index - SUB_COUNT) % HALF_COUNT + HALF_COUNT;
+        return ((sub + 1) << magnitude) - 1;
+    }
+
+public:
+    LatencyHistogram() : counts(SUB_COUNT + MAX_MAGNITUDE * HALF_COUNT, 0) {}
+
+    void record(uint64_t micros) {
+        size_t index = min(indexOf(micros), counts.size() - 1);
+        counts[index]++;
+        total++;
+        maxValue = std::max(maxValue, micros);
+        sum += double(micros);
+        sumSquares += double(micros) * double(micros);
+    }
+
+    void add(const LatencyHistogram& other) {
+        for (size_t i = 0; i < counts.size(); i++) counts[i] += other.counts[i];
+        total += other.total;
+        maxValue = std::max(maxValue, other.maxValue);
+        sum += other.sum;
+        sumSquares += other.sumSquares;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maxValue; }
+    double mean() const { return total ? sum / double(total) : 0.0; }
+
+    double stdDeviation() const {
+        if (total == 0) return 0.0;
+        double m = mean();
+        return sqrt(std::max(0.0, sumSquares / double(total) - m * m));
+    }
+
+    uint64_t valueAtPercentile(double percentile) const {
+        if (total == 0) return 0;
+        uint64_t wanted = std::max<uint64_t>(1, uint64_t(ceil(percentile / 100.0 * double(total))));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            seen += counts[i];
+            if (seen >= wanted) return std::min(highestEquivalent(i), maxValue);
+        }
+        return maxValue;
+    }
+
+    uint64_t countAtOrBelow(uint64_t value) const {
+        uint64_t seen = 0;
+        size_t last = std::min(indexOf(value), counts.size() - 1);
+        for (size_t i = 0; i <= last; i++) seen += counts[i];
+        return seen;
+    }
+
+    // Same layout as HdrHistogram's outputPercentileDistribution (values in
+    // milliseconds), so the file can go straight into its plotter
+    void writePercentiles(ostream& out) const {
+        out << "       Value     Percentile TotalCount 1/(1-Percentile)\n\n";
+        out << fixed;
+        const int ticksPerHalf = 5;
+        double percentile = 0;
+        while (total > 0) {
+            uint64_t value = valueAtPercentile(percentile);
+            uint64_t below = countAtOrBelow(value);
+            double reached = double(below) / double(total);
+            out << setw(12) << setprecision(3) << value / 1000.0 << " "
+                << setw(14) << setprecision(12) << reached << " "
+                << setw(10) << below;
+            if (below < total) out << " " << setw(14) << setprecision(2) << 1.0 / (1.0 - reached);
+            out << "\n";
+            if (below >= total) break;
+            // Halve the remaining distance each level, ticksPerHalf steps per level
+            double halfDistance = pow(2.0, floor(log2(100.0 / (100.0 - percentile))) + 1);
+            percentile = std::max(percentile + 100.0 / (halfDistance * ticksPerHalf), reached * 100.0);
+            if (percentile >= 100.0) percentile = 100.0;
+        }
+        out << setprecision(3)
+            << "#[Mean    = " << setw(12) << mean() / 1000.0
+            << ", StdDeviation   = " << setw(12) << stdDeviation() / 1000.0 << "]\n"
+            << "#[Max     = " << setw(12) << maxValue / 1000.0
+            << ", Total count    = " << setw(12) << total << "]\n"
+            << "#[Buckets = " << setw(12) << MAX_MAGNITUDE + 1
+            << ", SubBuckets     = " << setw(12) << SUB_COUNT << "]\n";
+    }
+};
+
+// ==================== REPORT ====================
+struct OpStats {
+    LatencyHistogram latency;
+    map<string, uint64_t> outcomes;   // HTTP status, "ok"/"error" on stdin, or a failure kind
+};
+
+class Report {
+    OpStats ops[OP_COUNT];
+    Clock::time_point measureFrom;
+
+public:
+    uint64_t scheduled = 0;
+    uint64_t finished = 0;
+    size_t peakBacklog = 0;
+
+    explicit Report(Clock::time_point from) : measureFrom(from) {}
+
+    // Requests scheduled during the warmup are not counted
+    void record(Op op, Clock::time_point due, Clock::time_point done, const string& outcome) {
+        finished++;
+        if (due < measureFrom) return;
+        ops[op].latency.record(uint64_t(chrono::duration_cast<chrono::microseconds>(done - due).count()));
+        ops[op].outcomes[outcome]++;
+    }
+
+    void print(ostream& out, double measuredSeconds) const {
+        LatencyHistogram all;
+        map<string, uint64_t> outcomes;
+        for (const auto& s : ops) {
+            all.add(s.latency);
+            for (const auto& [name, n] : s.outcomes) outcomes[name] += n;
+        }
+
+        out << "\nMeasured " << all.count() << " requests over " << fixed << setprecision(1)
+            << measuredSeconds << "s (" << all.count() / measuredSeconds << " req/s), peak backlog "
+            << peakBacklog << "\n\n";
+        out << left << setw(10) << "op" << right << setw(9) << "count"
+            << setw(10) << "p50" << setw(10) << "p90" << setw(10) << "p99"
+            << setw(10) << "p99.9" << setw(10) << "max" << "  outcomes (latency in ms)\n";
+        for (int op = 0; op <= OP_COUNT; op++) {
+            const LatencyHistogram& h = op < OP_COUNT ? ops[op].latency : all;
+            const map<string, uint64_t>& o = op < OP_COUNT ? ops[op].outcomes : outcomes;
+            if (h.count() == 0) continue;
+            out << left << setw(10) << (op < OP_COUNT ? OP_NAMES[op] : "total") << right << setw(9) << h.count();
+            for (double p : {50.0, 90.0, 99.0, 99.9}) out << setw(10) << setprecision(2) << h.valueAtPercentile(p) / 1000.0;
+            out << setw(10) << h.max() / 1000.0 << " ";
+            for (const auto& [name, n] : o) out << " " << name << ":" << n;
+            out << "\n";
+        }
+    }
+
+    bool writeHistogram(const string& path) const {
+        LatencyHistogram all;
+        for (const auto& s : ops) all.add(s.latency);
+        ofstream file(path);
+        if (!file) return false;
+        all.writePercentiles(file);
+        return bool(file);
+    }
+};
+
+// ==================== TRAFFIC MODEL ====================
+struct CsvStudent {
+    string prn;
+    string name;
+};
+
+string trim(const string& s) {
+    size_t start = s.find_first_not_of(" \t\r\n\"");
+    if (start == string::npos) return "";
+    size_t end = s.find_last_not_of(" \t\r\n\"");
+    return s.substr(start, end - start + 1);
+}
+
+// PRN and name from every row of the class list (first line is the header)
+vector<CsvStudent> loadStudents(const string& path) {
+    vector<CsvStudent> students;
+    ifstream file(path);
+    string line;
+    getline(file, line);
+    while (getline(file, line)) {
+        stringstream ss(line);
+        string prn, name;
+        getline(ss, prn, ',');
+        getline(ss, name, ',');
+        prn = trim(prn);
+        if (!prn.empty()) students.push_back({prn, trim(name)});
+    }
+    return students;
+}
+
+// Rank k (0-based) is drawn with probability proportional to 1/(k+1)^s
+class ZipfSampler {
+    vector<double> cdf;
+
+public:
+    ZipfSampler(size_t n, double s) {
+        cdf.reserve(n);
+        double sum = 0;
+        for (size_t k = 1; k <= n; k++) {
+            sum += 1.0 / pow(double(k), s);
+            cdf.push_back(sum);
+        }
+    }
+
+    size_t operator()(mt19937_64& rng) const {
+        double u = uniform_real_distribution<double>(0.0, cdf.back())(rng);
+        size_t k = size_t(lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+        return min(k, cdf.size() - 1);
+    }
+};
+
+struct Request {
+    Op op;
+    string payload;   // HTTP request bytes, or one stdin command line
+    Clock::time_point due;
+    Clock::time_point sent;
+};
+
+string jsonEscape(const string& s) {
+    string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) out += c;
+    }
+    return out;
+}
+
+string urlEncode(const string& s) {
+    static const char hex[] = "0123456789ABCDEF";
+    string out;
+    for (unsigned char c : s) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') out += char(c);
+        else {
+            out += '%';
+            out += hex[c >> 4];
+            out += hex[c & 15];
+        }
+    }
+    return out;
+}
+
+class TrafficModel {
+    vector<CsvStudent> students;   // shuffled: popularity is not tied to roll number
+    ZipfSampler popularity;
+    discrete_distribution<int> mix;
+    mt19937_64 rng;
+    exponential_distribution<double> gaps;
+    bool poisson;
+    double rate;
+    bool http;
+    string host;
+
+    string httpRequest(const string& method, const string& path, const string& body) const {
+        string request = method + " " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: keep-alive\r\n";
+        if (!body.empty()) {
+            request += "Content-Type: application/json\r\nContent-Length: " + to_string(body.size()) + "\r\n";
+        }
+        return request + "\r\n" + body;
+    }
+
+public:
+    TrafficModel(vector<CsvStudent> list, const Options& options, bool httpTarget, const string& hostHeader)
+        : students(move(list)), popularity(students.size(), options.zipf),
+          mix(options.mix, options.mix + OP_COUNT), rng(options.seed), gaps(options.rate),
+          poisson(options.poisson), rate(options.rate), http(httpTarget), host(hostHeader) {
+        shuffle(students.begin(), students.end(), rng);
+    }
+
+    Clock::duration nextGap() {
+        double seconds = poisson ? gaps(rng) : 1.0 / rate;
+        return chrono::duration_cast<Clock::duration>(chrono::duration<double>(seconds));
+    }
+
+    Request make(Clock::time_point due) {
+        Op op = Op(mix(rng));
+        const CsvStudent& student = students[popularity(rng)];
+        Request r{op, "", due, due};
+
+        switch (op) {
+            case OP_SEARCH:
+                r.payload = http ? httpRequest("GET", "/api/search-student/" + urlEncode(student.prn), "")
+                                 : "SEARCH|" + student.prn;
+                break;
+            case OP_CLASSMATE:
+                r.payload = http ? httpRequest("GET", "/api/search-classmate/" + urlEncode(student.prn), "")
+                                 : "CLASSMATE|" + student.prn;
+                break;
+            case OP_ALL:
+                r.payload = http ? httpRequest("GET", "/api/all-students", "") : "GET_ALL";
+                break;
+            default: {
+                // A re-entered report card: three courses with fresh marks
+                uniform_int_distribution<int> marks(35, 100);
+                string command = "ADD|" + student.prn + "|" + student.name + "|3";
+                string courses;
+                for (int c = 1; c <= 3; c++) {
+                    int m = marks(rng);
+                    string code = "LT10" + to_string(c), name = "Load Test " + to_string(c);
+                    command += "|" + code + "|" + name + "|" + to_string(m) + "|100";
+                    courses += string(c > 1 ? "," : "") + "{\"code\":\"" + code + "\",\"name\":\"" + name +
+                               "\",\"marks\":" + to_string(m) + ",\"maxMarks\":100}";
+                }
+                r.payload = http ? httpRequest("POST", "/api/add-student",
+                                               "{\"prn\":\"" + jsonEscape(student.prn) + "\",\"name\":\"" +
+                                               jsonEscape(student.name) + "\",\"courses\":[" + courses + "]}")
+                                 : command;
+                break;
+            }
+        }
+        return r;
+    }
+};
+
+// ==================== DRIVERS ====================
+// A driver takes requests off the backlog as it has capacity, waits up to
+// waitMs for I/O and records every request it finishes.
+class Driver {
+public:
+    virtual ~Driver() {}
+    virtual void step(deque<Request>& backlog, int waitMs, Report& report) = 0;
+    virtual size_t inFlight() const = 0;
+    // Give up on whatever is still running (end of the drain period)
+    virtual void abandon(Report& report) = 0;
+};
+
+// Returns true once buf holds a whole response; length is its size in bytes
+bool parseHttpResponse(const string& buf, bool eof, int& status, size_t& length, bool& keepAlive) {
+    size_t headerEnd = buf.find("\r\n\r\n");
+    if (headerEnd == string::npos) return false;
+    if (buf.compare(0, 5, "HTTP/") != 0) {
+        status = 0;
+        length = buf.size();
+        keepAlive = false;
+        return true;
+    }
+    status = atoi(buf.c_str() + buf.find(' ') + 1);
+    keepAlive = buf.compare(5, 3, "1.1") == 0;
+    long contentLength = -1;
+    bool chunked = false;
+
+    for (size_t pos = buf.find("\r\n") + 2; pos < headerEnd;) {
+        size_t eol = buf.find("\r\n", pos);
+        string line = buf.substr(pos, eol - pos);
+        pos = eol + 2;
+        transform(line.begin(), line.end(), line.begin(), [](unsigned char c) { return char(tolower(c)); });
+        if (line.rfind("content-length:", 0) == 0) contentLength = atol(line.c_str() + 15);
+        else if (line.rfind("transfer-encoding:", 0) == 0 && line.find("chunked") != string::npos) chunked = true;
+        else if (line.rfind("connection:", 0) == 0) {
+            if (line.find("close") != string::npos) keepAlive = false;
+            else if (line.find("keep-alive") != string::npos) keepAlive = true;
+        }
+    }
+
+    size_t body = headerEnd + 4;
+    if (status == 204 || status == 304 || (status >= 100 && status < 200)) {
+        length = body;
+        return true;
+    }
+    if (chunked) {
+        for (size_t pos = body;;) {
+            size_t eol = buf.find("\r\n", pos);
+            if (eol == string::npos) return false;
+            size_t size = strtoul(buf.c_str() + pos, nullptr, 16);
+            pos = eol + 2;
+            if (size == 0) {
+                size_t end = buf.compare(pos, 2, "\r\n") == 0 ? pos : buf.find("\r\n\r\n", pos);
+                if (end == string::npos) return false;
+                length = end + (end == pos ? 2 : 4);
+                return true;
+            }
+            if (buf.size() < pos + size + 2) return false;
+            pos += size + 2;
+        }
+    }
+    if (contentLength >= 0) {
+        if (buf.size() < body + size_t(contentLength)) return false;
+        length = body + size_t(contentLength);
+        return true;
+    }
+    // No length: the body runs to the end of the connection
+    keepAlive = false;
+    if (!eof) return false;
+    length = buf.size();
+    return true;
+}
+
+class HttpDriver : public Driver {
+    struct Connection {
+        int fd = -1;
+        bool connected = false;
+        bool busy = false;
+        bool reused = false;     // has answered a request before
+        Request request;
+        size_t written = 0;
+        string in;
+    };
+
+    sockaddr_storage address{};
+    socklen_t addressLength = 0;
+    size_t maxConnections;
+    chrono::duration<double> timeout;
+    vector<unique_ptr<Connection>> connections;
+
+    void close(Connection& c) {
+        if (c.fd >= 0) ::close(c.fd);
+        c.fd = -1;
+        c.busy = false;
+    }
+
+    void fail(Connection& c, const string& outcome, Report& report) {
+        report.record(c.request.op, c.request.due, Clock::now(), outcome);
+        close(c);
+    }
+
+    bool open(Connection& c) {
+        c.fd = socket(address.ss_family, SOCK_STREAM, 0);
+        if (c.fd < 0) return false;
+        fcntl(c.fd, F_SETFL, fcntl(c.fd, F_GETFL) | O_NONBLOCK);
+        int one = 1;
+        setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(c.fd, reinterpret_cast<sockaddr*>(&address), addressLength) < 0 && errno != EINPROGRESS) {
+            ::close(c.fd);
+            c.fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    void assign(Connection& c, Request request) {
+        c.request = move(request);
+        c.request.sent = Clock::now();
+        c.written = 0;
+        c.busy = true;
+    }
+
+    void onWritable(Connection& c, Report& report) {
+        if (!c.connected) {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &error, &len);
+            if (error != 0) {
+                fail(c, "connect-error", report);
+                return;
+            }
+            c.connected = true;
+        }
+        const string& out = c.request.payload;
+        ssize_t n = send(c.fd, out.data() + c.written, out.size() - c.written, MSG_NOSIGNAL);
+        if (n > 0) c.written += size_t(n);
+        else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) fail(c, "io-error", report);
+    }
+
+    void onReadable(Connection& c, deque<Request>& backlog, Report& report) {
+        char buffer[65536];
+        bool eof = false;
+        for (;;) {
+            ssize_t n = recv(c.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                c.in.append(buffer, size_t(n));
+                if (size_t(n) < sizeof(buffer)) break;
+            } else {
+                if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) eof = true;
+                break;
+            }
+        }
+
+        if (!c.busy) {
+            close(c);   // server closed an idle keep-alive connection
+            return;
+        }
+        int status = 0;
+        size_t length = 0;
+        bool keepAlive = false;
+        if (parseHttpResponse(c.in, eof, status, length, keepAlive)) {
+            report.record(c.request.op, c.request.due, Clock::now(), to_string(status));
+            c.in.erase(0, length);
+            c.busy = false;
+            c.reused = true;
+            if (!keepAlive || eof) close(c);
+        } else if (eof) {
+            // A reused connection the server had just timed out: send again
+            if (c.reused && c.in.empty()) {
+                backlog.push_front(move(c.request));
+                close(c);
+            } else {
+                fail(c, "io-error", report);
+            }
+        }
+    }
+
+public:
+    HttpDriver(const string& host, const string& port, int connectionLimit, double timeoutSeconds)
+        : maxConnections(size_t(connectionLimit)), timeout(timeoutSeconds) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        int rc = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+        if (rc != 0 || !result) throw runtime_error("Cannot resolve " + host + ": " + gai_strerror(rc));
+        memcpy(&address, result->ai_addr, result->ai_addrlen);
+        addressLength = result->ai_addrlen;
+        freeaddrinfo(result);
+    }
+
+    ~HttpDriver() override {
+        for (auto& c : connections) close(*c);
+    }
+
+    void step(deque<Request>& backlog, int waitMs, Report& report) override {
+        Clock::time_point now = Clock::now();
+
+        // Idle connections first, then new ones up to the limit
+        for (auto& c : connections) {
+            if (backlog.empty()) break;
+            if (c->fd >= 0 && !c->busy) {
+                assign(*c, move(backlog.front()));
+                backlog.pop_front();
+            }
+        }
+        while (!backlog.empty() && connections.size() < maxConnections) {
+            auto c = make_unique<Connection>();
+            if (!open(*c)) {
+                report.record(backlog.front().op, backlog.front().due, now, "connect-error");
+                backlog.pop_front();
+                continue;
+            }
+            assign(*c, move(backlog.front()));
+            backlog.pop_front();
+            connections.push_back(move(c));
+        }
+
+        for (auto& c : connections) {
+            if (c->busy && now - c->request.sent > timeout) fail(*c, "timeout", report);
+        }
+
+        vector<pollfd> fds;
+        vector<Connection*> owners;
+        for (auto& c : connections) {
+            if (c->fd < 0) continue;
+            short events = POLLIN;
+            if (c->busy && (!c->connected || c->written < c->request.payload.size())) events = POLLOUT;
+            fds.push_back({c->fd, events, 0});
+            owners.push_back(c.get());
+        }
+        if (poll(fds.data(), nfds_t(fds.size()), waitMs) > 0) {
+            for (size_t i = 0; i < fds.size(); i++) {
+                Connection& c = *owners[i];
+                if (fds[i].revents & POLLOUT) onWritable(c, report);
+                else if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                    if (!c.connected && c.busy) onWritable(c, report);   // failed connect
+                    else onReadable(c, backlog, report);
+                }
+            }
+        }
+
+        connections.erase(remove_if(connections.begin(), connections.end(),
+                                    [](const unique_ptr<Connection>& c) { return c->fd < 0; }),
+                          connections.end());
+    }
+
+    size_t inFlight() const override {
+        return size_t(count_if(connections.begin(), connections.end(),
+                               [](const unique_ptr<Connection>& c) { return c->busy; }));
+    }
+
+    void abandon(Report& report) override {
+        for (auto& c : connections) {
+            if (c->busy) fail(*c, "timeout", report);
+        }
+    }
+};
+
+// Runs one backend in --serve mode and pipelines commands to it: replies
+// come back one line each, in order
+class StdinDriver : public Driver {
+    pid_t pid = -1;
+    int toChild = -1, fromChild = -1;
+    size_t maxInFlight;
+    string out;
+    size_t written = 0;
+    string in;
+    deque<Request> waiting;   // sent, reply not read yet
+
+    void closeChild(Report* report) {
+        if (toChild >= 0) ::close(toChild);
+        if (fromChild >= 0) ::close(fromChild);
+        toChild = fromChild = -1;
+        if (report) {
+            for (const Request& r : waiting) report->record(r.op, r.due, Clock::now(), "io-error");
+        }
+        waiting.clear();
+    }
+
+public:
+    StdinDriver(const string& executable, int pipelineDepth) : maxInFlight(size_t(pipelineDepth)) {
+        int input[2], output[2];
+        if (pipe(input) < 0 || pipe(output) < 0) throw runtime_error("pipe failed");
+        pid = fork();
+        if (pid < 0) throw runtime_error("fork failed");
+        if (pid == 0) {
+            dup2(input[0], STDIN_FILENO);
+            dup2(output[1], STDOUT_FILENO);
+            ::close(input[0]); ::close(input[1]);
+            ::close(output[0]); ::close(output[1]);
+            execl(executable.c_str(), executable.c_str(), "--serve", static_cast<char*>(nullptr));
+            _exit(127);
+        }
+        ::close(input[0]);
+        ::close(output[1]);
+        toChild = input[1];
+        fromChild = output[0];
+        fcntl(toChild, F_SETFL, fcntl(toChild, F_GETFL) | O_NONBLOCK);
+        fcntl(fromChild, F_SETFL, fcntl(fromChild, F_GETFL) | O_NONBLOCK);
+    }
+
+    ~StdinDriver() override {
+        closeChild(nullptr);
+        if (pid > 0) waitpid(pid, nullptr, 0);
+    }
+
+    void step(deque<Request>& backlog, int waitMs, Report& report) override {
+        if (fromChild < 0) {
+            // The backend is gone: everything left fails at once
+            Clock::time_point now = Clock::now();
+            for (const Request& r : backlog) report.record(r.op, r.due, now, "io-error");
+            backlog.clear();
+            return;
+        }
+
+        Clock::time_point now = Clock::now();
+        while (!backlog.empty() && waiting.size() < maxInFlight) {
+            Request r = move(backlog.front());
+            backlog.pop_front();
+            r.sent = now;
+            out += r.payload;
+            out += '\n';
+            r.payload.clear();
+            waiting.push_back(move(r));
+        }
+
+        pollfd fds[2] = {{fromChild, POLLIN, 0}, {toChild, short(written < out.size() ? POLLOUT : 0), 0}};
+        if (poll(fds, 2, waitMs) <= 0) return;
+
+        if (fds[1].revents & (POLLOUT | POLLERR)) {
+            ssize_t n = write(toChild, out.data() + written, out.size() - written);
+            if (n > 0) written += size_t(n);
+            if (written == out.size()) {
+                out.clear();
+                written = 0;
+            }
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            char buffer[65536];
+            ssize_t n = read(fromChild, buffer, sizeof(buffer));
+            if (n <= 0 && !(n < 0 && errno == EAGAIN)) {
+                closeChild(&report);
+                return;
+            }
+            size_t scanned = in.size();
+            in.append(buffer, size_t(max<ssize_t>(n, 0)));
+            size_t start = 0;
+            for (size_t eol = in.find('\n', scanned); eol != string::npos; eol = in.find('\n', start)) {
+                if (!waiting.empty()) {
+                    bool error = in.compare(start, 9, "{\"error\":") == 0;
+                    report.record(waiting.front().op, waiting.front().due, Clock::now(), error ? "error" : "ok");
+                    waiting.pop_front();
+                }
+                start = eol + 1;
+            }
+            in.erase(0, start);
+        }
+    }
+
+    size_t inFlight() const override { return waiting.size(); }
+
+    void abandon(Report& report) override {
+        Clock::time_point now = Clock::now();
+        for (const Request& r : waiting) report.record(r.op, r.due, now, "timeout");
+        waiting.clear();
+        closeChild(nullptr);
+        if (pid > 0) kill(pid, SIGTERM);
+    }
+};
+
+// ==================== MAIN ====================
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    vector<CsvStudent> students = loadStudents(options.csv);
+    if (students.empty()) {
+        cerr << "No students in " << options.csv << "\n";
+        return 1;
+    }
+
+    unique_ptr<Driver> driver;
+    bool http = options.target.rfind("http://", 0) == 0;
+    string hostHeader;
+    try {
+        if (http) {
+            hostHeader = options.target.substr(7);
+            hostHeader = hostHeader.substr(0, hostHeader.find('/'));
+            size_t colon = hostHeader.rfind(':');
+            string host = colon == string::npos ? hostHeader : hostHeader.substr(0, colon);
+            string port = colon == string::npos ? "80" : hostHeader.substr(colon + 1);
+            driver = make_unique<HttpDriver>(host, port, options.connections, options.timeout);
+        } else if (options.target.rfind("stdin:", 0) == 0) {
+            driver = make_unique<StdinDriver>(options.target.substr(6), options.connections);
+        } else {
+            usage();
+            return 2;
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+
+    TrafficModel traffic(move(students), options, http, hostHeader);
+    auto seconds = [](double s) { return chrono::duration_cast<Clock::duration>(chrono::duration<double>(s)); };
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + seconds(options.duration);
+    Clock::time_point drainDeadline = end + seconds(options.timeout);
+    Clock::time_point nextArrival = start;
+    Clock::time_point nextProgress = start + chrono::seconds(1);
+    Report report(start + seconds(options.warmup));
+    deque<Request> backlog;
+
+    cerr << "Sending " << options.rate << " req/s for " << options.duration << "s to " << options.target << "\n";
+    for (;;) {
+        Clock::time_point now = Clock::now();
+        while (nextArrival < end && nextArrival <= now) {
+            backlog.push_back(traffic.make(nextArrival));
+            report.scheduled++;
+            nextArrival += traffic.nextGap();
+        }
+        report.peakBacklog = max(report.peakBacklog, backlog.size());
+
+        bool generating = nextArrival < end;
+        if (!generating && backlog.empty() && driver->inFlight() == 0) break;
+        if (!generating && now >= drainDeadline) break;
+
+        if (now >= nextProgress) {
+            cerr << "[" << setw(4) << chrono::duration_cast<chrono::seconds>(now - start).count() << "s] scheduled "
+                 << report.scheduled << ", done " << report.finished << ", in flight " << driver->inFlight()
+                 << ", backlog " << backlog.size() << "\n";
+            nextProgress += chrono::seconds(1);
+        }
+
+        int waitMs = 50;
+        if (generating) {
+            waitMs = int(chrono::duration_cast<chrono::milliseconds>(nextArrival - now).count());
+            waitMs = max(0, min(waitMs, 50));
+        }
+        driver->step(backlog, waitMs, report);
+    }
+
+    driver->abandon(report);
+    if (!backlog.empty()) cerr << backlog.size() << " requests were never sent\n";
+    report.print(cout, options.duration - options.warmup);
+
+    if (!options.histogramFile.empty() && !report.writeHistogram(options.histogramFile)) {
+        cerr << "Cannot write " << options.histogramFile << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,272 @@
+// ==================== NODE ADDON: result_addon ====================
+// Loads the result store into the Node process through result_core.h, so
+// server.js runs commands without starting a backend process for each one.
+// Build with `npm run build:addon` (node-gyp, see binding.gyp).
+//
+//   const core = require('./build/Release/result_addon.node');
+//   const store = core.open(['--compact']);        // store flags, as on the command line
+//   core.execute(store, 'SEARCH|B24CE1001');       // Buffer with the JSON reply, runs inline
+//   await core.executeAsync(store, 'GET_ALL');     // same, on a libuv worker thread
+//   core.close(store);                             // flush queued writes and free the store
+//
+// Replies are the backend's JSON bytes in a Buffer that points at the
+// library's own allocation, so nothing is copied or parsed on the way to
+// the HTTP response.
+#include <node_api.h>
+#include <string>
+#include <vector>
+#include "result_core.h"
+using namespace std;
+
+// ==================== HELPERS ====================
+#define NAPI_CALL(env, call)                                              \
+    do {                                                                  \
+        if ((call) != napi_ok) {                                          \
+            const napi_extended_error_info* info = nullptr;               \
+            napi_get_last_error_info((env), &info);                       \
+            bool pending = false;                                         \
+            napi_is_exception_pending((env), &pending);                   \
+            if (!pending) {                                               \
+                napi_throw_error((env), nullptr,                          \
+                    info && info->error_message ? info->error_message     \
+                                                : "N-API call failed");   \
+            }                                                             \
+            return nullptr;                                               \
+        }                                                                 \
+    } while (0)
+
+// The JS handle for a store; `store` is cleared by close()
+struct StoreHandle {
+    rc_store* store = nullptr;
+    int running = 0;      // async commands still using the store
+    bool closing = false; // close() called while commands were running
+};
+
+void finalizeHandle(napi_env, void* data, void*) {
+    StoreHandle* handle = static_cast<StoreHandle*>(data);
+    rc_close(handle->store);
+    delete handle;
+}
+
+void freeReply(napi_env, void* data, void*) {
+    rc_free(static_cast<char*>(data));
+}
+
+bool readString(napi_env env, napi_value value, string& out) {
+    size_t length = 0;
+    if (napi_get_value_string_utf8(env, value, nullptr, 0, &length) != napi_ok) return false;
+    out.resize(length);
+    return napi_get_value_string_utf8(env, value, &out[0], length + 1, &length) == napi_ok;
+}
+
+StoreHandle* unwrapHandle(napi_env env, napi_value value) {
+    void* data = nullptr;
+    if (napi_get_value_external(env, value, &data) != napi_ok || !data) {
+        napi_throw_type_error(env, nullptr, "Expected a store from open()");
+        return nullptr;
+    }
+    StoreHandle* handle = static_cast<StoreHandle*>(data);
+    if (!handle->store || handle->closing) {
+        napi_throw_error(env, nullptr, "Store is closed");
+        return nullptr;
+    }
+    return handle;
+}
+
+// Hands a reply to JS without copying; the Buffer frees it when collected
+napi_value replyBuffer(napi_env env, char* reply, size_t length) {
+    if (!reply) {
+        napi_throw_error(env, nullptr, "Out of memory");
+        return nullptr;
+    }
+    napi_value buffer;
+    if (napi_create_external_buffer(env, length, reply, freeReply, nullptr, &buffer) != napi_ok) {
+        // Runtimes without external buffers (e.g. sandboxed Electron) get a copy
+        void* copy = nullptr;
+        napi_status status = napi_create_buffer_copy(env, length, reply, &copy, &buffer);
+        rc_free(reply);
+        NAPI_CALL(env, status);
+    }
+    return buffer;
+}
+
+// ==================== open / close ====================
+napi_value Open(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    vector<string> flags;
+    bool isArray = false;
+    if (argc > 0) NAPI_CALL(env, napi_is_array(env, args[0], &isArray));
+    if (isArray) {
+        uint32_t count = 0;
+        NAPI_CALL(env, napi_get_array_length(env, args[0], &count));
+        for (uint32_t i = 0; i < count; i++) {
+            napi_value item;
+            string flag;
+            NAPI_CALL(env, napi_get_element(env, args[0], i, &item));
+            if (!readString(env, item, flag)) {
+                napi_throw_type_error(env, nullptr, "Store flags must be strings");
+                return nullptr;
+            }
+            flags.push_back(flag);
+        }
+    }
+    vector<const char*> argv;
+    for (const auto& flag : flags) argv.push_back(flag.c_str());
+
+    if (rc_abi_version() != RESULT_CORE_ABI_VERSION) {
+        napi_throw_error(env, nullptr, "result_core ABI mismatch, rebuild the addon");
+        return nullptr;
+    }
+    StoreHandle* handle = new StoreHandle();
+    handle->store = rc_open((int)argv.size(), argv.data());
+    if (!handle->store) {
+        delete handle;
+        napi_throw_error(env, nullptr, "Could not load the result store");
+        return nullptr;
+    }
+    napi_value external;
+    if (napi_create_external(env, handle, finalizeHandle, nullptr, &external) != napi_ok) {
+        rc_close(handle->store);
+        delete handle;
+        napi_throw_error(env, nullptr, "Could not create the store handle");
+        return nullptr;
+    }
+    return external;
+}
+
+// Flushes and frees the store now instead of at garbage collection. With
+// async commands still running, the last one to finish does it.
+napi_value Close(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+    void* data = nullptr;
+    if (argc < 1 || napi_get_value_external(env, args[0], &data) != napi_ok || !data) {
+        napi_throw_type_error(env, nullptr, "Expected a store from open()");
+        return nullptr;
+    }
+    StoreHandle* handle = static_cast<StoreHandle*>(data);
+    handle->closing = true;
+    if (handle->running == 0) {
+        rc_close(handle->store);
+        handle->store = nullptr;
+    }
+    return nullptr;
+}
+
+// ==================== execute ====================
+// Runs on the JS thread: meant for lookups that take microseconds
+napi_value Execute(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+    if (argc < 2) {
+        napi_throw_type_error(env, nullptr, "execute(store, command)");
+        return nullptr;
+    }
+    StoreHandle* handle = unwrapHandle(env, args[0]);
+    string command;
+    if (!handle) return nullptr;
+    if (!readString(env, args[1], command)) {
+        napi_throw_type_error(env, nullptr, "Command must be a string");
+        return nullptr;
+    }
+    size_t length = 0;
+    char* reply = rc_execute(handle->store, command.data(), command.size(), &length);
+    return replyBuffer(env, reply, length);
+}
+
+struct AsyncCommand {
+    StoreHandle* handle;
+    string command;
+    char* reply = nullptr;
+    size_t length = 0;
+    napi_deferred deferred;
+    napi_async_work work;
+    napi_ref keepAlive;   // stops the handle being collected mid-command
+};
+
+void runOnWorker(napi_env, void* data) {
+    AsyncCommand* call = static_cast<AsyncCommand*>(data);
+    call->reply = rc_execute(call->handle->store, call->command.data(), call->command.size(), &call->length);
+}
+
+void finishOnMainThread(napi_env env, napi_status status, void* data) {
+    AsyncCommand* call = static_cast<AsyncCommand*>(data);
+    StoreHandle* handle = call->handle;
+    napi_value result = nullptr;
+    if (status == napi_ok && call->reply) {
+        result = replyBuffer(env, call->reply, call->length);
+    } else {
+        rc_free(call->reply);
+    }
+    bool pending = false;
+    napi_is_exception_pending(env, &pending);
+    if (!result || pending) {
+        napi_value error, message;
+        if (pending) {
+            napi_get_and_clear_last_exception(env, &error);
+        } else {
+            napi_create_string_utf8(env, status == napi_cancelled ? "Command cancelled" : "Out of memory",
+                                    NAPI_AUTO_LENGTH, &message);
+            napi_create_error(env, nullptr, message, &error);
+        }
+        napi_reject_deferred(env, call->deferred, error);
+    } else {
+        napi_resolve_deferred(env, call->deferred, result);
+    }
+
+    if (--handle->running == 0 && handle->closing && handle->store) {
+        rc_close(handle->store);
+        handle->store = nullptr;
+    }
+    napi_delete_reference(env, call->keepAlive);
+    napi_delete_async_work(env, call->work);
+    delete call;
+}
+
+// Runs on a libuv worker thread and returns a Promise for the reply
+napi_value ExecuteAsync(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+    if (argc < 2) {
+        napi_throw_type_error(env, nullptr, "executeAsync(store, command)");
+        return nullptr;
+    }
+    StoreHandle* handle = unwrapHandle(env, args[0]);
+    if (!handle) return nullptr;
+    AsyncCommand* call = new AsyncCommand();
+    call->handle = handle;
+    if (!readString(env, args[1], call->command)) {
+        delete call;
+        napi_throw_type_error(env, nullptr, "Command must be a string");
+        return nullptr;
+    }
+
+    napi_value promise, name;
+    NAPI_CALL(env, napi_create_promise(env, &call->deferred, &promise));
+    NAPI_CALL(env, napi_create_string_utf8(env, "result_core", NAPI_AUTO_LENGTH, &name));
+    NAPI_CALL(env, napi_create_reference(env, args[0], 1, &call->keepAlive));
+    NAPI_CALL(env, napi_create_async_work(env, nullptr, name, runOnWorker, finishOnMainThread, call, &call->work));
+    NAPI_CALL(env, napi_queue_async_work(env, call->work));
+    handle->running++;
+    return promise;
+}
+
+// ==================== MODULE ====================
+napi_value Init(napi_env env, napi_value exports) {
+    napi_property_descriptor methods[] = {
+        {"open", nullptr, Open, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"close", nullptr, Close, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"execute", nullptr, Execute, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"executeAsync", nullptr, ExecuteAsync, nullptr, nullptr, nullptr, napi_default, nullptr},
+    };
+    NAPI_CALL(env, napi_define_properties(env, exports, sizeof(methods) / sizeof(methods[0]), methods));
+    return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, Init)
@@ -0,0 +1,57 @@
+/*
+ * result_core.h - C interface to the result store in backend_server.cpp
+ *
+ * Build the library with RESULT_CORE_LIBRARY defined, which leaves out the
+ * executable's main():
+ *   g++ -std=c++17 -O2 -fPIC -shared -fvisibility=hidden -pthread -DRESULT_CORE_LIBRARY backend_server.cpp -o libresult_core.so
+ *
+ * Commands and replies are exactly those of `--serve` (ADD|..., SEARCH|PRN,
+ * GET_ALL, ...; one JSON object back). Files are read from and written to
+ * the current directory, as for the executable.
+ */
+#ifndef RESULT_CORE_H
+#define RESULT_CORE_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#  ifdef RESULT_CORE_LIBRARY
+#    define RESULT_CORE_API __declspec(dllexport)
+#  else
+#    define RESULT_CORE_API __declspec(dllimport)
+#  endif
+#else
+#  define RESULT_CORE_API __attribute__((visibility("default")))
+#endif
+
+/* Bumped whenever a signature below changes */
+#define RESULT_CORE_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct rc_store rc_store;
+
+RESULT_CORE_API unsigned rc_abi_version(void);
+
+/* Loads the store. argv holds the executable's store flags ("--compact",
+ * "--shards=4", "--durability=fsync", "--classlist=file", ...). Returns
+ * NULL if loading failed. */
+RESULT_CORE_API rc_store* rc_open(int argc, const char* const* argv);
+
+/* Runs one command. Safe to call from several threads at once. The reply
+ * is NUL-terminated JSON of *reply_length bytes, owned by the caller and
+ * released with rc_free(). NULL only when out of memory. */
+RESULT_CORE_API char* rc_execute(rc_store* store, const char* command, size_t length, size_t* reply_length);
+
+RESULT_CORE_API void rc_free(char* reply);
+
+/* Waits for queued writes to reach disk, then frees the store */
+RESULT_CORE_API void rc_close(rc_store* store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
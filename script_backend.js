@@ -18,8 +18,8 @@ document.querySelectorAll('.tab-btn').forEach(btn => {
         
         if (tabName === 'classmate') {
             loadClassmateData();
-        } else if (tabName === 'view') {
-            loadAllResults();
+        } else if (tabName === 'view' && !resultFeed) {
+            loadAllResults();   // once connected, the change feed keeps the tab current
         }
     });
 });
@@ -482,17 +482,15 @@ function displayClassmateStats() {
 }
 
 // ==================== LOAD ALL RESULTS (BACKEND) ====================
-async function loadAllResults() {
-    const resultsDiv = document.getElementById('allResults');
-    showLoading(true);
-    
-    try {
-        const response = await fetch(`${API_URL}/all-students`);
-        const result = await response.json();
-        
-        if (result.success && result.data.length > 0) {
-            resultsDiv.innerHTML = result.data.map(student => `
-                <div class="result-card">
+// The "View All" tab listens to the server's change feed (/api/changes):
+// the first event is a full reset, later events only carry the students
+// that were added, corrected or deleted, so cards are patched in place.
+let resultFeed = null;
+const shownResults = new Map();   // PRN -> student
+
+function renderResultCard(student) {
+    return `
+                <div class="result-card" data-prn="${student.prn}">
                     <h3 style="color: var(--primary); margin-bottom: 15px;">${student.name}</h3>
                     <div class="result-info">
                         <div class="info-item">
@@ -508,14 +506,102 @@ async function loadAllResults() {
                         <h2 style="font-size: 2rem; margin-bottom: 5px;">Grade: ${student.grade}</h2>
                     </div>
                 </div>
-            `).join('');
-        } else {
-            resultsDiv.innerHTML = `
+            `;
+}
+
+function renderNoResults() {
+    document.getElementById('allResults').innerHTML = `
                 <div class="result-card" style="grid-column: 1 / -1;">
                     <h3 style="color: #64748b; text-align: center;"><span class="icon">📭</span> No Results Found</h3>
                     <p style="color: #64748b; text-align: center; margin-top: 10px;">Add some student results to see them here.</p>
                 </div>
             `;
+}
+
+function renderAllResults(students) {
+    shownResults.clear();
+    students.forEach(student => shownResults.set(student.prn, student));
+    if (students.length > 0) {
+        document.getElementById('allResults').innerHTML = students.map(renderResultCard).join('');
+    } else {
+        renderNoResults();
+    }
+}
+
+// Replace, insert (in PRN order) or remove a single card
+function applyResultChange(change) {
+    const resultsDiv = document.getElementById('allResults');
+    const prn = change.op === 'delete' ? change.prn : change.student.prn;
+    const card = resultsDiv.querySelector(`[data-prn="${CSS.escape(prn)}"]`);
+
+    if (change.op === 'delete') {
+        shownResults.delete(prn);
+        if (card) card.remove();
+        if (shownResults.size === 0) renderNoResults();
+        return;
+    }
+
+    if (shownResults.size === 0) resultsDiv.innerHTML = '';
+    shownResults.set(prn, change.student);
+    const template = document.createElement('template');
+    template.innerHTML = renderResultCard(change.student).trim();
+    const newCard = template.content.firstChild;
+
+    if (card) {
+        card.replaceWith(newCard);
+    } else {
+        const next = Array.from(resultsDiv.querySelectorAll('[data-prn]')).find(c => c.dataset.prn > prn);
+        resultsDiv.insertBefore(newCard, next || null);
+    }
+}
+
+function startResultFeed() {
+    if (resultFeed || typeof EventSource === 'undefined') return false;
+
+    resultFeed = new EventSource(`${API_URL}/changes`);
+    resultFeed.addEventListener('reset', (e) => {
+        const feed = JSON.parse(e.data);
+        renderAllResults(feed.students.sort((a, b) => (a.prn < b.prn ? -1 : a.prn > b.prn ? 1 : 0)));
+        showLoading(false);
+    });
+    resultFeed.addEventListener('change', (e) => applyResultChange(JSON.parse(e.data)));
+    resultFeed.addEventListener('feed-error', () => {
+        resultFeed.close();
+        resultFeed = null;
+        fetchAllResults();
+    });
+    resultFeed.onerror = () => {
+        // EventSource reconnects on its own; only fall back if it gave up
+        if (resultFeed.readyState === EventSource.CLOSED) {
+            resultFeed = null;
+            fetchAllResults();
+        }
+    };
+    return true;
+}
+
+async function loadAllResults() {
+    // Refresh button: reconnect, which starts again with a full reset
+    if (resultFeed) {
+        resultFeed.close();
+        resultFeed = null;
+    }
+    showLoading(true);
+    if (!startResultFeed()) await fetchAllResults();
+}
+
+async function fetchAllResults() {
+    const resultsDiv = document.getElementById('allResults');
+    showLoading(true);
+    
+    try {
+        const response = await fetch(`${API_URL}/all-students`);
+        const result = await response.json();
+        
+        if (result.success) {
+            renderAllResults(result.data);
+        } else {
+            renderNoResults();
         }
     } catch (error) {
         console.error('Error:', error);
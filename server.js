@@ -5,6 +5,10 @@ const express = require('express');
 const { spawn } = require('child_process');
 const cors = require('cors');
 const path = require('path');
+const os = require('os');
+const fs = require('fs');
+const zlib = require('zlib');
+const { promisify } = require('util');
 
 const app = express();
 const PORT = 3000;
@@ -18,15 +22,23 @@ app.use(express.static(__dirname)); // Serve HTML, CSS, JS files
 const CPP_EXECUTABLE = path.join(__dirname, 'Student_Result_Management_Enhanced.exe');
 
 // ==================== HELPER FUNCTION ====================
-function runCppCommand(command) {
+// Runs one command in a fresh backend process and resolves with its stdout
+// bytes. The process is killed if it has not answered within timeoutMs.
+function spawnCppCommand(command, timeoutMs) {
     return new Promise((resolve, reject) => {
         const child = spawn(CPP_EXECUTABLE, ['--web']);
         
-        let output = '';
+        const output = [];
         let errorOutput = '';
+        let timedOut = false;
+        
+        const timer = setTimeout(() => {
+            timedOut = true;
+            child.kill('SIGKILL');
+        }, Math.max(1, timeoutMs));
         
         child.stdout.on('data', (data) => {
-            output += data.toString();
+            output.push(data);
         });
         
         child.stderr.on('data', (data) => {
@@ -34,15 +46,24 @@ function runCppCommand(command) {
         });
         
         child.on('close', (code) => {
+            clearTimeout(timer);
+            if (timedOut) {
+                reject(new BackendError('Backend did not answer in time', 504));
+                return;
+            }
             if (code !== 0) {
                 console.error('C++ Error:', errorOutput);
                 reject(new Error(errorOutput || 'C++ program exited with error'));
                 return;
             }
-            resolve(output.trim());
+            const bytes = Buffer.concat(output);
+            let end = bytes.length;
+            while (end > 0 && (bytes[end - 1] === 0x0a || bytes[end - 1] === 0x0d || bytes[end - 1] === 0x20)) end--;
+            resolve(bytes.subarray(0, end));
         });
         
         child.on('error', (err) => {
+            clearTimeout(timer);
             console.error('Spawn Error:', err);
             reject(err);
         });
@@ -53,7 +74,429 @@ function runCppCommand(command) {
     });
 }
 
+// ==================== IN-PROCESS BACKEND ====================
+// When the addon is built (`npm run build:addon`), the store is loaded once
+// into this process and commands run through result_core.h: no process
+// per request, no reload of reportcards.txt per request. Student lookups run
+// inline (they take microseconds); everything else runs on a libuv worker
+// thread. Without the addon, or with RESULT_CORE=spawn, every command gets
+// its own backend process as before. The in-process store does not see
+// edits other programs make to reportcards.txt. Restart the bridge after
+// making any.
+let core = null;
+let coreStore = null;
+
+if (process.env.RESULT_CORE !== 'spawn') {
+    try {
+        core = require('./build/Release/result_addon.node');
+        coreStore = core.open((process.env.RESULT_CORE_ARGS || '').split(' ').filter(Boolean));
+        console.log('Result store loaded in process');
+    } catch (error) {
+        core = null;
+        if (error.code !== 'MODULE_NOT_FOUND') console.error('Addon unavailable, spawning backends:', error.message);
+    }
+}
+
+// Queued writes reach disk before the bridge exits
+function closeCoreStore() {
+    if (!coreStore) return;
+    core.close(coreStore);
+    coreStore = null;
+}
+process.on('exit', closeCoreStore);
+['SIGINT', 'SIGTERM'].forEach(signal => process.on(signal, () => process.exit(0)));
+
+// A call in this process cannot be killed, so at the deadline the request
+// gets 504 and the call is left to finish
+function withDeadline(promise, timeoutMs) {
+    return new Promise((resolve, reject) => {
+        const timer = setTimeout(() => reject(new BackendError('Backend did not answer in time', 504)), Math.max(1, timeoutMs));
+        promise.then(
+            value => { clearTimeout(timer); resolve(value); },
+            error => { clearTimeout(timer); reject(error); }
+        );
+    });
+}
+
+// ==================== ADMISSION CONTROL ====================
+// Every command costs a whole backend process (or, in process, a worker
+// thread), so at most MAX_BACKENDS run at once and the rest wait in a bounded queue, one FIFO per priority class.
+// Free slots go to the highest class first, and bulk commands never take
+// the last slot so a student lookup is not stuck behind a full GET_ALL.
+// Requests are shed with 503 and Retry-After when the queue is full, or
+// when queueing delay is above QUEUE_TARGET_MS (bulk first, writes at 4x
+// the target; student lookups only when the queue is full). Each class has
+// a deadline covering queueing and running: past it the request is dropped
+// from the queue (503) or its backend is killed (504).
+const MAX_BACKENDS = Math.max(2, os.cpus().length);
+const QUEUE_LIMIT = 256;
+const QUEUE_TARGET_MS = 250;
+
+const PRIORITY_CLASSES = {
+    interactive: { rank: 0, slots: MAX_BACKENDS, deadlineMs: 5000, shedAboveMs: Infinity },
+    write: { rank: 1, slots: MAX_BACKENDS, deadlineMs: 15000, shedAboveMs: 4 * QUEUE_TARGET_MS },
+    bulk: { rank: 2, slots: MAX_BACKENDS - 1, deadlineMs: 30000, shedAboveMs: QUEUE_TARGET_MS }
+};
+
+// Anything not listed (GET_ALL, STATS, SUBSCRIBE, EXPORT, JOB...) is bulk
+const COMMAND_CLASSES = {
+    SEARCH: 'interactive',
+    CLASSMATE: 'interactive',
+    RANK: 'interactive',
+    ADD: 'write',
+    UPDATE_MARKS: 'write',
+    DELETE: 'write'
+};
+
+class BackendError extends Error {
+    constructor(message, status, retryAfter) {
+        super(message);
+        this.status = status;
+        this.retryAfter = retryAfter;
+    }
+}
+
+let runningBackends = 0;
+const runningByRank = [0, 0, 0];
+const waitingByRank = [[], [], []];
+let queueDelayMs = 0;      // how long the last request to get a slot had waited
+let serviceTimeMs = 200;   // moving average of backend run time
+
+function commandClass(command) {
+    const fields = command.split('|', 3);
+    const verb = fields[0] === 'DATASET' ? fields[2] : fields[0];
+    return PRIORITY_CLASSES[COMMAND_CLASSES[verb] || 'bulk'];
+}
+
+function queuedRequests() {
+    return waitingByRank.reduce((n, queue) => n + queue.length, 0);
+}
+
+// Queueing delay a new request of this class can expect: the last measured
+// one, the age of anything still waiting, or the time for the requests
+// ahead of it to get through its slots, whichever is longest
+function expectedQueueDelay(cls, now) {
+    let delay = queueDelayMs;
+    let ahead = 0;
+    for (const queue of waitingByRank.slice(0, cls.rank + 1)) {
+        if (queue.length > 0) delay = Math.max(delay, now - queue[0].enqueuedAt);
+        ahead += queue.length;
+    }
+    return Math.max(delay, (ahead + 1) * serviceTimeMs / cls.slots);
+}
+
+// Time for everything already queued to drain, in whole seconds
+function retryAfterSeconds() {
+    return Math.max(1, Math.ceil((queuedRequests() + 1) * serviceTimeMs / MAX_BACKENDS / 1000));
+}
+
+function canStart(cls) {
+    return runningBackends < MAX_BACKENDS && runningByRank[cls.rank] < cls.slots;
+}
+
+function startBackend(cls) {
+    runningBackends++;
+    runningByRank[cls.rank]++;
+}
+
+function acquireBackend(cls) {
+    const now = Date.now();
+    const aheadOfUs = waitingByRank.slice(0, cls.rank + 1).some(queue => queue.length > 0);
+    if (!aheadOfUs && canStart(cls)) {
+        startBackend(cls);
+        return Promise.resolve();
+    }
+    if (queuedRequests() >= QUEUE_LIMIT || expectedQueueDelay(cls, now) > cls.shedAboveMs) {
+        return Promise.reject(new BackendError('Server busy, try again later', 503, retryAfterSeconds()));
+    }
+    return new Promise((resolve, reject) => {
+        waitingByRank[cls.rank].push({ resolve, reject, cls, enqueuedAt: now });
+    });
+}
+
+function releaseBackend(cls) {
+    runningBackends--;
+    runningByRank[cls.rank]--;
+    const now = Date.now();
+    for (const queue of waitingByRank) {
+        while (queue.length > 0 && canStart(queue[0].cls)) {
+            const next = queue.shift();
+            const waited = now - next.enqueuedAt;
+            if (waited >= next.cls.deadlineMs) {
+                next.reject(new BackendError('Request timed out in queue', 503, retryAfterSeconds()));
+                continue;
+            }
+            queueDelayMs = waited;
+            startBackend(next.cls);
+            next.resolve();
+            return;
+        }
+    }
+    if (queuedRequests() === 0) queueDelayMs = 0;
+}
+
+// The reply as a Buffer of JSON bytes. In process, the slot is held until
+// the call really finishes, even past a 504.
+async function runCppCommandRaw(command) {
+    const cls = commandClass(command);
+    const admitted = Date.now();
+    await acquireBackend(cls);
+    
+    const started = Date.now();
+    const timeoutMs = cls.deadlineMs - (started - admitted);
+    // A DATASET command may have to load the dataset from disk first, so
+    // only top-level interactive commands run on the event loop
+    let run;
+    if (coreStore && cls === PRIORITY_CLASSES.interactive && !command.startsWith('DATASET|')) {
+        run = new Promise(resolve => resolve(core.execute(coreStore, command)));
+    } else if (coreStore) {
+        run = core.executeAsync(coreStore, command);
+    } else {
+        run = spawnCppCommand(command, timeoutMs);
+    }
+    run.catch(() => {}).then(() => {
+        serviceTimeMs = 0.8 * serviceTimeMs + 0.2 * (Date.now() - started);
+        releaseBackend(cls);
+    });
+    return coreStore ? withDeadline(run, timeoutMs) : run;
+}
+
+async function runCppCommand(command) {
+    return (await runCppCommandRaw(command)).toString().trim();
+}
+
+// 503/504 from admission control keep their status; anything else is a 500
+function sendFailure(res, error) {
+    if (error.retryAfter) res.set('Retry-After', String(error.retryAfter));
+    res.status(error.status || 500).json({ success: false, error: error.message });
+}
+
+// ==================== RESPONSE CACHE ====================
+// GET_ALL, SEARCH and STATS replies are cached per store version. The
+// version is bumped by every write through this bridge and whenever the
+// record files change on disk (another process, a manual edit), which
+// fs.watch reports and a slow recheck backs up. A cached
+// reply carries a strong ETag, so If-None-Match is answered with 304
+// without running the backend, and bodies above COMPRESS_MIN_BYTES are
+// gzip/deflate-compressed once per version and reused.
+const COMPRESS_MIN_BYTES = 1024;
+const compressors = { gzip: promisify(zlib.gzip), deflate: promisify(zlib.deflate) };
+const RESPONSE_CACHE_LIMIT = 1000;
+const STORE_EPOCH = Date.now().toString(36);   // ETags from an earlier run never match
+const DATASET_ROOT = path.join(process.cwd(), 'datasets');
+let storeVersion = 0;
+let storeFingerprint = '';
+const responseCache = new Map();   // backend command -> cached reply
+const pendingReplies = new Map();  // backend command -> { version, promise } of a run in progress
+
+const FINGERPRINT_RECHECK_MS = 5000;  // in case a watcher misses a change
+let fingerprintStale = true;         // recompute before the next cached GET
+let fingerprintRefresh = null;       // recompute in progress, shared by the GETs waiting on it
+
+async function recordFilesIn(dir) {
+    return (await fs.promises.readdir(dir))
+        .filter(name => /^reportcards.*\.txt$/.test(name) && !name.includes('.audit'))
+        .sort()
+        .map(name => path.join(dir, name));
+}
+
+async function isDirectory(dir) {
+    return (await fs.promises.stat(dir)).isDirectory();
+}
+
+// Size and mtime of every file the replies are built from, including the
+// batch/semester directories of the dataset catalog
+async function dataFingerprint() {
+    try {
+        let files = await recordFilesIn(process.cwd());
+        const batches = await fs.promises.readdir(DATASET_ROOT).catch(error => {
+            if (error.code === 'ENOENT') return [];
+            throw error;
+        });
+        for (const batch of batches.sort()) {
+            const batchDir = path.join(DATASET_ROOT, batch);
+            if (!await isDirectory(batchDir)) continue;
+            for (const semester of (await fs.promises.readdir(batchDir)).sort()) {
+                const dir = path.join(batchDir, semester);
+                if (await isDirectory(dir)) files = files.concat(await recordFilesIn(dir));
+            }
+        }
+        const stats = await Promise.all(files.map(file => fs.promises.stat(file)));
+        return files.map((file, i) => `${file}:${stats[i].size}:${stats[i].mtimeMs}`).join('|');
+    } catch (error) {
+        return null;   // cannot tell, so never reuse the cache
+    }
+}
+
+function refreshFingerprint() {
+    if (!fingerprintRefresh) {
+        fingerprintStale = false;
+        fingerprintRefresh = dataFingerprint().then(fingerprint => {
+            if (fingerprint === null) fingerprintStale = true;
+            if (fingerprint === null || fingerprint !== storeFingerprint) {
+                storeFingerprint = fingerprint;
+                bumpStoreVersion();
+            }
+        }).finally(() => { fingerprintRefresh = null; });
+    }
+    return fingerprintRefresh;
+}
+
+// The fingerprint is only recomputed after a watcher saw a record file
+// change (or the recheck interval passed), not on every GET
+async function currentStoreVersion() {
+    if (fingerprintStale) await refreshFingerprint();
+    return storeVersion;
+}
+
+function markFingerprintStale() {
+    fingerprintStale = true;
+}
+
+function watchRecordFiles() {
+    const watch = (dir, options, onChange) => {
+        try {
+            fs.watch(dir, options, onChange).on('error', markFingerprintStale);
+        } catch (error) {
+            // Missing directory, or no recursive watch on this platform: the recheck still runs
+        }
+    };
+    // Some platforms report no file name; treat that as a change
+    watch(process.cwd(), {}, (event, name) => {
+        if (!name || /^(reportcards|datasets)/.test(name)) markFingerprintStale();
+    });
+    watch(DATASET_ROOT, { recursive: true }, markFingerprintStale);
+    setInterval(markFingerprintStale, FINGERPRINT_RECHECK_MS).unref();
+}
+
+watchRecordFiles();
+
+function bumpStoreVersion() {
+    storeVersion++;
+    responseCache.clear();
+}
+
+function etagMatches(header, etag) {
+    if (!header) return false;
+    return header.split(',').map(t => t.trim()).some(t => t === '*' || t === etag);
+}
+
+function pickEncoding(acceptEncoding) {
+    const accepted = (acceptEncoding || '').toLowerCase();
+    if (/\bgzip\b/.test(accepted)) return 'gzip';
+    if (/\bdeflate\b/.test(accepted)) return 'deflate';
+    return null;
+}
+
+// Successful replies wrap the backend's JSON as it is: the body is spliced
+// from its bytes, never parsed and re-serialized.
+const DATA_PREFIX = Buffer.from('{"success":true,"data":');
+const DATA_SUFFIX = Buffer.from('}');
+
+function successBody(raw) {
+    return Buffer.concat([DATA_PREFIX, raw, DATA_SUFFIX]);
+}
+
+function isErrorReply(raw) {
+    return raw.toString('utf8', 0, 9) === '{"error":';
+}
+
+// toReply for the cached GETs: a backend error (no such student or dataset) is a 404
+function dataReply(raw) {
+    if (isErrorReply(raw)) {
+        const { error } = JSON.parse(raw);
+        return { status: 404, body: Buffer.from(JSON.stringify({ success: false, error })) };
+    }
+    return { status: 200, body: successBody(raw) };
+}
+
+// Run a command for the cache. Identical misses arriving while it runs
+// share the one backend run instead of each taking a slot.
+function fetchReply(command, version, toReply) {
+    const pending = pendingReplies.get(command);
+    if (pending && pending.version === version) return pending.promise;
+
+    const promise = (async () => {
+        console.log('Command:', command);
+        const result = await runCppCommandRaw(command);
+        console.log('C++ Output:', result.length > 200 ? `${result.toString('utf8', 0, 200)}... (${result.length} bytes)` : result.toString().trim());
+
+        const reply = toReply(result);
+        const entry = {
+            status: reply.status,
+            body: reply.body,
+            etag: `"${STORE_EPOCH}-${version}"`,
+            encoded: {}
+        };
+        // A write that landed while the backend ran bumped the version: don't cache
+        if (version === storeVersion) {
+            if (responseCache.size >= RESPONSE_CACHE_LIMIT) {
+                responseCache.delete(responseCache.keys().next().value);
+            }
+            responseCache.set(command, entry);
+        }
+        return entry;
+    })();
+    pendingReplies.set(command, { version, promise });
+    promise.catch(() => {}).then(() => {
+        if (pendingReplies.get(command)?.promise === promise) pendingReplies.delete(command);
+    });
+    return promise;
+}
+
+// Answer a GET from the cache when possible. toReply(backendOutput) turns
+// the backend's reply bytes into { status, body }.
+async function sendCached(req, res, command, toReply) {
+    const version = await currentStoreVersion();
+    const entry = responseCache.get(command) || await fetchReply(command, version, toReply);
+
+    res.set({ 'ETag': entry.etag, 'Cache-Control': 'no-cache', 'Vary': 'Accept-Encoding' });
+    if (etagMatches(req.headers['if-none-match'], entry.etag)) {
+        res.status(304).end();
+        return;
+    }
+
+    let body = entry.body;
+    const encoding = body.length >= COMPRESS_MIN_BYTES ? pickEncoding(req.headers['accept-encoding']) : null;
+    if (encoding) {
+        // Cache the promise so concurrent requests share one compression
+        if (!entry.encoded[encoding]) entry.encoded[encoding] = compressors[encoding](body);
+        body = await entry.encoded[encoding];
+        res.set('Content-Encoding', encoding);
+    }
+    res.status(entry.status).set('Content-Type', 'application/json; charset=utf-8').send(body);
+}
+
 // ==================== API ENDPOINTS ====================
+// The result endpoints take ?dataset=batch/semester to use that class's data
+// from the dataset catalog instead of the default reportcards.txt (the
+// change feed follows the default dataset only). The key is checked with the
+// backend's rule, so a '|' cannot smuggle another command into the line.
+const DATASET_KEY = /^(?!\.\.?\/)[A-Za-z0-9._-]+\/(?!\.\.?$)[A-Za-z0-9._-]+$/;
+
+function scoped(req, command) {
+    const dataset = req.query.dataset;
+    if (dataset === undefined || dataset === '') return command;
+    if (typeof dataset !== 'string' || !DATASET_KEY.test(dataset)) {
+        throw new BackendError('Invalid dataset name', 400);
+    }
+    return `DATASET|${dataset}|${command}`;
+}
+
+// Search, all-students and stats also take ?asOf=2025-06-01 (or Unix
+// seconds, or an ISO time) for the results as they stood at that time
+// The forms parseTimestamp in the backend reads: Unix seconds, or a date
+// with an optional time
+const AS_OF_TIME = /^(?:\d{1,13}|\d{4}-\d{2}-\d{2}(?:[T ]\d{2}:\d{2}(?::\d{2})?(?:\.\d+)?Z?)?)$/;
+
+function historical(req, command) {
+    const asOf = req.query.asOf;
+    if (asOf === undefined || asOf === '') return command;
+    if (typeof asOf !== 'string' || !AS_OF_TIME.test(asOf)) {
+        throw new BackendError('Invalid asOf time', 400);
+    }
+    return `AS_OF|${asOf}|${command}`;
+}
 
 // Add new student result
 app.post('/api/add-student', async (req, res) => {
@@ -65,6 +508,7 @@ app.post('/api/add-student', async (req, res) => {
         courses.forEach(c => {
             command += `|${c.code}|${c.name}|${c.marks}|${c.maxMarks}`;
         });
+        command = scoped(req, command);
         
         console.log('Command:', command);
         const result = await runCppCommand(command);
@@ -73,9 +517,11 @@ app.post('/api/add-student', async (req, res) => {
         const studentData = JSON.parse(result);
         
         res.json({ success: true, data: studentData });
+        bumpStoreVersion();
+        notifyFeed();
     } catch (error) {
         console.error('Add student error:', error);
-        res.status(500).json({ success: false, error: error.message });
+        sendFailure(res, error);
     }
 });
 
@@ -83,22 +529,68 @@ app.post('/api/add-student', async (req, res) => {
 app.get('/api/search-student/:prn', async (req, res) => {
     try {
         const prn = req.params.prn;
-        const command = `SEARCH|${prn}`;
+        const command = scoped(req, historical(req, `SEARCH|${prn}`));
         
+        await sendCached(req, res, command, dataReply);
+    } catch (error) {
+        console.error('Search student error:', error);
+        sendFailure(res, error);
+    }
+});
+
+// HTTP status for an UPDATE_MARKS/DELETE error reply
+function writeErrorStatus(error) {
+    if (error === 'Version conflict') return 409;
+    if (error === 'Student not found' || error === 'Course not found') return 404;
+    return 400;
+}
+
+// Correct one course's marks; pass the last seen version for compare-and-set
+app.patch('/api/student/:prn/marks', async (req, res) => {
+    try {
+        const { courseCode, marks, version } = req.body;
+        const command = scoped(req, `UPDATE_MARKS|${req.params.prn}|${courseCode}|${marks}|${version || ''}`);
+
         console.log('Command:', command);
         const result = await runCppCommand(command);
         console.log('C++ Output:', result);
-        
+
         const studentData = JSON.parse(result);
-        
+
         if (studentData.error) {
-            res.status(404).json({ success: false, error: studentData.error });
+            res.status(writeErrorStatus(studentData.error)).json({ success: false, ...studentData });
         } else {
             res.json({ success: true, data: studentData });
+            bumpStoreVersion();
+            notifyFeed();
         }
     } catch (error) {
-        console.error('Search student error:', error);
-        res.status(500).json({ success: false, error: error.message });
+        console.error('Update marks error:', error);
+        sendFailure(res, error);
+    }
+});
+
+// Delete a student; ?version=N makes it conditional
+app.delete('/api/student/:prn', async (req, res) => {
+    try {
+        const command = scoped(req, `DELETE|${req.params.prn}|${req.query.version || ''}`);
+
+        console.log('Command:', command);
+        const result = await runCppCommand(command);
+        console.log('C++ Output:', result);
+
+        const deleted = JSON.parse(result);
+
+        if (deleted.error) {
+            res.status(writeErrorStatus(deleted.error)).json({ success: false, ...deleted });
+        } else {
+            res.json({ success: true, data: deleted });
+            bumpStoreVersion();
+            notifyFeed();
+        }
+    } catch (error) {
+        console.error('Delete student error:', error);
+        sendFailure(res, error);
     }
 });
 
@@ -106,7 +598,7 @@ app.get('/api/search-student/:prn', async (req, res) => {
 app.get('/api/search-classmate/:prn', async (req, res) => {
     try {
         const prn = req.params.prn;
-        const command = `CLASSMATE|${prn}`;
+        const command = scoped(req, `CLASSMATE|${prn}`);
         
         console.log('Command:', command);
         const result = await runCppCommand(command);
@@ -117,26 +609,179 @@ app.get('/api/search-classmate/:prn', async (req, res) => {
         res.json(classmateData);
     } catch (error) {
         console.error('Search classmate error:', error);
-        res.status(500).json({ success: false, error: error.message });
+        sendFailure(res, error);
     }
 });
 
 // Get all saved results
 app.get('/api/all-students', async (req, res) => {
     try {
-        const command = 'GET_ALL';
+        const command = scoped(req, historical(req, 'GET_ALL'));
+        
+        await sendCached(req, res, command, dataReply);
+    } catch (error) {
+        console.error('Get all students error:', error);
+        sendFailure(res, error);
+    }
+});
+
+// Cohort statistics (count, average, grade distribution)
+app.get('/api/stats', async (req, res) => {
+    try {
+        const command = scoped(req, historical(req, 'STATS'));
         
+        await sendCached(req, res, command, dataReply);
+    } catch (error) {
+        console.error('Stats error:', error);
+        sendFailure(res, error);
+    }
+});
+
+// Course leaderboard: GET /api/courses/DSA/top?k=10 (or /bottom), marks
+// normalized to the course maximum
+app.get('/api/courses/:code/:order(top|bottom)', async (req, res) => {
+    try {
+        const verb = req.params.order === 'top' ? 'TOP' : 'BOTTOM';
+        const command = scoped(req, `${verb}|${req.params.code}|${req.query.k || ''}`);
+
+        await sendCached(req, res, command, dataReply);
+    } catch (error) {
+        console.error('Course leaderboard error:', error);
+        sendFailure(res, error);
+    }
+});
+
+// What-if re-grade: { adjustments: [{ op: 'add'|'scale'|'cap', course, value }],
+// policy: [90, 75, 60, 50, 40], limit }. Course '*' means every course.
+// Nothing is written; the reply has the grade distribution before and after
+// and the students whose grade would change.
+app.post('/api/simulate', async (req, res) => {
+    try {
+        const { adjustments = [], policy, limit } = req.body;
+
+        let command = 'SIMULATE';
+        adjustments.forEach(a => {
+            command += `|${String(a.op).toUpperCase()}:${a.course}:${a.value}`;
+        });
+        if (Array.isArray(policy)) command += `|POLICY:${policy.join(',')}`;
+        if (limit !== undefined) command += `|LIMIT:${limit}`;
+        command = scoped(req, command);
+
         console.log('Command:', command);
         const result = await runCppCommand(command);
-        console.log('C++ Output:', result);
+
+        const simulation = JSON.parse(result);
+
+        if (simulation.error) {
+            res.status(400).json({ success: false, ...simulation });
+        } else {
+            res.json({ success: true, data: simulation });
+        }
+    } catch (error) {
+        console.error('Simulate error:', error);
+        sendFailure(res, error);
+    }
+});
+
+// Dataset catalog: every batch/semester, loaded or not
+app.get('/api/datasets', async (req, res) => {
+    try {
+        const command = 'DATASETS';
         
-        const students = JSON.parse(result);
+        console.log('Command:', command);
+        const result = await runCppCommand(command);
+        console.log('C++ Output:', result);
         
-        res.json({ success: true, data: students });
+        res.json({ success: true, data: JSON.parse(result) });
     } catch (error) {
-        console.error('Get all students error:', error);
-        res.status(500).json({ success: false, error: error.message });
+        console.error('Datasets error:', error);
+        sendFailure(res, error);
+    }
+});
+
+// ==================== CHANGE FEED (SSE) ====================
+// GET /api/changes streams result updates as Server-Sent Events instead of
+// the dashboard re-downloading GET_ALL. Each client remembers the last feed
+// position it was sent; one SUBSCRIBE per distinct position is run every
+// FEED_POLL_MS (and right after a write through this bridge), so clients
+// that are caught up share a single backend call.
+//   event: reset   data: {seq, students}   replace everything shown
+//   event: change  data: {seq, op, student | prn}, id = seq
+//   event: feed-error  the backend failed before the first reset
+const FEED_POLL_MS = 2000;
+const feedClients = new Set();
+let feedPolling = false;
+let feedAgain = false;
+
+function sendEvent(client, event, data, id) {
+    if (id !== undefined) client.res.write(`id: ${id}\n`);
+    client.res.write(`event: ${event}\ndata: ${JSON.stringify(data)}\n\n`);
+}
+
+async function pollFeed() {
+    if (feedPolling) {
+        feedAgain = true;
+        return;
+    }
+    feedPolling = true;
+    try {
+        do {
+            feedAgain = false;
+            const bySeq = new Map();
+            feedClients.forEach(client => {
+                if (!bySeq.has(client.seq)) bySeq.set(client.seq, []);
+                bySeq.get(client.seq).push(client);
+            });
+
+            for (const [seq, clients] of bySeq) {
+                const feed = JSON.parse(await runCppCommand(`SUBSCRIBE|${seq}`));
+                if (feed.error) throw new Error(feed.error);
+
+                clients.forEach(client => {
+                    if (feed.reset) {
+                        // Data from before the feed stays at position 0: only send it once
+                        if (client.synced && feed.seq === client.seq) return;
+                        sendEvent(client, 'reset', { seq: feed.seq, students: feed.changes.map(c => c.student) }, feed.seq);
+                        client.synced = true;
+                    } else {
+                        feed.changes.forEach(change => sendEvent(client, 'change', change, change.seq));
+                    }
+                    client.seq = feed.seq;
+                });
+                if (feed.more) feedAgain = true;
+            }
+        } while (feedAgain && feedClients.size > 0);
+    } catch (error) {
+        console.error('Change feed error:', error);
+        feedClients.forEach(client => {
+            if (!client.synced) sendEvent(client, 'feed-error', { error: error.message });
+        });
+    } finally {
+        feedPolling = false;
     }
+}
+
+function notifyFeed() {
+    if (feedClients.size > 0) pollFeed();
+}
+
+setInterval(notifyFeed, FEED_POLL_MS);
+
+app.get('/api/changes', (req, res) => {
+    res.writeHead(200, {
+        'Content-Type': 'text/event-stream',
+        'Cache-Control': 'no-cache',
+        'Connection': 'keep-alive'
+    });
+    res.write('retry: 3000\n\n');
+
+    // Browsers resend the last event id when they reconnect
+    const since = parseInt(req.headers['last-event-id'] || req.query.since || '0', 10);
+    const client = { res, seq: Number.isFinite(since) && since > 0 ? since : 0, synced: false };
+    feedClients.add(client);
+    res.on('close', () => feedClients.delete(client));
+
+    pollFeed();
 });
 
 // ==================== START SERVER ====================
@@ -0,0 +1,318 @@
+// Restart and data checks for the Student Result Management backend.
+//
+// Each check opens a store through the same ResultManager the backend
+// uses, on files in a fresh temporary directory, sends it commands through
+// the dispatch table, closes it, and opens it again (often with other
+// options) to compare what it answers. Some checks read the shipped
+// reportcards.txt, so run it from the repo root. The exit status is the
+// number of failed checks.
+//
+// Build:  g++ -std=c++17 -O2 -pthread store_checks.cpp -o store_checks
+// Run:    ./store_checks [name...]        (no names: every check)
+#define RESULT_CORE_LIBRARY
+#include "backend_server.cpp"
+
+// A temporary directory, removed with everything in it
+struct ScratchDir {
+    filesystem::path path;
+
+    ScratchDir() {
+        random_device rd;
+        path = filesystem::temp_directory_path() / ("store_checks." + to_string(rd()));
+        filesystem::create_directories(path);
+    }
+    ~ScratchDir() {
+        error_code ec;
+        filesystem::remove_all(path, ec);
+    }
+    string file(const string& name) const { return (path / name).string(); }
+};
+
+struct CheckFailed : runtime_error {
+    using runtime_error::runtime_error;
+};
+
+void expect(bool ok, const string& what) {
+    if (!ok) throw CheckFailed(what);
+}
+
+string run(ResultManager& store, const string& command) {
+    return dispatchCommand(store, command);
+}
+
+size_t countOf(const string& text, const string& needle) {
+    size_t n = 0;
+    for (size_t at = text.find(needle); at != string::npos; at = text.find(needle, at + needle.size())) n++;
+    return n;
+}
+
+unique_ptr<ResultManager> openStore(const ScratchDir& dir, size_t shards) {
+    StoreOptions options;
+    options.shards = shards;
+    return make_unique<ResultManager>(dir.file("reportcards.txt"), dir.file("classlist.csv"), options);
+}
+
+// ---- checks ----
+
+// Students written under one --shards value are all there after restarting
+// with another, and later writes land in the new layout's files
+void checkShardCountChange() {
+    ScratchDir dir;
+    const size_t layouts[] = {4, 1, 2, 4, 3, 1, 2};
+    const char* const prefixes[] = {"CE", "IT", "EN", "ME", "CS", "AI", "DS", "EC", "CV", "EE"};
+    size_t added = 0;
+    for (size_t step = 0; step < size(layouts); step++) {
+        auto store = openStore(dir, layouts[step]);
+        string all = run(*store, "GET_ALL");
+        expect(countOf(all, "\"prn\"") == added,
+               "--shards=" + to_string(layouts[step]) + " sees " + to_string(countOf(all, "\"prn\"")) + " of " +
+               to_string(added) + " students");
+        if (added > 0) {
+            string first = run(*store, "SEARCH|B24CE0000");
+            expect(first.find("\"marks\":" + to_string(40 + step - 1)) != string::npos,
+                   "last mark update to B24CE0000 lost at step " + to_string(step) + ": " + first);
+        }
+        // Two new students per step, spread over departments (and so shards)
+        for (int i = 0; i < 2; i++, added++) {
+            string prn = "B24" + string(prefixes[added % size(prefixes)]) + to_string(1000 + added).substr(0, 4);
+            if (added == 0) prn = "B24CE0000";
+            string reply = run(*store, "ADD|" + prn + "|Student " + to_string(added) + "|1|X1|Intro|50|100");
+            expect(reply.find("\"prn\"") != string::npos, "ADD failed: " + reply);
+        }
+        string update = run(*store, "UPDATE_MARKS|B24CE0000|X1|" + to_string(40 + step));
+        expect(update.find("\"version\"") != string::npos, "UPDATE_MARKS failed: " + update);
+    }
+    // Only the last layout's files are left
+    vector<size_t> files = existingShardFiles(dir.file("reportcards.txt"));
+    expect(files.size() == 2 && files[1] == 1, "shard files of an old layout were left behind");
+}
+
+// A damaged export is rejected as a whole: nothing from it reaches the
+// store before the text files are read instead
+void checkImportValidatesFirst() {
+    ScratchDir dir;
+    string exportFile = dir.file("students.col");
+    {
+        auto store = openStore(dir, 1);
+        for (int i = 0; i < 9000; i++) {  // two row groups
+            string prn = "B24CE" + to_string(10000 + i);
+            expect(run(*store, "ADD|" + prn + "|Student " + to_string(i) + "|1|X1|Intro|50|100").find("\"prn\"") !=
+                   string::npos, "ADD failed");
+        }
+        string reply = run(*store, "EXPORT|" + exportFile);
+        expect(reply.find("\"rowGroups\":2") != string::npos, "EXPORT: " + reply);
+    }
+    // The text files now hold a single, different student
+    filesystem::remove(dir.file("reportcards.txt"));
+    {
+        auto store = openStore(dir, 1);
+        run(*store, "ADD|B24IT00001|Only Text|1|X1|Intro|60|100");
+    }
+    StoreOptions options;
+    options.importFile = exportFile;
+    {
+        auto store = make_unique<ResultManager>(dir.file("reportcards.txt"), dir.file("classlist.csv"), options);
+        expect(countOf(run(*store, "GET_ALL"), "\"prn\"") == 9000, "intact export did not import every student");
+    }
+    // Damage a byte at the end of the second row group (its version column)
+    string image;
+    {
+        ifstream in(exportFile, ios::binary);
+        image.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    uint32_t footerLen;
+    memcpy(&footerLen, image.data() + image.size() - 12, 4);
+    image[image.size() - 16 - footerLen - 40] ^= 0x5a;
+    ofstream(exportFile, ios::binary | ios::trunc) << image;
+    {
+        auto store = make_unique<ResultManager>(dir.file("reportcards.txt"), dir.file("classlist.csv"), options);
+        string all = run(*store, "GET_ALL");
+        expect(countOf(all, "\"prn\"") == 1 && all.find("B24IT00001") != string::npos,
+               "damaged export left " + to_string(countOf(all, "\"prn\"")) + " students instead of the text file's 1");
+    }
+}
+
+string fileText(const string& path) {
+    ifstream in(path, ios::binary);
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+// An SRCOL3 export of a single row group rewritten as the older SRCOL2
+// (no CRCs). With retypeVersion, the students.version chunk is declared
+// COL_UINT8 with one byte per value, consistent in itself but not with the
+// schema.
+string asSrcol2(const string& image, bool retypeVersion) {
+    const size_t magic = sizeof(COLUMNAR_MAGIC);
+    uint32_t footerLen;
+    memcpy(&footerLen, image.data() + image.size() - magic - 4, 4);
+    size_t footerStart = image.size() - magic - 8 - footerLen;
+    string group = image.substr(magic, footerStart - magic);
+    if (retypeVersion) {
+        ByteReader r(group.data(), group.size());
+        r.seek(12);  // "RGRP", students, courses
+        ColumnChunk c;
+        for (size_t i = 0; i + 1 < COLUMNAR_COLUMNS; i++) expect(readColumnChunk(r, c), "export not readable");
+        size_t at = r.position();
+        expect(readColumnChunk(r, c) && c.id == 9, "no version chunk");
+        string chunk = group.substr(at, 1 + 1 + 4 + 16);
+        chunk[1] = (char)COL_UINT8;
+        putRaw<uint64_t>(chunk, c.values);
+        chunk.append(c.values, '\x07');
+        group = group.substr(0, at) + chunk;
+    }
+    string footer = image.substr(footerStart, footerLen - 4);  // one group: its CRC is last
+    string out(COLUMNAR_MAGIC_V2, magic);
+    out += group;
+    out += footer;
+    putRaw<uint32_t>(out, (uint32_t)footer.size());
+    out.append(COLUMNAR_MAGIC_V2, magic);
+    return out;
+}
+
+// An SRCOL2 export (no CRCs to catch it) whose chunk types disagree with
+// the schema is rejected instead of read with the schema's value widths
+void checkImportChecksSchema() {
+    ScratchDir dir;
+    string exportFile = dir.file("students.col");
+    {
+        auto store = openStore(dir, 1);
+        for (int i = 0; i < 3; i++) {
+            run(*store, "ADD|B24CE" + to_string(10000 + i) + "|Student " + to_string(i) + "|1|X1|Intro|50|100");
+        }
+        expect(run(*store, "EXPORT|" + exportFile).find("\"rowGroups\":1") != string::npos, "EXPORT failed");
+    }
+    string image = fileText(exportFile);
+    filesystem::remove(dir.file("reportcards.txt"));
+    {
+        auto store = openStore(dir, 1);
+        run(*store, "ADD|B24IT00001|Only Text|1|X1|Intro|60|100");
+    }
+    StoreOptions options;
+    options.importFile = exportFile;
+    for (bool retype : {false, true}) {
+        ofstream(exportFile, ios::binary | ios::trunc) << asSrcol2(image, retype);
+        ResultManager store(dir.file("reportcards.txt"), dir.file("classlist.csv"), options);
+        size_t students = countOf(run(store, "GET_ALL"), "\"prn\"");
+        if (!retype) expect(students == 3, "SRCOL2 export imported " + to_string(students) + " of 3 students");
+        else expect(students == 1, "mistyped version column was imported");
+    }
+}
+
+// A mark update in the record format, committed at `time`
+string updateRecordAt(const string& prn, const string& code, int marks, unsigned version, uint64_t seq,
+                      const string& time) {
+    return "---------------------------------------------\nUpdate PRN: " + prn + "\nCourse: " + code +
+           "\nMarks: " + to_string(marks) + "\nVersion: " + to_string(version) + "\nSeq: " + to_string(seq) +
+           "\nTime: " + time + "\n---------------------------------------------\n\n";
+}
+
+// COMPACT leaves the data file smaller, with the past versions in the
+// history segment, and AS_OF answers the same afterwards. --history-days
+// drops the versions superseded before the horizon.
+void checkCompactionShrinks() {
+    ScratchDir dir;
+    {
+        ofstream out(dir.file("reportcards.txt"), ios::binary);
+        out << "---------------------------------------------\nStudent PRN: B24CE1001\nStudent Name: Asha Rao\n"
+               "Courses:\n  DSA - Data Structures : 40/100\n  OOP - Object Oriented Programming : 50/100\n"
+               "Percentage: 45.00%\nGrade: F\nVersion: 1\nSeq: 1\nTime: 2020-01-01T00:00:00Z\n"
+               "---------------------------------------------\n\n";
+        for (int i = 0; i < 20; i++) out << updateRecordAt("B24CE1001", "DSA", 41 + i, 2 + i, 2 + i, "2020-02-01T00:00:00Z");
+    }
+    const char* const queries[] = {"GET_ALL", "AS_OF|2020-01-15|SEARCH|B24CE1001", "AS_OF|2020-03-01|SEARCH|B24CE1001",
+                                   "AS_OF|2099-01-01|GET_ALL"};
+    vector<string> before;
+    {
+        auto store = openStore(dir, 1);
+        expect(run(*store, "UPDATE_MARKS|B24CE1001|OOP|70").find("\"version\":22") != string::npos, "UPDATE_MARKS failed");
+        for (const char* q : queries) before.push_back(run(*store, q));
+    }
+    uintmax_t grown = filesystem::file_size(dir.file("reportcards.txt"));
+    {
+        auto store = openStore(dir, 1);
+        string reply = store->compact(false);
+        expect(reply.find("\"failed\":false") != string::npos, "COMPACT: " + reply);
+    }
+    uintmax_t compacted = filesystem::file_size(dir.file("reportcards.txt"));
+    expect(compacted < grown, "data file grew from " + to_string(grown) + " to " + to_string(compacted) + " bytes");
+    expect(countOf(fileText(dir.file("reportcards.txt")), "Student PRN:") == 1, "past versions left in the data file");
+    {
+        auto store = openStore(dir, 1);
+        for (size_t i = 0; i < size(queries); i++) {
+            expect(run(*store, queries[i]) == before[i], string(queries[i]) + " changed after COMPACT");
+        }
+        expect(run(*store, "AS_OF|not-a-time|GET_ALL").find("NOT_A_NUMBER") != string::npos, "bad time not a parse error");
+    }
+    
+    // Every version but the one the update just replaced was superseded years ago
+    StoreOptions options;
+    options.historyDays = 30;
+    {
+        ResultManager store(dir.file("reportcards.txt"), dir.file("classlist.csv"), options);
+        expect(run(store, "AS_OF|2020-03-01|GET_ALL").find("OUT_OF_RANGE") != string::npos,
+               "AS_OF before the horizon answered");
+        store.compact(false);
+    }
+    string history = fileText(dir.file("reportcards.history.txt"));
+    expect(countOf(history, "Student PRN:") == 1 && history.find("Version: 21") != string::npos,
+           "history segment kept versions from before the horizon");
+    {
+        ResultManager store(dir.file("reportcards.txt"), dir.file("classlist.csv"), options);
+        expect(run(store, "AS_OF|2099-01-01|GET_ALL") == before[3], "current state changed by the horizon");
+    }
+}
+
+// TOP/BOTTOM on the shipped reportcards.txt, where code 001 is DSA for
+// one student and OOP for another: a course name finds every student
+// taking it, whatever its code, and nobody else
+void checkBoardsByCourseName() {
+    ScratchDir dir;
+    expect(filesystem::exists("reportcards.txt"), "run store_checks from the repo root (no reportcards.txt here)");
+    filesystem::copy_file("reportcards.txt", dir.file("reportcards.txt"));
+    for (size_t shards : {1, 3}) {
+        auto store = openStore(dir, shards);
+        string top = run(*store, "TOP|DSA|3");
+        expect(top.find("\"of\":3") != string::npos && countOf(top, "\"prn\"") == 3, "TOP|DSA|3: " + top);
+        expect(top.find("\"prn\":\"50\",\"name\":\"Parth\",\"marks\":16") != string::npos,
+               "TOP|DSA|3 missed DSA under code 002: " + top);
+        string bottom = run(*store, "BOTTOM|OOP|5");
+        expect(bottom.find("\"marks\":5,") != string::npos && bottom.find("\"marks\":13,") != string::npos &&
+               bottom.find("\"marks\":10,") == string::npos, "BOTTOM|OOP|5 mixed in another subject: " + bottom);
+        run(*store, "UPDATE_MARKS|26|001|1");
+        expect(run(*store, "BOTTOM|DSA|1").find("\"marks\":1,") != string::npos, "board not updated by UPDATE_MARKS");
+        expect(run(*store, "BOTTOM|OOP|1").find("\"marks\":5,") != string::npos, "update to DSA moved OOP's board");
+        run(*store, "UPDATE_MARKS|26|001|10");
+    }
+}
+
+struct Check {
+    const char* name;
+    void (*fn)();
+};
+
+const Check checks[] = {
+    {"shard-count-change", checkShardCountChange},
+    {"import-validates-first", checkImportValidatesFirst},
+    {"import-checks-schema", checkImportChecksSchema},
+    {"compaction-shrinks", checkCompactionShrinks},
+    {"boards-by-course-name", checkBoardsByCourseName},
+};
+
+int main(int argc, char** argv) {
+    int failed = 0, ran = 0;
+    for (const auto& check : checks) {
+        bool wanted = argc < 2;
+        for (int i = 1; i < argc; i++) wanted = wanted || string(argv[i]) == check.name;
+        if (!wanted) continue;
+        ran++;
+        try {
+            check.fn();
+            cout << "PASS " << check.name << endl;
+        } catch (const exception& e) {
+            failed++;
+            cout << "FAIL " << check.name << ": " << e.what() << endl;
+        }
+    }
+    cout << ran - failed << "/" << ran << " checks passed" << endl;
+    return failed;
+}